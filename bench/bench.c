@@ -0,0 +1,1371 @@
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <direct.h>
+#define bench_mkdir(path)	_mkdir(path)
+#define bench_rmdir(path)	_rmdir(path)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define bench_mkdir(path)	mkdir(path, 0755)
+#define bench_rmdir(path)	rmdir(path)
+#endif
+
+#include "render2d.h"
+#include "render2d_simd.h"
+#include "render2d_atlas.h"
+#include "tilemap.h"
+#include "mpmc.h"
+#include "jobs.h"
+#include "archive.h"
+#include "texcache.h"
+#include "assets.h"
+
+#include <stb_image.h>
+
+// Sprite throughput benchmark
+// Drives r2d_draw_sprite/r2d_flush on a headless backend and reports per-sprite costs
+
+// Benchmarks
+typedef enum
+{
+	TEST_RENDER,		// Full renderer, submit and flush
+	TEST_KERNELS,		// Sprite corner kernels in isolation
+	TEST_TILEMAP,		// Scrolling a large tile map, chunked vs drawn tile by tile
+	TEST_QUEUE,			// Lock-free queue stress test, against a ticket mutex ring
+	TEST_ARCHIVE,		// Reading many small files loose vs from a mapped archive
+	TEST_TEXCACHE,		// Decoding a PNG vs loading its pixels from the texture cache
+	TEST_UPLOAD,		// Streaming in large textures, with and without an upload budget
+	TEST_LOOKUP,		// Asset cache lookups by name, for growing numbers of assets
+	TEST_ATLAS,			// Adding textures once every atlas page is full
+} test_t;
+
+// Sprite submission orders
+typedef enum
+{
+	ORDER_SORTED,		// Sprites grouped by texture
+	ORDER_INTERLEAVED,	// Texture changes on every sprite
+	ORDER_RANDOM,		// Random texture per sprite
+} order_t;
+
+typedef struct
+{
+	test_t test;		// Benchmark to run
+	u32 sprites;		// Sprites per frame
+	u32 pass;			// Sprites per r2d_clear/r2d_flush pass, zero for all
+	u32 textures;		// Number of textures to spread sprites across
+	f32 rotated;		// Fraction of rotated sprites
+	f32 world;			// Size of the area sprites are spread over, in screens
+	order_t order;		// Submission order
+	bool sort;			// Let the renderer sort draws by texture
+	bool atlas;			// Let the renderer pack textures into atlas pages
+	bool cull;			// Let the renderer skip sprites outside the viewport
+	bool retained;		// Submit the sprites once as a static layer
+	u32 threads;		// Renderer worker threads
+	r2d_simd_t simd;	// Renderer corner kernel
+	u32 frames;			// Measured frames
+	u32 window_w;		// Window size the frames are drawn at
+	u32 window_h;
+	r2d_backend_type_t backend;
+	r2d_batch_mode_t mode;
+	r2d_vertex_format_t format;	// Vertex format of the non-instanced modes
+	bool compare;		// Run every batch mode and compare them
+	const char *output;	// Framebuffer output (TGA), software backend only
+} options_t;
+
+// Measurements of a single run
+typedef struct
+{
+	u64 submit_ns;
+	u64 flush_ns;
+	r2d_stats_t stats;	// Last frame
+} result_t;
+
+// Monotonic time, in nanoseconds
+static inline u64 time_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((u64) ts.tv_sec * 1000000000ull) + (u64) ts.tv_nsec;
+};
+
+// Small xorshift RNG, deterministic between runs
+static u32 g_rng = 0x9E3779B9;
+static inline u32 rng_next()
+{
+	g_rng ^= g_rng << 13;
+	g_rng ^= g_rng >> 17;
+	g_rng ^= g_rng << 5;
+	return g_rng;
+};
+static inline f32 rng_f32()
+{
+	return (rng_next() & 0xFFFFFF) / (f32) 0x1000000;
+};
+
+// Per sprite draw data, generated up front so only the renderer is measured
+typedef struct
+{
+	u32 texture;
+	aabb_t sprite;
+	xform2d_t xform;
+	u32 tint;
+} sprite_desc_t;
+
+static const char* g_order_names[] = { "sorted", "interleaved", "random" };
+static const char* g_backend_names[] = { "gl", "software", "null" };
+static const char* g_mode_names[] = { "triangles", "indexed", "instanced" };
+static const char* g_simd_names[] = { "auto", "scalar", "sse2", "avx2" };
+static const char* g_format_names[] = { "float", "packed", "tinted" };
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: bench [options]\n"
+		"  -x <test>     render | kernels | tilemap | queue | archive | texcache | upload | lookup | atlas (default render)\n"
+		"  -n <count>    sprites per frame (default 100000)\n"
+		"  -p <count>    sprites per clear/flush pass, 0 for all (default 0)\n"
+		"  -t <count>    textures (default 8)\n"
+		"  -r <0..1>     fraction of rotated sprites (default 0.5)\n"
+		"  -w <screens>  size of the area sprites are spread over, centered on the screen (default 1)\n"
+		"  -s <order>    sorted | interleaved | random (default sorted)\n"
+		"  -k <on|off>   sort draws by texture in the renderer (default on)\n"
+		"  -a <on|off>   pack textures into atlas pages (default on)\n"
+		"  -u <on|off>   cull sprites outside the viewport (default on)\n"
+		"  -l <on|off>   submit the sprites once as a static layer (default off)\n"
+		"  -j <count>    renderer worker threads, producers/consumers each for -x queue, threads for -x lookup (default 0, 4 for queue and lookup)\n"
+		"  -c <simd>     auto | scalar | sse2 | avx2 corner kernel (default auto)\n"
+		"  -f <count>    measured frames (default 10)\n"
+		"  -d <w>x<h>    window size, other aspect ratios than 16:9 are letterboxed (default the virtual screen)\n"
+		"  -b <backend>  null | software (default null)\n"
+		"  -m <mode>     triangles | indexed | instanced | all (default triangles)\n"
+		"  -v <format>   float | packed | tinted vertices (default float)\n"
+		"  -o <file>     write the last frame as a TGA (software backend)\n");
+};
+static bool parse_options(int argc, const char *argv[], options_t *options)
+{
+	options->test = TEST_RENDER;
+	options->sprites = 100000;
+	options->pass = 0;
+	options->textures = 8;
+	options->rotated = 0.5f;
+	options->world = 1.f;
+	options->order = ORDER_SORTED;
+	options->sort = true;
+	options->atlas = true;
+	options->cull = true;
+	options->retained = false;
+	options->threads = 0;
+	options->simd = R2D_SIMD_AUTO;
+	options->frames = 10;
+	options->window_w = R2D_SCREEN_W;
+	options->window_h = R2D_SCREEN_H;
+	options->backend = R2D_BACKEND_NULL;
+	options->mode = R2D_BATCH_TRIANGLES;
+	options->format = R2D_VERTEX_FLOAT;
+	options->compare = false;
+	options->output = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		const char *value = ((i + 1) < argc) ? argv[i + 1] : NULL;
+		if ((arg[0] != '-') || !value)
+			return false;
+		switch (arg[1])
+		{
+			case 'n': options->sprites = (u32) strtoul(value, NULL, 10); break;
+			case 'p': options->pass = (u32) strtoul(value, NULL, 10); break;
+			case 't': options->textures = max(1, (u32) strtoul(value, NULL, 10)); break;
+			case 'r': options->rotated = clamp((f32) atof(value), 0.f, 1.f); break;
+			case 'w': options->world = max((f32) atof(value), 1.f); break;
+			case 'j': options->threads = (u32) strtoul(value, NULL, 10); break;
+			case 'f': options->frames = max(1, (u32) strtoul(value, NULL, 10)); break;
+			case 'o': options->output = value; break;
+			case 'd':
+			{
+				if ((sscanf(value, "%ux%u", &options->window_w, &options->window_h) != 2) || !options->window_w || !options->window_h)
+					return false;
+			} break;
+			case 's':
+			{
+				if (strcmp(value, "sorted") == 0) options->order = ORDER_SORTED;
+				else if (strcmp(value, "interleaved") == 0) options->order = ORDER_INTERLEAVED;
+				else if (strcmp(value, "random") == 0) options->order = ORDER_RANDOM;
+				else return false;
+			} break;
+			case 'k':
+			{
+				if (strcmp(value, "on") == 0) options->sort = true;
+				else if (strcmp(value, "off") == 0) options->sort = false;
+				else return false;
+			} break;
+			case 'x':
+			{
+				if (strcmp(value, "render") == 0) options->test = TEST_RENDER;
+				else if (strcmp(value, "kernels") == 0) options->test = TEST_KERNELS;
+				else if (strcmp(value, "tilemap") == 0) options->test = TEST_TILEMAP;
+				else if (strcmp(value, "queue") == 0) options->test = TEST_QUEUE;
+				else if (strcmp(value, "archive") == 0) options->test = TEST_ARCHIVE;
+				else if (strcmp(value, "texcache") == 0) options->test = TEST_TEXCACHE;
+				else if (strcmp(value, "upload") == 0) options->test = TEST_UPLOAD;
+				else if (strcmp(value, "lookup") == 0) options->test = TEST_LOOKUP;
+				else if (strcmp(value, "atlas") == 0) options->test = TEST_ATLAS;
+				else return false;
+			} break;
+			case 'c':
+			{
+				u32 simd = 0;
+				while ((simd < static_len(g_simd_names)) && (strcmp(value, g_simd_names[simd]) != 0))
+					simd ++;
+				if (simd == static_len(g_simd_names))
+					return false;
+				options->simd = (r2d_simd_t) simd;
+			} break;
+			case 'a':
+			{
+				if (strcmp(value, "on") == 0) options->atlas = true;
+				else if (strcmp(value, "off") == 0) options->atlas = false;
+				else return false;
+			} break;
+			case 'u':
+			{
+				if (strcmp(value, "on") == 0) options->cull = true;
+				else if (strcmp(value, "off") == 0) options->cull = false;
+				else return false;
+			} break;
+			case 'l':
+			{
+				if (strcmp(value, "on") == 0) options->retained = true;
+				else if (strcmp(value, "off") == 0) options->retained = false;
+				else return false;
+			} break;
+			case 'b':
+			{
+				if (strcmp(value, "null") == 0) options->backend = R2D_BACKEND_NULL;
+				else if (strcmp(value, "software") == 0) options->backend = R2D_BACKEND_SOFTWARE;
+				else return false;
+			} break;
+			case 'm':
+			{
+				options->compare = (strcmp(value, "all") == 0);
+				if (options->compare) break;
+
+				u32 mode = 0;
+				while ((mode < static_len(g_mode_names)) && (strcmp(value, g_mode_names[mode]) != 0))
+					mode ++;
+				if (mode == static_len(g_mode_names))
+					return false;
+				options->mode = (r2d_batch_mode_t) mode;
+			} break;
+			case 'v':
+			{
+				u32 format = 0;
+				while ((format < static_len(g_format_names)) && (strcmp(value, g_format_names[format]) != 0))
+					format ++;
+				if (format == static_len(g_format_names))
+					return false;
+				options->format = (r2d_vertex_format_t) format;
+			} break;
+			default: return false;
+		}
+		i ++;
+	}
+	return true;
+};
+
+// Create a small checkerboard texture with a unique tint
+static r2d_texture_t* create_texture(u32 index)
+{
+	const u32 size = 64;
+	u8 *pixels = malloc(size*size*4);
+	assert(pixels != NULL);
+	for (u32 y = 0; y < size; y++)
+	{
+		for (u32 x = 0; x < size; x++)
+		{
+			u8 *p = pixels + (y*size + x)*4;
+			const bool check = ((x >> 3) ^ (y >> 3)) & 1;
+			p[0] = (u8) (check ? 255 : 40 + index*53);
+			p[1] = (u8) (check ? 255 : 40 + index*97);
+			p[2] = (u8) (check ? 255 : 40 + index*31);
+			p[3] = 255;
+		}
+	}
+	return r2d_adopt_texture(size, size, pixels, NULL, NULL);
+};
+
+static sprite_desc_t* create_sprites(const options_t *options)
+{
+	sprite_desc_t *sprites = malloc(options->sprites*sizeof(sprite_desc_t));
+	assert(sprites != NULL);
+	for (u32 i = 0; i < options->sprites; i++)
+	{
+		sprite_desc_t *desc = sprites + i;
+		switch (options->order)
+		{
+			case ORDER_SORTED:      desc->texture = (u32) (((u64) i*options->textures) / options->sprites); break;
+			case ORDER_INTERLEAVED: desc->texture = i % options->textures; break;
+			case ORDER_RANDOM:      desc->texture = rng_next() % options->textures; break;
+		}
+		const f32 size = 8.f + 24.f*rng_f32();
+		desc->sprite = aabb_rect(0.f, 0.f, size, size);
+
+		// Centered on the screen, so a single screen covers exactly the viewport
+		const f32 offset = (1.f - options->world)*0.5f;
+		const v2 pos = V2(
+			(offset + rng_f32()*options->world)*R2D_SCREEN_W,
+			(offset + rng_f32()*options->world)*R2D_SCREEN_H);
+		const f32 angle = (rng_f32() < options->rotated) ? (rng_f32()*2.f*PI_32) : 0.f;
+		desc->xform = xform2d(pos, angle);
+		// Derived from the index, so the RNG sequence matches the untinted runs
+		desc->tint = R2D_RGBA(128 + ((i*37) & 127), 128 + ((i*59) & 127), 128 + ((i*83) & 127), 255);
+	}
+	return sprites;
+};
+
+// Write an RGBA8 top-down framebuffer as an uncompressed TGA
+static bool write_tga(const char *file_name, const u8 *pixels, u32 width, u32 height)
+{
+	FILE *f = fopen(file_name, "wb");
+	if (!f)
+		return false;
+	const u8 header[18] =
+	{
+		0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		(u8) (width & 0xFF), (u8) (width >> 8),
+		(u8) (height & 0xFF), (u8) (height >> 8),
+		32, 0x28, // 32bpp, top-left origin with 8 alpha bits
+	};
+	fwrite(header, 1, sizeof(header), f);
+	for (u32 i = 0; i < width*height; i++)
+	{
+		const u8 *p = pixels + i*4;
+		const u8 bgra[4] = { p[2], p[1], p[0], p[3] };
+		fwrite(bgra, 1, 4, f);
+	}
+	fclose(f);
+	return true;
+};
+
+// Submit and flush one frame, accumulating the time spent in each stage
+// NOTE: With a static layer only the layer is drawn, in a single pass
+static void draw_frame(const options_t *options, const sprite_desc_t *sprites,
+	r2d_texture_t **textures, r2d_static_layer_t *layer, u64 *submit_ns, u64 *flush_ns, r2d_stats_t *stats)
+{
+	const u32 pass = (options->pass && !layer) ? options->pass : options->sprites;
+	memset(stats, 0, sizeof(r2d_stats_t));
+	for (u32 first = 0; first < options->sprites; first += pass)
+	{
+		const u32 last = min(first + pass, options->sprites);
+
+		const u64 t0 = time_ns();
+		r2d_clear(options->window_w, options->window_h);
+		const bool tinted = (options->format == R2D_VERTEX_PACKED_TINT);
+		if (layer)
+			r2d_draw_static_layer(layer, V2(0.f, 0.f));
+		for (u32 i = first; (i < last) && !layer; i++)
+		{
+			const sprite_desc_t *desc = sprites + i;
+			if (tinted)
+				r2d_draw_sprite_tint(textures[desc->texture], desc->sprite, desc->xform, desc->tint);
+			else
+				r2d_draw_sprite(textures[desc->texture], desc->sprite, desc->xform);
+		}
+		const u64 t1 = time_ns();
+		r2d_flush();
+		const u64 t2 = time_ns();
+
+		*submit_ns += (t1 - t0);
+		*flush_ns += (t2 - t1);
+
+		const r2d_stats_t pass_stats = r2d_get_stats();
+		stats->sprites += pass_stats.sprites;
+		stats->culled += pass_stats.culled;
+		stats->static_sprites += pass_stats.static_sprites;
+		stats->vertices += pass_stats.vertices;
+		stats->batches += pass_stats.batches;
+		stats->draw_calls += pass_stats.draw_calls;
+		stats->unsorted_ranges += pass_stats.unsorted_ranges;
+		stats->upload_bytes += pass_stats.upload_bytes;
+		stats->frame_bytes = max(stats->frame_bytes, pass_stats.frame_bytes);
+		stats->frame_bytes_peak = pass_stats.frame_bytes_peak;
+		stats->pixel_bytes = pass_stats.pixel_bytes;
+	}
+};
+
+// Initialize the renderer in a batch mode and measure it
+static bool run(const options_t *options, r2d_batch_mode_t mode, const sprite_desc_t *sprites, result_t *result)
+{
+	r2d_config_t config = {0};
+	config.backend = options->backend;
+	config.batch_mode = mode;
+	config.vertex_format = options->format;
+	config.preserve_order = !options->sort;
+	config.disable_atlas = !options->atlas;
+	config.disable_culling = !options->cull;
+	config.worker_threads = options->threads;
+	config.simd = options->simd;
+	if (!r2d_init(&config))
+		return false;
+
+	r2d_texture_t **textures = malloc(options->textures*sizeof(r2d_texture_t*));
+	assert(textures != NULL);
+	for (u32 i = 0; i < options->textures; i++)
+		textures[i] = create_texture(i);
+	// Fill the static layer once, its vertices are written by the first flush
+	r2d_static_layer_t *layer = NULL;
+	if (options->retained)
+	{
+		layer = r2d_alloc_static_layer(options->sprites);
+		assert(layer != NULL);
+		for (u32 i = 0; i < options->sprites; i++)
+			r2d_set_static_sprite(layer, i, textures[sprites[i].texture], sprites[i].sprite, sprites[i].xform);
+	}
+
+	// Warm up, also uploads the queued textures
+	r2d_clear(options->window_w, options->window_h);
+	r2d_flush();
+	draw_frame(options, sprites, textures, layer, &result->submit_ns, &result->flush_ns, &result->stats);
+
+	// Measure
+	result->submit_ns = 0;
+	result->flush_ns = 0;
+	for (u32 i = 0; i < options->frames; i++)
+		draw_frame(options, sprites, textures, layer, &result->submit_ns, &result->flush_ns, &result->stats);
+
+	if (options->output)
+	{
+		u32 width, height;
+		const u8 *pixels = r2d_get_framebuffer(&width, &height);
+		if (!pixels || !write_tga(options->output, pixels, width, height))
+			fprintf(stderr, "Failed to write %s\n", options->output);
+	}
+
+	r2d_free_static_layer(layer);
+	for (u32 i = 0; i < options->textures; i++)
+		r2d_free_texture(textures[i]);
+	free(textures);
+	r2d_free();
+	return true;
+};
+static void report(const options_t *options, r2d_batch_mode_t mode, const result_t *result)
+{
+	const r2d_stats_t *stats = &result->stats;
+	const f64 frames = (f64) options->frames;
+	const f64 sprite_count = (f64) options->sprites * frames;
+	const f64 total_ns = (f64) (result->submit_ns + result->flush_ns);
+
+	printf("backend %s, %s (%s), %u sprites, %u textures%s, %.0f%% rotated, %s order%s, %u frames\n",
+		g_backend_names[options->backend], g_mode_names[mode],
+		(mode == R2D_BATCH_INSTANCED) ? "instances" : g_format_names[options->format], options->sprites, options->textures,
+		options->atlas ? " (atlas)" : "", options->rotated*100.f, g_order_names[options->order],
+		options->sort ? " (sorted by renderer)" : "", options->frames);
+	if (options->threads)
+		printf("  %u worker threads\n", options->threads);
+	if (options->retained)
+		printf("  static layer (%u sprites drawn from it)\n", result->stats.static_sprites);
+	if ((options->window_w != R2D_SCREEN_W) || (options->window_h != R2D_SCREEN_H))
+		printf("  %ux%u window\n", options->window_w, options->window_h);
+	if (options->world > 1.f)
+		printf("  spread over %.1fx%.1f screens%s\n", options->world, options->world, options->cull ? "" : " (culling off)");
+	printf("  submit      %10.2f ns/sprite\n", result->submit_ns / sprite_count);
+	printf("  flush       %10.2f ns/sprite\n", result->flush_ns / sprite_count);
+	printf("  total       %10.2f ns/sprite\n", total_ns / sprite_count);
+	printf("  frame       %10.3f ms\n", (total_ns / frames) * 1e-6);
+	printf("  vertices    %10.2f M/s\n", (stats->vertices * frames) / total_ns * 1e3);
+	printf("  draw calls  %10u /frame (%u in call order)\n", stats->draw_calls, stats->unsorted_ranges);
+	printf("  batches     %10u /frame\n", stats->batches);
+	printf("  drawn       %10u /frame (%u culled)\n", stats->sprites, stats->culled);
+	printf("  uploaded    %10.2f MB/frame (%.1f bytes/sprite)\n",
+		stats->upload_bytes / (1024.0*1024.0),
+		stats->sprites ? (f64) stats->upload_bytes / stats->sprites : 0.0);
+	printf("  frame mem   %10.2f MB/frame (%.2f MB peak)\n",
+		stats->frame_bytes / (1024.0*1024.0), stats->frame_bytes_peak / (1024.0*1024.0));
+	printf("  pixel mem   %10.2f MB waiting for upload\n", stats->pixel_bytes / (1024.0*1024.0));
+};
+
+// Time every corner kernel over the same sprites, and check they agree with the scalar kernel
+static void run_kernels(const options_t *options, const sprite_desc_t *sprites)
+{
+	const u32 block_count = (options->sprites + R2D_CORNER_BLOCK - 1) / R2D_CORNER_BLOCK;
+	r2d_corner_block_t *blocks = _mm_malloc(block_count*sizeof(r2d_corner_block_t), 64);
+	f32 *reference = malloc(block_count*sizeof(blocks->corner_x)*2);
+	assert((blocks != NULL) && (reference != NULL));
+	memset(blocks, 0, block_count*sizeof(r2d_corner_block_t));
+	for (u32 i = 0; i < options->sprites; i++)
+	{
+		r2d_corner_block_t *block = blocks + (i / R2D_CORNER_BLOCK);
+		const u32 j = i % R2D_CORNER_BLOCK;
+		const sprite_desc_t *desc = sprites + i;
+		block->pos_x[j] = desc->xform.pos.x;
+		block->pos_y[j] = desc->xform.pos.y;
+		block->rot_x0[j] = desc->xform.rot.x0;
+		block->rot_y0[j] = desc->xform.rot.y0;
+		block->rot_x1[j] = desc->xform.rot.x1;
+		block->rot_y1[j] = desc->xform.rot.y1;
+		block->half_w[j] = (desc->sprite.max.x - desc->sprite.min.x)*0.5f;
+		block->half_h[j] = (desc->sprite.max.y - desc->sprite.min.y)*0.5f;
+	}
+
+	printf("corner kernels, %u sprites, %u frames\n", options->sprites, options->frames);
+	// Per sprite xform2d_apply calls, as the batch builder did before the kernels
+	v2 *corners = malloc(options->sprites*4*sizeof(v2));
+	assert(corners != NULL);
+	const u64 t0 = time_ns();
+	for (u32 frame = 0; frame < options->frames; frame++)
+	{
+		for (u32 i = 0; i < options->sprites; i++)
+		{
+			const sprite_desc_t *desc = sprites + i;
+			const v2 scale = v2_sub(desc->sprite.max, desc->sprite.min);
+			corners[i*4 + 0] = xform2d_apply(desc->xform, v2_mul(scale, V2(-0.5f, -0.5f)));
+			corners[i*4 + 1] = xform2d_apply(desc->xform, v2_mul(scale, V2( 0.5f, -0.5f)));
+			corners[i*4 + 2] = xform2d_apply(desc->xform, v2_mul(scale, V2( 0.5f,  0.5f)));
+			corners[i*4 + 3] = xform2d_apply(desc->xform, v2_mul(scale, V2(-0.5f,  0.5f)));
+		}
+	}
+	const f64 xform_ns = (f64) (time_ns() - t0) / ((f64) options->sprites*options->frames);
+	printf("  %-8s %10.3f ns/sprite\n", "xform2d", xform_ns);
+	free(corners);
+
+	// Speedups are against the xform2d path, the scalar kernel is what CPUs without SIMD dispatch get instead of it
+	for (u32 simd = R2D_SIMD_SCALAR; simd < static_len(g_simd_names); simd++)
+	{
+		r2d_simd_t selected;
+		const r2d_corner_kernel_t kernel = r2d_get_corner_kernel((r2d_simd_t) simd, &selected);
+		if (selected != (r2d_simd_t) simd)
+		{
+			printf("  %-8s    not supported\n", g_simd_names[simd]);
+			continue;
+		}
+		const u64 t0 = time_ns();
+		for (u32 frame = 0; frame < options->frames; frame++)
+		{
+			for (u32 i = 0; i < block_count; i++)
+			{
+				const u32 count = min(options->sprites - i*R2D_CORNER_BLOCK, R2D_CORNER_BLOCK);
+				kernel(blocks + i, count);
+			}
+		}
+		const f64 ns = (f64) (time_ns() - t0) / ((f64) options->sprites*options->frames);
+
+		// Compare the corners with the scalar kernel, bit for bit
+		bool match = true;
+		for (u32 i = 0; i < block_count; i++)
+		{
+			f32 *corners = reference + i*(static_len(blocks->corner_x)*R2D_CORNER_BLOCK*2);
+			const size_t size = sizeof(blocks->corner_x);
+			if (simd == R2D_SIMD_SCALAR)
+			{
+				memcpy(corners, blocks[i].corner_x, size);
+				memcpy((u8*) corners + size, blocks[i].corner_y, size);
+			} else {
+				match &= (memcmp(corners, blocks[i].corner_x, size) == 0);
+				match &= (memcmp((u8*) corners + size, blocks[i].corner_y, size) == 0);
+			}
+		}
+		printf("  %-8s %10.3f ns/sprite %6.2fx%s\n", g_simd_names[simd], ns,
+			xform_ns / ns, match ? "" : " (MISMATCH)");
+	}
+	free(reference);
+	_mm_free(blocks);
+};
+
+// Tile map benchmark size, in tiles, and tile size
+#define BENCH_MAP_SIZE		(2048)
+#define BENCH_TILE_SIZE		(16.f)
+// Camera movement per frame, and tiles edited per frame
+#define BENCH_MAP_SCROLL	(7.3f)
+#define BENCH_MAP_EDITS		(16)
+
+// Camera of a tile map benchmark frame, scrolling diagonally across the map
+static inline v2 tilemap_camera(u32 frame)
+{
+	const f32 range = BENCH_MAP_SIZE*BENCH_TILE_SIZE - R2D_SCREEN_W;
+	return V2(fmodf(frame*BENCH_MAP_SCROLL, range), fmodf(frame*BENCH_MAP_SCROLL*0.5f, range));
+};
+// Draw the visible tiles of the map one sprite at a time, like the game used to
+static void draw_tiles(const tilemap_t *map, r2d_texture_t *texture, const aabb_t *rects, v2 camera)
+{
+	const u32 x0 = (u32) (camera.x / BENCH_TILE_SIZE), y0 = (u32) (camera.y / BENCH_TILE_SIZE);
+	const u32 x1 = min(x0 + (u32) (R2D_SCREEN_W / BENCH_TILE_SIZE) + 1, BENCH_MAP_SIZE - 1);
+	const u32 y1 = min(y0 + (u32) (R2D_SCREEN_H / BENCH_TILE_SIZE) + 1, BENCH_MAP_SIZE - 1);
+	for (u32 layer = 0; layer < 2; layer++)
+	{
+		r2d_set_layer((u8) layer);
+		for (u32 y = y0; y <= y1; y++)
+		{
+			for (u32 x = x0; x <= x1; x++)
+			{
+				const u16 tile = tilemap_get(map, layer, x, y);
+				if (tile == TILEMAP_EMPTY)
+					continue;
+				const v2 pos = V2((x + 0.5f)*BENCH_TILE_SIZE - camera.x, (y + 0.5f)*BENCH_TILE_SIZE - camera.y);
+				r2d_draw_sprite(texture, rects[tile], xform2d(pos, 0.f));
+			}
+		}
+	}
+};
+// Fill the benchmark map, floor everywhere and a wall on a quarter of the tiles
+// NOTE: Reseeds the random numbers, so every run sees the same map and edits
+static void fill_tilemap(tilemap_t *map)
+{
+	g_rng = 0x9E3779B9;
+	for (u32 y = 0; y < BENCH_MAP_SIZE; y++)
+	{
+		for (u32 x = 0; x < BENCH_MAP_SIZE; x++)
+		{
+			tilemap_set(map, 0, x, y, (u16) (rng_next() % 4));
+			tilemap_set(map, 1, x, y, ((rng_next() & 3) == 0) ? (u16) (4 + rng_next() % 12) : TILEMAP_EMPTY);
+		}
+	}
+};
+// Scroll across a large map, drawing it through the chunk cache and tile by tile
+static bool run_tilemap(const options_t *options)
+{
+	r2d_config_t config = {0};
+	config.backend = options->backend;
+	config.batch_mode = options->mode;
+	config.vertex_format = options->format;
+	config.disable_atlas = !options->atlas;
+	config.worker_threads = options->threads;
+	config.simd = options->simd;
+	if (!r2d_init(&config))
+		return false;
+
+	// 16 tiles of 16x16 in the benchmark texture
+	aabb_t rects[16];
+	for (u32 i = 0; i < static_len(rects); i++)
+		rects[i] = aabb_rect((i % 4)*16.f, (i / 4)*16.f, 16.f, 16.f);
+	r2d_texture_t *texture = create_texture(0);
+	tilemap_t *map = tilemap_alloc(BENCH_MAP_SIZE, BENCH_MAP_SIZE, 2, rects, static_len(rects), BENCH_TILE_SIZE);
+	assert(map != NULL);
+	tilemap_set_texture(map, texture);
+	// Upload the texture
+	r2d_clear(R2D_SCREEN_W, R2D_SCREEN_H);
+	r2d_flush();
+
+	printf("tile map %ux%u (%u chunks of %ux%u), 2 layers, %u frames scrolling %.1f px/frame, %u edits/frame\n",
+		BENCH_MAP_SIZE, BENCH_MAP_SIZE, (BENCH_MAP_SIZE / TILEMAP_CHUNK_SIZE)*(BENCH_MAP_SIZE / TILEMAP_CHUNK_SIZE),
+		TILEMAP_CHUNK_SIZE, TILEMAP_CHUNK_SIZE, options->frames, BENCH_MAP_SCROLL, BENCH_MAP_EDITS);
+	for (u32 chunked = 0; chunked < 2; chunked++)
+	{
+		// Edits only add walls, start both runs from the same map
+		fill_tilemap(map);
+		u64 ns = 0;
+		u64 sprites = 0, draw_calls = 0, upload_bytes = 0, baked = 0;
+		for (u32 frame = 0; frame < options->frames; frame++)
+		{
+			const v2 camera = tilemap_camera(frame);
+			const u64 t0 = time_ns();
+			// Edit tiles around the camera
+			for (u32 i = 0; i < BENCH_MAP_EDITS; i++)
+			{
+				const u32 x = (u32) (camera.x / BENCH_TILE_SIZE) + rng_next() % (u32) (R2D_SCREEN_W / BENCH_TILE_SIZE);
+				const u32 y = (u32) (camera.y / BENCH_TILE_SIZE) + rng_next() % (u32) (R2D_SCREEN_H / BENCH_TILE_SIZE);
+				tilemap_set(map, 1, x, y, (u16) (4 + rng_next() % 12));
+			}
+			r2d_clear(R2D_SCREEN_W, R2D_SCREEN_H);
+			if (chunked)
+				tilemap_draw(map, camera);
+			else
+				draw_tiles(map, texture, rects, camera);
+			r2d_flush();
+			ns += time_ns() - t0;
+
+			const r2d_stats_t stats = r2d_get_stats();
+			sprites += stats.sprites + stats.static_sprites;
+			draw_calls += stats.draw_calls;
+			upload_bytes += stats.upload_bytes;
+			baked += tilemap_get_stats(map).chunks_baked;
+		}
+		const f64 frames = (f64) options->frames;
+		printf("  %-12s %10.3f ms/frame %8.0f sprites %6.1f draw calls %10.2f KB uploaded %5.2f chunks baked /frame\n",
+			chunked ? "chunked" : "tile by tile", (ns / frames)*1e-6, sprites / frames, draw_calls / frames,
+			upload_bytes / frames / 1024.0, baked / frames);
+		if (options->output && chunked)
+		{
+			u32 width, height;
+			const u8 *pixels = r2d_get_framebuffer(&width, &height);
+			if (!pixels || !write_tga(options->output, pixels, width, height))
+				fprintf(stderr, "Failed to write %s\n", options->output);
+		}
+	}
+
+	tilemap_free(map);
+	r2d_free_texture(texture);
+	r2d_free();
+	return true;
+};
+
+// Queue stress test, producers push numbered values that consumers pop and check
+// NOTE: Values are the producer index in the upper 32 bits and a count in the lower ones
+#define BENCH_QUEUE_LEN		(1024)
+#define BENCH_MAX_THREADS	(64)
+
+// Ring guarded by a ticket mutex, as the asset loader used before the lock-free queue
+typedef struct
+{
+	ticket_mtx_t mtx;
+	u32 count;
+	u32 head;
+	u64 values[BENCH_QUEUE_LEN];
+} locked_ring_t;
+static bool locked_ring_push(locked_ring_t *ring, u64 value)
+{
+	bool result = false;
+	ticket_mtx_lock(&ring->mtx);
+	if (ring->count < BENCH_QUEUE_LEN)
+	{
+		ring->values[(ring->head + ring->count++) % BENCH_QUEUE_LEN] = value;
+		result = true;
+	}
+	ticket_mtx_unlock(&ring->mtx);
+	return result;
+};
+static bool locked_ring_pop(locked_ring_t *ring, u64 *value)
+{
+	bool result = false;
+	ticket_mtx_lock(&ring->mtx);
+	if (ring->count > 0)
+	{
+		*value = ring->values[ring->head];
+		ring->head = (ring->head + 1) % BENCH_QUEUE_LEN;
+		ring->count --;
+		result = true;
+	}
+	ticket_mtx_unlock(&ring->mtx);
+	return result;
+};
+
+static struct
+{
+	bool locked;
+	mpmc_queue_t queue;
+	locked_ring_t ring;
+	u32 producers;
+	u64 values_per_producer;
+	// Values left to pop, consumers stop at zero
+	volatile u64 remaining;
+	// Checks, summed over the consumers
+	volatile u64 popped_sum;
+	volatile u32 order_errors;
+} g_queue_test;
+
+static inline bool queue_test_push(u64 value)
+{
+	return g_queue_test.locked ? locked_ring_push(&g_queue_test.ring, value) : mpmc_push(&g_queue_test.queue, value);
+};
+static inline bool queue_test_pop(u64 *value)
+{
+	return g_queue_test.locked ? locked_ring_pop(&g_queue_test.ring, value) : mpmc_pop(&g_queue_test.queue, value);
+};
+static void* queue_producer_proc(void *data)
+{
+	const u64 producer = (u64) (size_t) data;
+	for (u64 i = 0; i < g_queue_test.values_per_producer; i++)
+	{
+		// Full, let a consumer run
+		while (!queue_test_push((producer << 32) | i))
+			sched_yield();
+	}
+	return NULL;
+};
+static void* queue_consumer_proc(void *data)
+{
+	// Last count seen from each producer, values from one producer must arrive in order
+	u64 last[BENCH_MAX_THREADS];
+	memset(last, 0xFF, sizeof(last));
+	u64 sum = 0;
+	u32 errors = 0;
+	while (g_queue_test.remaining)
+	{
+		u64 value;
+		if (!queue_test_pop(&value))
+		{
+			sched_yield();
+			continue;
+		}
+		__sync_fetch_and_sub(&g_queue_test.remaining, 1);
+		const u32 producer = (u32) (value >> 32);
+		const u64 count = value & 0xFFFFFFFF;
+		if ((producer >= g_queue_test.producers) || ((last[producer] != U64_MAX) && (count <= last[producer])))
+			errors ++;
+		else
+			last[producer] = count;
+		sum += value;
+	}
+	__sync_fetch_and_add(&g_queue_test.popped_sum, sum);
+	__sync_fetch_and_add(&g_queue_test.order_errors, errors);
+	return NULL;
+};
+static bool run_queue(const options_t *options)
+{
+	const u32 threads = clamp(options->threads ? options->threads : 4, 1, BENCH_MAX_THREADS);
+	const u64 values = (u64) options->sprites*options->frames;
+	if (!mpmc_init(&g_queue_test.queue, BENCH_QUEUE_LEN))
+		return false;
+
+	printf("queue stress, %u producers and %u consumers, %llu values each through %u slots\n",
+		threads, threads, (unsigned long long) values, BENCH_QUEUE_LEN);
+	bool passed = true;
+	for (u32 locked = 0; locked < 2; locked++)
+	{
+		// A preempted ticket holder stalls every waiter for a time slice, oversubscribed runs take minutes
+		if (locked && ((threads*2) > jobs_core_count()))
+		{
+			printf("  %-10s skipped, %u threads on %u cores would convoy on the spinning lock\n", "ticket ring", threads*2, jobs_core_count());
+			break;
+		}
+		g_queue_test.locked = (locked != 0);
+		g_queue_test.producers = threads;
+		g_queue_test.values_per_producer = values;
+		g_queue_test.remaining = values*threads;
+		g_queue_test.popped_sum = 0;
+		g_queue_test.order_errors = 0;
+
+		pthread_t producers[BENCH_MAX_THREADS], consumers[BENCH_MAX_THREADS];
+		const u64 t0 = time_ns();
+		for (u32 i = 0; i < threads; i++)
+		{
+			pthread_create(consumers + i, NULL, queue_consumer_proc, NULL);
+			pthread_create(producers + i, NULL, queue_producer_proc, (void*) (size_t) i);
+		}
+		for (u32 i = 0; i < threads; i++)
+		{
+			pthread_join(producers[i], NULL);
+			pthread_join(consumers[i], NULL);
+		}
+		const u64 ns = time_ns() - t0;
+
+		// Every value popped exactly once: sum over producers p and counts c of (p << 32) + c
+		const u64 expected = values*((((u64) threads*(threads - 1)) / 2) << 32) + (u64) threads*((values*(values - 1)) / 2);
+		const bool ok = (g_queue_test.popped_sum == expected) && (g_queue_test.order_errors == 0);
+		passed &= ok;
+		printf("  %-10s %10.2f ns/value %10.2f M values/s  %s\n", locked ? "ticket ring" : "mpmc",
+			(f64) ns / (f64) (values*threads), (f64) (values*threads) / (f64) ns * 1e3,
+			ok ? "ok" : "FAILED (values lost, duplicated or reordered)");
+	}
+	mpmc_free(&g_queue_test.queue);
+	return passed;
+};
+
+// Archive test, many small files read one by one from disk and from an archive
+#define BENCH_ARCHIVE_DIR	"bench_archive"
+#define BENCH_ARCHIVE_FILES	(1000)
+#define BENCH_ARCHIVE_SIZE	(kilobytes(4))
+
+// Read every file with fopen/fread, returns a checksum of the bytes
+static u64 read_loose_files(char names[][64])
+{
+	u64 sum = 0;
+	static u8 buffer[BENCH_ARCHIVE_SIZE];
+	for (u32 i = 0; i < BENCH_ARCHIVE_FILES; i++)
+	{
+		FILE *f = fopen(names[i], "rb");
+		if (!f)
+			continue;
+		fseek(f, 0, SEEK_END);
+		const size_t size = (size_t) ftell(f);
+		fseek(f, 0, SEEK_SET);
+		const size_t count = fread(buffer, 1, min(size, sizeof(buffer)), f);
+		fclose(f);
+		for (size_t j = 0; j < count; j += 64)
+			sum += buffer[j];
+	}
+	return sum;
+};
+// Open the archive and find every file in it, returns a checksum of the bytes
+static u64 read_archive_files(char names[][64])
+{
+	u64 sum = 0;
+	archive_t *archive = archive_open(BENCH_ARCHIVE_DIR "/files.pak");
+	if (!archive)
+		return 0;
+	for (u32 i = 0; i < BENCH_ARCHIVE_FILES; i++)
+	{
+		size_t size;
+		const u8 *data = archive_find(archive, names[i], &size);
+		for (size_t j = 0; data && (j < size); j += 64)
+			sum += data[j];
+	}
+	archive_close(archive);
+	return sum;
+};
+static bool run_archive(const options_t *options)
+{
+	// Write the files, and pack them
+	static char names[BENCH_ARCHIVE_FILES][64];
+	const char *name_list[BENCH_ARCHIVE_FILES];
+	bench_mkdir(BENCH_ARCHIVE_DIR);
+	static u8 data[BENCH_ARCHIVE_SIZE];
+	bool result = true;
+	for (u32 i = 0; result && (i < BENCH_ARCHIVE_FILES); i++)
+	{
+		snprintf(names[i], sizeof(names[i]), BENCH_ARCHIVE_DIR "/file_%04u.bin", i);
+		name_list[i] = names[i];
+		for (u32 j = 0; j < BENCH_ARCHIVE_SIZE; j++)
+			data[j] = (u8) rng_next();
+		FILE *f = fopen(names[i], "wb");
+		result = f && (fwrite(data, 1, sizeof(data), f) == sizeof(data));
+		if (f)
+			fclose(f);
+	}
+	result = result && archive_write(BENCH_ARCHIVE_DIR "/files.pak", name_list, name_list, BENCH_ARCHIVE_FILES);
+
+	if (result)
+	{
+		printf("%u files of %u KB, %u runs (after a warm up run, so the files are cached)\n",
+			BENCH_ARCHIVE_FILES, BENCH_ARCHIVE_SIZE / 1024, options->frames);
+		const u64 loose_sum = read_loose_files(names);
+		const u64 archive_sum = read_archive_files(names);
+		u64 loose_ns = 0, archive_ns = 0;
+		for (u32 frame = 0; frame < options->frames; frame++)
+		{
+			const u64 t0 = time_ns();
+			read_loose_files(names);
+			const u64 t1 = time_ns();
+			read_archive_files(names);
+			const u64 t2 = time_ns();
+			loose_ns += t1 - t0;
+			archive_ns += t2 - t1;
+		}
+		const f64 runs = (f64) options->frames;
+		printf("  %-8s %10.3f ms/run %10.2f us/file\n", "loose", (loose_ns / runs)*1e-6, (loose_ns / runs)*1e-3 / BENCH_ARCHIVE_FILES);
+		printf("  %-8s %10.3f ms/run %10.2f us/file  %s\n", "archive", (archive_ns / runs)*1e-6, (archive_ns / runs)*1e-3 / BENCH_ARCHIVE_FILES,
+			(archive_sum == loose_sum) ? "ok" : "FAILED (contents differ)");
+		result = (archive_sum == loose_sum);
+	} else {
+		fprintf(stderr, "Failed to write the test files\n");
+	}
+
+	// Clean up
+	for (u32 i = 0; i < BENCH_ARCHIVE_FILES; i++)
+		remove(names[i]);
+	remove(BENCH_ARCHIVE_DIR "/files.pak");
+	bench_rmdir(BENCH_ARCHIVE_DIR);
+	return result;
+};
+
+// Texture cache test, the example game's tile set
+#define BENCH_TEXCACHE_DIR		"bench_texcache"
+#define BENCH_TEXCACHE_IMAGE	"data/dungeon_sheet.png"
+
+static bool run_texcache(const options_t *options)
+{
+	texcache_source_t source;
+	i32 w, h, c;
+	u8 *decoded = texcache_source_file(BENCH_TEXCACHE_IMAGE, &source) ? stbi_load(BENCH_TEXCACHE_IMAGE, &w, &h, &c, STBI_rgb_alpha) : NULL;
+	if (!decoded)
+	{
+		fprintf(stderr, "Failed to load %s\n", BENCH_TEXCACHE_IMAGE);
+		return false;
+	}
+	bool result = texcache_store(BENCH_TEXCACHE_DIR, BENCH_TEXCACHE_IMAGE, &source, decoded, (u32) w, (u32) h);
+
+	// Check the pixels come back unchanged
+	if (result)
+	{
+		u32 cw, ch;
+		u8 *cached = texcache_load(BENCH_TEXCACHE_DIR, BENCH_TEXCACHE_IMAGE, &source, &cw, &ch);
+		result = cached && (cw == (u32) w) && (ch == (u32) h) && (memcmp(cached, decoded, (size_t) w*h*4) == 0);
+		free(cached);
+	}
+
+	if (result)
+	{
+		// Cache entry size, against the raw pixels
+		char path[1024];
+		texcache_source_t entry;
+		const bool has_path = texcache_path(BENCH_TEXCACHE_DIR, BENCH_TEXCACHE_IMAGE, path, sizeof(path)) && texcache_source_file(path, &entry);
+		printf("%s, %dx%d, %u runs (after a warm up run, so the files are cached)\n", BENCH_TEXCACHE_IMAGE, w, h, options->frames);
+		if (has_path)
+			printf("  entry %llu KB, %u KB of pixels\n", (unsigned long long) entry.size / 1024, (u32) (w*h*4) / 1024);
+		u64 decode_ns = 0, cache_ns = 0;
+		for (u32 frame = 0; frame < options->frames; frame++)
+		{
+			const u64 t0 = time_ns();
+			stbi_image_free(stbi_load(BENCH_TEXCACHE_IMAGE, &w, &h, &c, STBI_rgb_alpha));
+			const u64 t1 = time_ns();
+			u32 cw, ch;
+			free(texcache_load(BENCH_TEXCACHE_DIR, BENCH_TEXCACHE_IMAGE, &source, &cw, &ch));
+			const u64 t2 = time_ns();
+			decode_ns += t1 - t0;
+			cache_ns += t2 - t1;
+		}
+		const f64 runs = (f64) options->frames;
+		printf("  %-8s %10.3f ms/load\n", "png", (decode_ns / runs)*1e-6);
+		printf("  %-8s %10.3f ms/load  %.1fx faster\n", "cached", (cache_ns / runs)*1e-6, (f64) decode_ns / max(cache_ns, 1));
+	} else {
+		fprintf(stderr, "Failed to round trip %s through the cache\n", BENCH_TEXCACHE_IMAGE);
+	}
+	stbi_image_free(decoded);
+
+	// Clean up
+	char path[1024];
+	if (texcache_path(BENCH_TEXCACHE_DIR, BENCH_TEXCACHE_IMAGE, path, sizeof(path)))
+		remove(path);
+	bench_rmdir(BENCH_TEXCACHE_DIR);
+	return result;
+};
+
+// Upload test, a burst of large textures created at once
+#define BENCH_UPLOAD_TEXTURES	(16)
+#define BENCH_UPLOAD_SIZE		(1024)
+
+static bool run_upload(const options_t *options)
+{
+	// Budgets to compare, in KB per flush (0 for no limit)
+	static const u32 budgets[] = { 0, 8192, 2048 };
+	const size_t size = (size_t) BENCH_UPLOAD_SIZE*BENCH_UPLOAD_SIZE*4;
+	printf("%u textures of %ux%u (%u MB) created at once, %s backend\n", BENCH_UPLOAD_TEXTURES, BENCH_UPLOAD_SIZE, BENCH_UPLOAD_SIZE,
+		(u32) (BENCH_UPLOAD_TEXTURES*size >> 20), g_backend_names[options->backend]);
+	for (u32 b = 0; b < static_len(budgets); b++)
+	{
+		r2d_config_t config = {0};
+		config.backend = options->backend;
+		config.upload_budget_bytes = kilobytes(budgets[b]);
+		if (!r2d_init(&config))
+			return false;
+		r2d_texture_t *textures[BENCH_UPLOAD_TEXTURES];
+		for (u32 i = 0; i < BENCH_UPLOAD_TEXTURES; i++)
+		{
+			u8 *pixels = malloc(size);
+			assert(pixels != NULL);
+			memset(pixels, (int) (i*16), size);
+			textures[i] = r2d_adopt_texture(BENCH_UPLOAD_SIZE, BENCH_UPLOAD_SIZE, pixels, NULL, NULL);
+		}
+
+		// Flush until every texture is uploaded
+		u32 frames = 0;
+		u64 total_ns = 0, worst_ns = 0;
+		r2d_stats_t stats;
+		do
+		{
+			const u64 t0 = time_ns();
+			r2d_clear(R2D_SCREEN_W, R2D_SCREEN_H);
+			r2d_flush();
+			const u64 ns = time_ns() - t0;
+			total_ns += ns;
+			worst_ns = max(worst_ns, ns);
+			frames ++;
+			stats = r2d_get_stats();
+		} while (stats.textures_pending);
+
+		char name[32];
+		if (budgets[b])
+			snprintf(name, sizeof(name), "%u KB", budgets[b]);
+		else
+			snprintf(name, sizeof(name), "no budget");
+		printf("  %-10s %4u frames, worst flush %8.3f ms, total %8.3f ms\n", name, frames, worst_ns*1e-6, total_ns*1e-6);
+
+		for (u32 i = 0; i < BENCH_UPLOAD_TEXTURES; i++)
+			r2d_free_texture(textures[i]);
+		r2d_free();
+	}
+	return true;
+};
+
+// Atlas test, textures that fill 4x4 to an atlas page
+#define BENCH_ATLAS_SIZE		(500)
+#define BENCH_ATLAS_PER_PAGE	(16)
+// Textures added to the full atlas, and freed from a page before adding them again
+#define BENCH_ATLAS_EXTRA		(32)
+#define BENCH_ATLAS_FREED		(8)
+
+// Create textures of the atlas test size and flush until they are uploaded, printing the time and repacks
+static void atlas_add_textures(r2d_texture_t **textures, u32 count, const char *name)
+{
+	const size_t size = (size_t) BENCH_ATLAS_SIZE*BENCH_ATLAS_SIZE*4;
+	for (u32 i = 0; i < count; i++)
+	{
+		u8 *pixels = malloc(size);
+		assert(pixels != NULL);
+		memset(pixels, (int) (rng_next() & 0xFF), size);
+		textures[i] = r2d_adopt_texture(BENCH_ATLAS_SIZE, BENCH_ATLAS_SIZE, pixels, NULL, NULL);
+	}
+	u32 frames = 0, repacks = 0;
+	const u64 t0 = time_ns();
+	r2d_stats_t stats;
+	do
+	{
+		r2d_clear(R2D_SCREEN_W, R2D_SCREEN_H);
+		r2d_flush();
+		stats = r2d_get_stats();
+		repacks += stats.atlas_repacks;
+		frames ++;
+	} while (stats.textures_pending);
+	printf("  %-24s %3u textures %4u frames %10.3f ms %4u repacks\n", name, count, frames, (time_ns() - t0)*1e-6, repacks);
+};
+// Fill every atlas page, then add textures with no space left and with space freed on one page
+static bool run_atlas(const options_t *options)
+{
+	r2d_config_t config = {0};
+	config.backend = options->backend;
+	if (!r2d_init(&config))
+		return false;
+	printf("%ux%u textures, %u atlas pages of %ux%u, %s backend\n", BENCH_ATLAS_SIZE, BENCH_ATLAS_SIZE,
+		R2D_ATLAS_MAX_PAGES, R2D_ATLAS_PAGE_SIZE, R2D_ATLAS_PAGE_SIZE, g_backend_names[options->backend]);
+
+	static r2d_texture_t *textures[R2D_ATLAS_MAX_PAGES*BENCH_ATLAS_PER_PAGE + BENCH_ATLAS_EXTRA];
+	const u32 full = R2D_ATLAS_MAX_PAGES*BENCH_ATLAS_PER_PAGE;
+	atlas_add_textures(textures, full, "fill every page");
+	atlas_add_textures(textures + full, BENCH_ATLAS_EXTRA, "add to the full atlas");
+	// Textures are placed in creation order, so the first ones share the first page
+	for (u32 i = 0; i < BENCH_ATLAS_FREED; i++)
+		r2d_free_texture(textures[i]);
+	r2d_clear(R2D_SCREEN_W, R2D_SCREEN_H);
+	r2d_flush();
+	atlas_add_textures(textures, BENCH_ATLAS_FREED, "add after freeing some");
+
+	// The freed slots were refilled by the last run
+	for (u32 i = 0; i < static_len(textures); i++)
+		r2d_free_texture(textures[i]);
+	r2d_free();
+	return true;
+};
+
+// Asset lookup test, names in the style of the example game's
+// NOTE: The files don't exist, so the loads queued by the first lookups fail straight away
+#define BENCH_LOOKUP_NAME_LEN	(64)
+// Lookups of every name per run
+#define BENCH_LOOKUP_REPEATS	(16)
+// Names that threads of the concurrent run keep adding and releasing, while looking up the others
+#define BENCH_LOOKUP_CHURN		(64)
+
+static struct
+{
+	assets_t *assets;
+	const char (*names)[BENCH_LOOKUP_NAME_LEN];
+	const asset_handle_t *handles;
+	const u32 *order;
+	u32 count, threads, runs;
+	// Checks, summed over the threads
+	volatile u32 errors;
+} g_lookup_test;
+
+// Helper, check a handle is an image of the given name
+static inline bool lookup_test_check(asset_handle_t handle, const char *name)
+{
+	const image_t *image = get_image(g_lookup_test.assets, handle);
+	return image && (strcmp(image->asset.name, name) == 0);
+};
+static void* lookup_thread_proc(void *data)
+{
+	// Each thread starts at a different place in the order, so they look up the same names at different times
+	const u32 thread = (u32) (size_t) data;
+	const u32 count = g_lookup_test.count;
+	const u32 start = (u32) (((u64) count*thread) / g_lookup_test.threads);
+	u32 errors = 0;
+	for (u32 run = 0; run < g_lookup_test.runs; run++)
+	{
+		for (u32 i = 0; i < count; i++)
+		{
+			const u32 n = g_lookup_test.order[(start + i) % count];
+			const asset_handle_t handle = get_image_asset(g_lookup_test.assets, g_lookup_test.names[n]);
+			errors += (handle != g_lookup_test.handles[n]);
+			release_asset(g_lookup_test.assets, handle);
+			// Now and then add a name and release it, racing other threads on the same names
+			if ((i & 15) == 0)
+			{
+				char name[BENCH_LOOKUP_NAME_LEN];
+				snprintf(name, sizeof(name), "data/sprites/churn/sprite_%03u.png", (i / 16 + thread) % BENCH_LOOKUP_CHURN);
+				const asset_handle_t churn = get_image_asset(g_lookup_test.assets, name);
+				errors += !lookup_test_check(churn, name);
+				release_asset(g_lookup_test.assets, churn);
+			}
+		}
+	}
+	__sync_fetch_and_add(&g_lookup_test.errors, errors);
+	return NULL;
+};
+
+static bool run_lookup(const options_t *options)
+{
+	// Assets alive at once
+	static const u32 counts[] = { 256, 1000, 4000 };
+	const u32 thread_count = clamp(options->threads ? options->threads : 4, 1, BENCH_MAX_THREADS);
+	printf("%u lookups of every name per run, %u runs (after the names are added), then the same spread over %u threads\n",
+		BENCH_LOOKUP_REPEATS, options->frames, thread_count);
+	for (u32 c = 0; c < static_len(counts); c++)
+	{
+		const u32 count = counts[c];
+		char (*names)[BENCH_LOOKUP_NAME_LEN] = malloc(count*BENCH_LOOKUP_NAME_LEN);
+		asset_handle_t *handles = malloc(count*sizeof(asset_handle_t));
+		assert((names != NULL) && (handles != NULL));
+		for (u32 i = 0; i < count; i++)
+			snprintf(names[i], BENCH_LOOKUP_NAME_LEN, "data/sprites/level_%02u/sprite_%05u.png", i % 37, i);
+
+		assets_t *assets = alloc_assets(1, NULL, NULL);
+		bool result = true;
+		const u64 t0 = time_ns();
+		for (u32 i = 0; i < count; i++)
+			result &= ((handles[i] = get_image_asset(assets, names[i])) != ASSET_NULL_HANDLE);
+		const u64 t1 = time_ns();
+		if (!result)
+		{
+			fprintf(stderr, "  %u assets don't fit in the asset cache\n", count);
+			free_assets(assets);
+			free(names);
+			free(handles);
+			continue;
+		}
+		// Let the loads finish, so the load thread stays out of the way
+		for (u32 i = 0; i < count; i++)
+			wait_for_asset(NULL, &get_image(assets, handles[i])->asset);
+
+		// Lookups of names already in the cache, in a shuffled order
+		u32 *order = malloc(count*sizeof(u32));
+		assert(order != NULL);
+		u32 seed = 12345;
+		for (u32 i = 0; i < count; i++)
+			order[i] = i;
+		for (u32 i = count - 1; i > 0; i--)
+		{
+			seed = seed*1664525u + 1013904223u;
+			const u32 j = seed % (i + 1);
+			const u32 swap = order[i];
+			order[i] = order[j];
+			order[j] = swap;
+		}
+		u64 lookup_ns = 0;
+		for (u32 frame = 0; frame < options->frames; frame++)
+		{
+			const u64 t2 = time_ns();
+			for (u32 k = 0; k < BENCH_LOOKUP_REPEATS; k++)
+			{
+				for (u32 i = 0; i < count; i++)
+					result &= (get_image_asset(assets, names[order[i]]) == handles[order[i]]);
+			}
+			lookup_ns += time_ns() - t2;
+			// Drop the references taken, outside the timing
+			for (u32 k = 0; k < BENCH_LOOKUP_REPEATS; k++)
+			{
+				for (u32 i = 0; i < count; i++)
+					release_asset(assets, handles[i]);
+			}
+		}
+		// The same lookups spread over threads, each releasing its references straight away
+		pthread_t threads[BENCH_MAX_THREADS];
+		g_lookup_test.assets = assets;
+		g_lookup_test.names = (const char (*)[BENCH_LOOKUP_NAME_LEN]) names;
+		g_lookup_test.handles = handles;
+		g_lookup_test.order = order;
+		g_lookup_test.count = count;
+		g_lookup_test.threads = thread_count;
+		g_lookup_test.runs = max(options->frames*BENCH_LOOKUP_REPEATS / thread_count, 1);
+		g_lookup_test.errors = 0;
+		const u64 t5 = time_ns();
+		for (u32 i = 0; i < thread_count; i++)
+			pthread_create(threads + i, NULL, lookup_thread_proc, (void*) (size_t) i);
+		for (u32 i = 0; i < thread_count; i++)
+			pthread_join(threads[i], NULL);
+		const u64 t6 = time_ns();
+		result &= (g_lookup_test.errors == 0);
+
+		// Release everything, removing the names
+		const u64 t3 = time_ns();
+		for (u32 i = 0; i < count; i++)
+			release_asset(assets, handles[i]);
+		const u64 t4 = time_ns();
+
+		const f64 lookups = (f64) options->frames*BENCH_LOOKUP_REPEATS*count;
+		const f64 thread_lookups = (f64) g_lookup_test.runs*thread_count*count;
+		printf("  %5u assets  add %8.1f ns  lookup %8.1f ns  release %8.1f ns  %u threads %8.1f M lookups/s%s\n", count,
+			(f64) (t1 - t0) / count, lookup_ns / lookups, (f64) (t4 - t3) / count,
+			thread_count, thread_lookups / (f64) (t6 - t5) * 1e3, result ? "" : "  (wrong handles!)");
+		free_assets(assets);
+		free(order);
+		free(names);
+		free(handles);
+		if (!result)
+			return false;
+	}
+	return true;
+};
+
+int main(int argc, const char *argv[])
+{
+	options_t options;
+	if (!parse_options(argc, argv, &options))
+	{
+		usage();
+		return 1;
+	}
+	if (options.test == TEST_QUEUE)
+		return run_queue(&options) ? 0 : 1;
+	if (options.test == TEST_ARCHIVE)
+		return run_archive(&options) ? 0 : 1;
+	if (options.test == TEST_TEXCACHE)
+		return run_texcache(&options) ? 0 : 1;
+	if (options.test == TEST_UPLOAD)
+		return run_upload(&options) ? 0 : 1;
+	if (options.test == TEST_LOOKUP)
+		return run_lookup(&options) ? 0 : 1;
+	if (options.test == TEST_ATLAS)
+		return run_atlas(&options) ? 0 : 1;
+	sprite_desc_t *sprites = create_sprites(&options);
+	if (options.test == TEST_TILEMAP)
+	{
+		free(sprites);
+		if (!run_tilemap(&options))
+		{
+			fprintf(stderr, "Failed to initialize render2d\n");
+			return 1;
+		}
+		return 0;
+	}
+	if (options.test == TEST_KERNELS)
+	{
+		run_kernels(&options, sprites);
+		free(sprites);
+		return 0;
+	}
+
+	// Modes to run
+	r2d_batch_mode_t modes[static_len(g_mode_names)];
+	result_t results[static_len(g_mode_names)];
+	u32 mode_count = 0;
+	if (options.compare)
+	{
+		for (u32 i = 0; i < static_len(g_mode_names); i++)
+			modes[mode_count++] = (r2d_batch_mode_t) i;
+	} else {
+		modes[mode_count++] = options.mode;
+	}
+
+	for (u32 i = 0; i < mode_count; i++)
+	{
+		memset(results + i, 0, sizeof(result_t));
+		if (!run(&options, modes[i], sprites, results + i))
+		{
+			fprintf(stderr, "Failed to initialize render2d\n");
+			free(sprites);
+			return 1;
+		}
+		report(&options, modes[i], results + i);
+	}
+
+	// Upload comparison against the first mode
+	if (mode_count > 1)
+	{
+		const f64 base = (f64) results[0].stats.upload_bytes;
+		printf("\n%-12s %12s %14s %10s\n", "mode", "ns/sprite", "bytes/sprite", "upload");
+		for (u32 i = 0; i < mode_count; i++)
+		{
+			const result_t *result = results + i;
+			const f64 sprite_count = (f64) options.sprites * options.frames;
+			printf("%-12s %12.2f %14.1f %9.1f%%\n",
+				g_mode_names[modes[i]],
+				(result->submit_ns + result->flush_ns) / sprite_count,
+				result->stats.sprites ? (f64) result->stats.upload_bytes / result->stats.sprites : 0.0,
+				base ? (100.0 * result->stats.upload_bytes / base) : 0.0);
+		}
+	}
+
+	free(sprites);
+	return 0;
+}
\ No newline at end of file
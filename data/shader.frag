@@ -4,6 +4,7 @@
 in VS_OUT
 {
 	vec2 uv;
+	vec4 tint;
 } fs_in;
 
 uniform sampler2D u_sampler;
@@ -12,5 +13,5 @@ out vec4 o_frag;
 
 void main()
 {
-	o_frag = texture(u_sampler, fs_in.uv);
+	o_frag = texture(u_sampler, fs_in.uv) * fs_in.tint;
 };
\ No newline at end of file
@@ -1,18 +1,48 @@
 #version 330 core
 #extension GL_ARB_separate_shader_objects : enable
 
+#ifdef R2D_INSTANCED
+// One record per sprite, expanded into a quad below
+layout(location=0) in vec2 i_pos;
+layout(location=1) in vec2 i_axis_x;
+layout(location=2) in vec2 i_axis_y;
+layout(location=3) in vec4 i_uv_rect;
+#else
 layout(location=0) in vec2 i_pos;
 layout(location=1) in vec2 i_uv;
+// Only fed by R2D_VERTEX_PACKED_TINT, the generic value is white otherwise
+layout(location=2) in vec4 i_tint;
+#endif
 
 out VS_OUT
 {
 	vec2 uv;
+	vec4 tint;
 } vs_out;
 
 uniform mat4 u_projection;
+// Added to every position, moves static layers with the camera
+uniform vec2 u_offset;
+
+#ifdef R2D_INSTANCED
+// Quad corners, clockwise from the top left (drawn as a triangle fan)
+const vec2 c_corners[4] = vec2[4](
+	vec2(0.0, 0.0), vec2(1.0, 0.0),
+	vec2(1.0, 1.0), vec2(0.0, 1.0));
+#endif
 
 void main()
 {
+#ifdef R2D_INSTANCED
+	vec2 corner = c_corners[gl_VertexID];
+	vec2 pos = i_pos + u_offset + i_axis_x*(corner.x - 0.5) + i_axis_y*(corner.y - 0.5);
+
+	vs_out.uv = mix(i_uv_rect.xy, i_uv_rect.zw, corner);
+	vs_out.tint = vec4(1.0);
+	gl_Position = u_projection * vec4(pos, 0.f, 1.f);
+#else
 	vs_out.uv = i_uv;
-	gl_Position = u_projection * vec4(i_pos, 0.f, 1.f);
+	vs_out.tint = i_tint;
+	gl_Position = u_projection * vec4(i_pos + u_offset, 0.f, 1.f);
+#endif
 };
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "archive.h"
+
+struct archive_t
+{
+	// Mapped file
+	const u8 *data;
+	size_t size;
+	// Table of contents and name table, inside the mapping
+	u32 entry_count;
+	const archive_entry_t *entries;
+	const char *names;
+	u32 names_size;
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+};
+
+// Helper, order entries by hash then name
+static inline int archive_compare(u32 hash_a, const char *name_a, u32 hash_b, const char *name_b)
+{
+	if (hash_a != hash_b)
+		return (hash_a < hash_b) ? -1 : 1;
+	return strcmp(name_a, name_b);
+};
+
+// Map a whole file read only, returns NULL on failure
+static const u8* archive_map_file(archive_t *archive, const char *file_name, size_t *size)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	LARGE_INTEGER file_size;
+	const u8 *data = NULL;
+	if (GetFileSizeEx(file, &file_size) && (file_size.QuadPart > 0))
+	{
+		// The mapping keeps the file open, so the file handle can be closed right away
+		archive->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (archive->mapping)
+		{
+			data = (const u8*) MapViewOfFile(archive->mapping, FILE_MAP_READ, 0, 0, 0);
+			if (!data)
+				CloseHandle(archive->mapping);
+		}
+		*size = (size_t) file_size.QuadPart;
+	}
+	CloseHandle(file);
+	return data;
+#else
+	const int fd = open(file_name, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	struct stat st;
+	void *data = MAP_FAILED;
+	if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+	{
+		data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		*size = (size_t) st.st_size;
+	}
+	// The mapping keeps the file open
+	close(fd);
+	return (data != MAP_FAILED) ? (const u8*) data : NULL;
+#endif
+};
+static void archive_unmap_file(archive_t *archive)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(archive->data);
+	CloseHandle(archive->mapping);
+#else
+	munmap((void*) archive->data, archive->size);
+#endif
+};
+
+archive_t* archive_open(const char *file_name)
+{
+	archive_t *archive = calloc(1, sizeof(archive_t));
+	if (!archive)
+		return NULL;
+	archive->data = archive_map_file(archive, file_name, &archive->size);
+	if (!archive->data)
+	{
+		free(archive);
+		return NULL;
+	}
+
+	// Validate the header and the table of contents, so lookups can trust the offsets
+	bool valid = false;
+	const archive_header_t *header = (const archive_header_t*) archive->data;
+	if ((archive->size >= sizeof(archive_header_t)) && (header->magic == ARCHIVE_MAGIC) && (header->version == ARCHIVE_VERSION))
+	{
+		const u64 toc_size = (u64) header->entry_count*sizeof(archive_entry_t);
+		const u64 names_end = sizeof(archive_header_t) + toc_size + header->names_size;
+		if (names_end <= archive->size)
+		{
+			archive->entry_count = header->entry_count;
+			archive->entries = (const archive_entry_t*) (archive->data + sizeof(archive_header_t));
+			archive->names = (const char*) (archive->data + sizeof(archive_header_t) + toc_size);
+			archive->names_size = header->names_size;
+			valid = (archive->names_size == 0) || (archive->names[archive->names_size - 1] == '\0');
+			for (u32 i = 0; valid && (i < archive->entry_count); i++)
+			{
+				const archive_entry_t *entry = archive->entries + i;
+				// Data plus its NUL byte must be inside the file
+				valid = (entry->name_offset < archive->names_size) &&
+					(entry->offset >= names_end) && (entry->size < archive->size) &&
+					((entry->offset + entry->size) < archive->size);
+			}
+		}
+	}
+	if (!valid)
+	{
+		fprintf(stderr, "%s is not a valid archive\n", file_name);
+		archive_close(archive);
+		return NULL;
+	}
+	return archive;
+};
+void archive_close(archive_t *archive)
+{
+	if (!archive)
+		return;
+	archive_unmap_file(archive);
+	free(archive);
+};
+
+const void* archive_find(const archive_t *archive, const char *name, size_t *size)
+{
+	// Binary search the table of contents
+	const u32 hash = FNV_hash_32(name);
+	u32 first = 0, last = archive->entry_count;
+	while (first < last)
+	{
+		const u32 middle = first + (last - first) / 2;
+		const archive_entry_t *entry = archive->entries + middle;
+		const int order = archive_compare(entry->hash, archive->names + entry->name_offset, hash, name);
+		if (order == 0)
+		{
+			if (size)
+				*size = (size_t) entry->size;
+			return archive->data + entry->offset;
+		}
+		if (order < 0)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+	return NULL;
+};
+
+u32 archive_count(const archive_t *archive)
+{
+	return archive->entry_count;
+};
+const char* archive_name(const archive_t *archive, u32 index)
+{
+	assert(index < archive->entry_count);
+	return archive->names + archive->entries[index].name_offset;
+};
+
+// File being packed
+typedef struct
+{
+	const char *name;
+	const char *file;
+	u32 hash;
+	u64 size;
+} archive_input_t;
+
+static int archive_compare_inputs(const void *a, const void *b)
+{
+	const archive_input_t *input_a = (const archive_input_t*) a;
+	const archive_input_t *input_b = (const archive_input_t*) b;
+	return archive_compare(input_a->hash, input_a->name, input_b->hash, input_b->name);
+};
+// Helper, size of a file, false if it can't be opened
+static bool archive_file_size(const char *file_name, u64 *size)
+{
+	FILE *f = fopen(file_name, "rb");
+	if (!f)
+		return false;
+	fseek(f, 0, SEEK_END);
+	const long f_size = ftell(f);
+	fclose(f);
+	*size = (f_size > 0) ? (u64) f_size : 0;
+	return (f_size >= 0);
+};
+// Helper, copy a whole file into an open archive
+static bool archive_copy_file(FILE *out, const char *file_name, u64 size)
+{
+	FILE *f = fopen(file_name, "rb");
+	if (!f)
+		return false;
+	u8 buffer[kilobytes(64)];
+	u64 copied = 0;
+	while (copied < size)
+	{
+		const size_t count = fread(buffer, 1, (size_t) min(size - copied, sizeof(buffer)), f);
+		if (!count || (fwrite(buffer, 1, count, out) != count))
+			break;
+		copied += count;
+	}
+	fclose(f);
+	return (copied == size);
+};
+// Helper, pad an open archive to the next multiple of ARCHIVE_ALIGN
+static void archive_pad(FILE *out, u64 *offset)
+{
+	static const u8 zero[ARCHIVE_ALIGN];
+	const u64 padding = (ARCHIVE_ALIGN - (*offset % ARCHIVE_ALIGN)) % ARCHIVE_ALIGN;
+	fwrite(zero, 1, (size_t) padding, out);
+	*offset += padding;
+};
+
+bool archive_write(const char *file_name, const char *const *names, const char *const *files, u32 count)
+{
+	archive_input_t *inputs = malloc(max(count, 1)*sizeof(archive_input_t));
+	archive_entry_t *entries = malloc(max(count, 1)*sizeof(archive_entry_t));
+	if (!inputs || !entries)
+	{
+		free(inputs);
+		free(entries);
+		return false;
+	}
+	bool result = true;
+
+	// Size every file, and sort them into table of contents order
+	u64 names_size = 0;
+	for (u32 i = 0; result && (i < count); i++)
+	{
+		archive_input_t *input = inputs + i;
+		input->name = names[i];
+		input->file = files[i];
+		input->hash = FNV_hash_32(names[i]);
+		names_size += strlen(names[i]) + 1;
+		if (!archive_file_size(files[i], &input->size))
+		{
+			fprintf(stderr, "Failed to open %s\n", files[i]);
+			result = false;
+		}
+	}
+	qsort(inputs, count, sizeof(archive_input_t), archive_compare_inputs);
+	for (u32 i = 1; result && (i < count); i++)
+	{
+		if (archive_compare_inputs(inputs + i - 1, inputs + i) == 0)
+		{
+			fprintf(stderr, "%s is packed more than once\n", inputs[i].name);
+			result = false;
+		}
+	}
+	if (names_size > U32_MAX)
+		result = false;
+
+	FILE *out = result ? fopen(file_name, "wb") : NULL;
+	if (out)
+	{
+		// Lay out the table of contents
+		u64 offset = sizeof(archive_header_t) + (u64) count*sizeof(archive_entry_t) + names_size;
+		u32 name_offset = 0;
+		for (u32 i = 0; i < count; i++)
+		{
+			offset += (ARCHIVE_ALIGN - (offset % ARCHIVE_ALIGN)) % ARCHIVE_ALIGN;
+			entries[i].hash = inputs[i].hash;
+			entries[i].name_offset = name_offset;
+			entries[i].offset = offset;
+			entries[i].size = inputs[i].size;
+			name_offset += (u32) strlen(inputs[i].name) + 1;
+			offset += inputs[i].size + 1;
+		}
+
+		// Header, table of contents and names
+		archive_header_t header;
+		header.magic = ARCHIVE_MAGIC;
+		header.version = ARCHIVE_VERSION;
+		header.entry_count = count;
+		header.names_size = (u32) names_size;
+		fwrite(&header, sizeof(header), 1, out);
+		fwrite(entries, sizeof(archive_entry_t), count, out);
+		for (u32 i = 0; i < count; i++)
+			fwrite(inputs[i].name, 1, strlen(inputs[i].name) + 1, out);
+
+		// File data, each followed by a NUL byte
+		offset = sizeof(archive_header_t) + (u64) count*sizeof(archive_entry_t) + names_size;
+		for (u32 i = 0; result && (i < count); i++)
+		{
+			archive_pad(out, &offset);
+			assert(offset == entries[i].offset);
+			if (!archive_copy_file(out, inputs[i].file, inputs[i].size))
+			{
+				fprintf(stderr, "Failed to read %s\n", inputs[i].file);
+				result = false;
+			}
+			fputc('\0', out);
+			offset += inputs[i].size + 1;
+		}
+		result &= (fclose(out) == 0);
+		if (!result)
+			remove(file_name);
+	} else if (result) {
+		fprintf(stderr, "Failed to create %s\n", file_name);
+		result = false;
+	}
+	free(inputs);
+	free(entries);
+	return result;
+};
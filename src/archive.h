@@ -0,0 +1,55 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include "core.h"
+
+// Packed asset archives, many files bundled into one that is memory mapped and read in place
+//
+// Layout, little endian:
+//   archive_header_t
+//   archive_entry_t[entry_count], sorted by name hash then name
+//   Name table, NUL terminated names
+//   File data, each file 16 byte aligned and followed by a NUL byte so text files can be used as C strings
+
+#define ARCHIVE_MAGIC		(0x4B415032)	// "2PAK"
+#define ARCHIVE_VERSION		(1)
+#define ARCHIVE_ALIGN		(16)
+
+typedef struct
+{
+	u32 magic;
+	u32 version;
+	u32 entry_count;
+	// Size of the name table, in bytes
+	u32 names_size;
+} archive_header_t;
+typedef struct
+{
+	// FNV_hash_32 of the name
+	u32 hash;
+	// Name, as an offset into the name table
+	u32 name_offset;
+	// File data, as an offset from the start of the archive
+	u64 offset;
+	u64 size;
+} archive_entry_t;
+
+decl_struct(archive_t);
+
+// Map/unmap an archive, NULL if it can't be opened or isn't a valid archive
+archive_t* archive_open(const char *file_name);
+void       archive_close(archive_t *archive);
+
+// Find a file by name, returns its data in the mapping (NULL if not found)
+// NOTE: Valid until archive_close, the data is followed by a NUL byte
+const void* archive_find(const archive_t *archive, const char *name, size_t *size);
+
+// Files in the archive, in table of contents order
+u32         archive_count(const archive_t *archive);
+const char* archive_name(const archive_t *archive, u32 index);
+
+// Pack files into an archive, files[i] is read from disk and stored as names[i]
+// NOTE: Prints the reason to stderr on failure
+bool archive_write(const char *file_name, const char *const *names, const char *const *files, u32 count);
+
+#endif
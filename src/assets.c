@@ -1,42 +1,89 @@
+// Reader-writer locks and monotonic clocks are POSIX, not C11
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <emmintrin.h>
+
 #include "assets.h"
+#include "jobs.h"
+#include "mpmc.h"
+#include "texcache.h"
+#include "watch.h"
+
+// Initial slots of the asset hash map, it doubles whenever it fills up
+#define ASSET_HASH_INIT_LEN	(256)
+// Slots probed at once, their control bytes are compared in one go
+#define ASSET_HASH_GROUP	(16)
+// Control bytes of empty and removed slots, full ones hold the low 7 bits of the name hash
+// NOTE: Only the free slots have the top bit set
+#define ASSET_SLOT_EMPTY	(0x80)
+#define ASSET_SLOT_DELETED	(0xFE)
+// Initial size of the name arena, names past it go to overflow blocks
+#define ASSET_NAMES_SIZE	(kilobytes(64))
+// Max length of each asset queue, a power of two that fits every live asset
+#define ASSET_QUEUE_LEN	(8192)
+
+// Handle layout, from least to most significant bits
+// NOTE: Generations wrap, so a handle kept across 4096 reuses of its slot is no longer detected as stale
+#define HANDLE_INDEX_BITS	(16)
+#define HANDLE_TYPE_BITS	(4)
+#define HANDLE_GEN_BITS		(12)
+#define HANDLE_INDEX_MASK	((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_TYPE_MASK	((1u << HANDLE_TYPE_BITS) - 1)
+#define HANDLE_GEN_MASK		((1u << HANDLE_GEN_BITS) - 1)
 
-// Max length, in bytes, that a filename can be 
-#define ASSET_NAME_LEN	(512)
-// Max length of the asset hash map
-#define ASSET_HASH_LEN	(1024)
-// Max length of the asset queue
-#define ASSET_QUEUE_LEN	(512)
+// Hot reload states of an asset
+#define ASSET_RELOAD_NONE		(0)
+#define ASSET_RELOAD_PENDING	(1)	// Queued after its file changed
+#define ASSET_RELOAD_RUNNING	(2)	// Claimed by a load thread
+#define ASSET_RELOAD_CANCELLED	(3)	// Released, no more reloads
 
-// 32bit FNV-1a hash
-// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
-static inline uint32_t FNV_hash_32(const char* str)
+// Decodes an image into RGBA pixels allocated with malloc, NULL on failure
+// NOTE: Decoded straight from the archive mapping if the archive has the file, from disk otherwise
+// The texture cache (if not NULL) is tried first, and filled on a miss
+static u8* decode_image(const archive_t *archive, const char *cache_dir, const char *file_name, u32 *width, u32 *height)
 {
-	// NOTE: These change based on the size of the output hash, see above webpage
-	static const uint32_t magic_offset = 0x811c9dc5;
-	static const uint32_t magic_prime = 16777619;
+	// Describe the source, so stale cache entries are skipped
+	size_t size;
+	const void *file = archive ? archive_find(archive, file_name, &size) : NULL;
+	texcache_source_t source;
+	bool cacheable = (cache_dir != NULL);
+	if (cacheable && file)
+		source = texcache_source_memory(file, size);
+	else if (cacheable)
+		cacheable = texcache_source_file(file_name, &source);
 
-	uint32_t hash = magic_offset;
-	while (*str != '\0')
+	// Load the image data in RGBA format, from the cache or by decoding the file
+	u8 *data = cacheable ? texcache_load(cache_dir, file_name, &source, width, height) : NULL;
+	if (!data)
 	{
-		hash ^= *str++;
-		hash *= magic_prime;
-	};       
-	return hash;                                           
-}  
-
+		i32 iw, ih, c;
+		if (file)
+			data = stbi_load_from_memory((const stbi_uc*) file, (int) size, &iw, &ih, &c, STBI_rgb_alpha);
+		else
+			data = stbi_load(file_name, &iw, &ih, &c, STBI_rgb_alpha);
+		*width = (u32) iw;
+		*height = (u32) ih;
+		if (data && cacheable)
+			texcache_store(cache_dir, file_name, &source, data, *width, *height);
+	}
+	return data;
+};
 // Loads an image and creates a texture
-static bool load_image(image_t *image, const char *file_name)
+static bool load_image(image_t *image, const archive_t *archive, const char *cache_dir, const char *file_name)
 {
 	bool result = false;
 
-	// Load the image data in RGBA format
-	i32 w, h, c;
-	u8 *data = stbi_load(file_name, &w, &h, &c, STBI_rgb_alpha);
+	u32 w, h;
+	u8 *data = decode_image(archive, cache_dir, file_name, &w, &h);
 	if (data)
 	{
-		// Create a texture handle
+		// Create a texture handle, handing it the image data
 		// NOTE: There is no guarantee the texture is actually ready at this point!
-		r2d_texture_t *texture = r2d_alloc_texture(w,h,data);
+		// stb_image and the texture cache both allocate with malloc, so the renderer frees the data with free
+		r2d_texture_t *texture = r2d_adopt_texture(w,h,data,NULL,NULL);
 		if (texture)
 		{	
 			// Set the image data
@@ -45,203 +92,623 @@ static bool load_image(image_t *image, const char *file_name)
 			image->texture = texture;
 			// Success!
 			result = true;
+		} else {
+			// Free the loaded image data
+			stbi_image_free(data);
 		}
-		// Free the loaded image data
-		stbi_image_free(data);
 	}
 	return result;
 };
+// Decodes a changed image again and swaps the new pixels into its texture
+// NOTE: The old pixels are drawn until the new ones are uploaded
+// The texture cache is skipped, its file stamps only change once a second
+static bool reload_image(image_t *image, const archive_t *archive, const char *file_name)
+{
+	u32 w, h;
+	u8 *data = decode_image(archive, NULL, file_name, &w, &h);
+	if (!data)
+		return false;
+	r2d_replace_texture(image->texture, w, h, data, NULL, NULL);
+	image->width = w;
+	image->height = h;
+	return true;
+};
 // Frees image data
 static void free_image(image_t *image)
 {
-	r2d_free_texture(image->texture);
+	// Images that failed or never finished loading have no texture
+	if (image->texture)
+		r2d_free_texture(image->texture);
 };
 
-static asset_t* asset_alloc(size_t size, asset_type_t type)
+// Fixed size pool of one asset type
+// NOTE: Allocation and freeing are lock free, slots are handed out from a free list then from the unused tail
+typedef struct
+{
+	asset_type_t type;
+	size_t item_size;
+	// Slot memory, ASSET_POOL_LEN items of item_size bytes
+	u8 *items;
+	// Generation of each slot, bumped when the slot is freed
+	volatile u32 generations[ASSET_POOL_LEN];
+	// Free list, the head holds the slot index + 1 (0 if empty) and an ABA tag in the upper 32 bits
+	volatile u64 free_head;
+	u32 next_free[ASSET_POOL_LEN];
+	// Slots handed out at least once
+	volatile u32 count;
+} asset_pool_t;
+
+static bool asset_pool_init(asset_pool_t *pool, asset_type_t type, size_t item_size)
 {
-	// Allocate the asset memory
-	asset_t *asset = (asset_t*) malloc(size);
-	assert(asset != NULL);
-	memset(asset, 0, size);
-	// Set the type
-	asset->type = type;
-	// Set the state to none
+	memset(pool, 0, sizeof(asset_pool_t));
+	pool->type = type;
+	pool->item_size = item_size;
+	pool->items = calloc(ASSET_POOL_LEN, item_size);
+	return (pool->items != NULL);
+};
+static void asset_pool_free(asset_pool_t *pool)
+{
+	free(pool->items);
+	pool->items = NULL;
+};
+static inline asset_t* asset_pool_item(asset_pool_t *pool, u32 index)
+{
+	return (asset_t*) (pool->items + index*pool->item_size);
+};
+static inline asset_handle_t asset_pool_handle(const asset_pool_t *pool, u32 index)
+{
+	const u32 generation = pool->generations[index] & HANDLE_GEN_MASK;
+	return (generation << (HANDLE_INDEX_BITS + HANDLE_TYPE_BITS)) | ((u32) pool->type << HANDLE_INDEX_BITS) | index;
+};
+// Get the asset of a handle, NULL if its slot has been freed since
+static asset_t* asset_pool_get(asset_pool_t *pool, asset_handle_t handle)
+{
+	const u32 index = handle & HANDLE_INDEX_MASK;
+	if ((((handle >> HANDLE_INDEX_BITS) & HANDLE_TYPE_MASK) != pool->type) || (index >= pool->count))
+		return NULL;
+	if (asset_pool_handle(pool, index) != handle)
+		return NULL;
+	return asset_pool_item(pool, index);
+};
+// Allocate a zeroed asset, returns its handle or ASSET_NULL_HANDLE if the pool is full
+static asset_handle_t asset_pool_alloc(asset_pool_t *pool)
+{
+	u32 index = ASSET_POOL_LEN;
+	// Pop the free list
+	u64 head = pool->free_head;
+	while ((u32) head)
+	{
+		const u32 top = (u32) head - 1;
+		// Bump the tag, so a head popped and pushed back in the meantime fails the swap
+		const u64 next = (((head >> 32) + 1) << 32) | pool->next_free[top];
+		if (u64_atomic_cas(&pool->free_head, head, next))
+		{
+			index = top;
+			break;
+		}
+		head = pool->free_head;
+	}
+	// Nothing free, take a slot from the unused tail
+	if (index == ASSET_POOL_LEN)
+	{
+		index = u32_atomic_inc(&pool->count);
+		if (index >= ASSET_POOL_LEN)
+		{
+			u32_atomic_dec(&pool->count);
+			return ASSET_NULL_HANDLE;
+		}
+	}
+	asset_t *asset = asset_pool_item(pool, index);
+	memset(asset, 0, pool->item_size);
+	asset->type = pool->type;
 	asset->state = ASSET_STATE_NONE;
-	return asset;
+	return asset_pool_handle(pool, index);
 };
+// Return a slot to the pool, invalidating every handle to it
+static void asset_pool_release(asset_pool_t *pool, asset_handle_t handle)
+{
+	const u32 index = handle & HANDLE_INDEX_MASK;
+	u32_atomic_inc(&pool->generations[index]);
+	// Push onto the free list
+	u64 head;
+	do
+	{
+		head = pool->free_head;
+		pool->next_free[index] = (u32) head;
+	} while (!u64_atomic_cas(&pool->free_head, head, (((head >> 32) + 1) << 32) | (index + 1)));
+};
+
 static void free_asset(asset_t *asset)
 {
 	// Free based on type
 	switch(asset->type)
 	{
-		case ASSET_NONE: break;
+		case ASSET_NONE:
+		case ASSET_TYPE_COUNT: break;
 		case ASSET_IMAGE:
 		{
 			image_t *image = (image_t *) asset;
 			free_image(image);
 		} break;
 	}
-	// Free the struct itself
-	free(asset);
 };
 
-// Asset hash entry
-typedef struct
-{
-	char name[ASSET_NAME_LEN];
-	asset_t *asset;
-} asset_entry_t;
-// Asset queue structure
+// Asset queue structure, one lock-free queue per priority
+// NOTE: Queued loads are asset handles, an asset released before its load runs is skipped
 typedef struct
 {
+	// Counts queued loads, the load threads wait on it
 	sem_t sem;
-	bool done;
-
-	ticket_mtx_t mtx;
+	volatile bool done;
 
-	u32 count;
-	u32 head, tail;
-	asset_entry_t *entries[ASSET_QUEUE_LEN];
+	mpmc_queue_t queues[ASSET_PRIORITY_COUNT];
 } asset_queue_t;
 
-static void enqueue_asset_entry(asset_queue_t *queue, asset_entry_t *entry)
+static bool enqueue_asset(asset_queue_t *queue, asset_handle_t handle, asset_priority_t priority)
 {
-	ticket_mtx_lock(&queue->mtx);
-	{
-		// If the entry will fit in the queue
-		if ((queue->count + 1) < ASSET_QUEUE_LEN)
-		{
-			// Set the state to queued
-			entry->asset->state = ASSET_STATE_QUEUED;
-			// Put the entry at the end of the queue
-			queue->tail = (queue->tail + 1) % ASSET_QUEUE_LEN;
-			queue->entries[queue->tail] = entry;
-			queue->count ++;
-			// Wake up the load thread
-			sem_post(&queue->sem);
-		};
-	}
-	ticket_mtx_unlock(&queue->mtx);
+	if (!mpmc_push(queue->queues + priority, handle))
+		return false;
+	// Wake up a load thread
+	sem_post(&queue->sem);
+	return true;
 };
-static asset_entry_t* dequeue_asset_entry(asset_queue_t *queue)
+// Take a load, from the most urgent queue with one
+// NOTE: Only call after taking a count from the semaphore, the pops can briefly fail while a push is still being written
+static asset_handle_t dequeue_asset(asset_queue_t *queue)
 {
-	asset_entry_t *entry = NULL;
-	ticket_mtx_lock(&queue->mtx);
+	u64 load;
+	for (;;)
 	{
-		// If there's anything in the queue
-		if ((queue->count - 1) >= 0)
+		for (i32 i = ASSET_PRIORITY_COUNT - 1; i >= 0; i--)
 		{
-			// Get the entry at the front of the queue
-			entry = queue->entries[queue->head];
-			queue->head = (queue->head + 1) % ASSET_QUEUE_LEN;
-
-			queue->count --;
-		};
+			if (mpmc_pop(queue->queues + i, &load))
+				return (asset_handle_t) load;
+		}
+		_mm_pause();
 	}
-	ticket_mtx_unlock(&queue->mtx);
-	return entry;
 };
 
-// Hash map structure
+// Asset hash entry
+// NOTE: Removed entries are left as tombstones that keep their name, a name requested again reuses it
+typedef struct
+{
+	// Hash of the name, compared before the names are
+	u32 hash;
+	asset_handle_t handle;
+	// Name, interned in the name arena so it never moves
+	const char *name;
+} asset_entry_t;
+
+// Hash map structure, open addressing in the style of SwissTable
+// NOTE: Slots are probed a group at a time, the group's control bytes rule out most slots without touching the entries
 typedef struct
 {
-	asset_entry_t entries[ASSET_HASH_LEN];
+	// Slots, a power of two at least ASSET_HASH_GROUP
+	u32 capacity;
+	// Live entries, and tombstones
+	u32 count;
+	u32 deleted;
+	// Control byte and entry of each slot
+	u8 *ctrl;
+	asset_entry_t *entries;
+	// Interned names
+	// NOTE: Names of tombstones dropped when the map is rebuilt stay in the arena until the cache is freed
+	arena_t names;
 } asset_hash_t;
 
-static asset_entry_t* asset_hash_lookup(asset_hash_t *hash, const char *file_name)
+// Helper, mask of the slots of a group whose control byte is value
+static inline u32 asset_hash_match(const u8 *ctrl, u8 value)
 {
-	// Make sure the file name is the right size
-	assert (strlen(file_name) < ASSET_NAME_LEN);
-	// Get the hash of the file name
-	const u32 name_hash = FNV_hash_32(file_name);
-	// Get the initial index to check
-	const u32 init_index = (name_hash % ASSET_HASH_LEN);
+	const __m128i group = _mm_loadu_si128((const __m128i*) ctrl);
+	return (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) value)));
+};
+// Helper, mask of the free (empty or removed) slots of a group
+static inline u32 asset_hash_match_free(const u8 *ctrl)
+{
+	return (u32) _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) ctrl));
+};
+// Helper, first free slot on the probe sequence of a hash
+// NOTE: Groups are probed at triangular steps, which visits every group of a power of two map
+static u32 asset_hash_free_slot(const asset_hash_t *hash, u32 name_hash)
+{
+	const u32 group_mask = hash->capacity / ASSET_HASH_GROUP - 1;
+	u32 group = (name_hash >> 7) & group_mask;
+	for (u32 step = 1;; step++)
+	{
+		const u32 free_slots = asset_hash_match_free(hash->ctrl + group*ASSET_HASH_GROUP);
+		if (free_slots)
+			return group*ASSET_HASH_GROUP + __builtin_ctz(free_slots);
+		group = (group + step) & group_mask;
+	}
+};
+
+static bool asset_hash_init(asset_hash_t *hash, u32 capacity)
+{
+	memset(hash, 0, sizeof(asset_hash_t));
+	hash->capacity = capacity;
+	hash->ctrl = malloc(capacity);
+	hash->entries = calloc(capacity, sizeof(asset_entry_t));
+	if (!hash->ctrl || !hash->entries || !arena_init(&hash->names, ASSET_NAMES_SIZE))
+	{
+		free(hash->ctrl);
+		free(hash->entries);
+		return false;
+	}
+	memset(hash->ctrl, ASSET_SLOT_EMPTY, capacity);
+	return true;
+};
+static void asset_hash_free(asset_hash_t *hash)
+{
+	free(hash->ctrl);
+	free(hash->entries);
+	arena_free(&hash->names);
+	memset(hash, 0, sizeof(asset_hash_t));
+};
+// Rebuild the map with a new capacity, dropping the tombstones
+// NOTE: Entries are moved by their stored hash, names aren't hashed or compared again
+static bool asset_hash_resize(asset_hash_t *hash, u32 capacity)
+{
+	u8 *ctrl = malloc(capacity);
+	asset_entry_t *entries = calloc(capacity, sizeof(asset_entry_t));
+	if (!ctrl || !entries)
+	{
+		free(ctrl);
+		free(entries);
+		return false;
+	}
+	memset(ctrl, ASSET_SLOT_EMPTY, capacity);
+	u8 *old_ctrl = hash->ctrl;
+	asset_entry_t *old_entries = hash->entries;
+	const u32 old_capacity = hash->capacity;
+	hash->capacity = capacity;
+	hash->ctrl = ctrl;
+	hash->entries = entries;
+	hash->deleted = 0;
+	for (u32 i = 0; i < old_capacity; i++)
+	{
+		if (old_ctrl[i] & ASSET_SLOT_EMPTY)
+			continue;
+		const u32 slot = asset_hash_free_slot(hash, old_entries[i].hash);
+		ctrl[slot] = old_ctrl[i];
+		entries[slot] = old_entries[i];
+	}
+	free(old_ctrl);
+	free(old_entries);
+	return true;
+};
 
-	u32 index = init_index;
-	do 
+// Find the entry of a name, NULL if it isn't in the map
+static asset_entry_t* asset_hash_find(asset_hash_t *hash, const char *file_name)
+{
+	const u32 name_hash = FNV_hash_32(file_name);
+	const u32 group_mask = hash->capacity / ASSET_HASH_GROUP - 1;
+	u32 group = (name_hash >> 7) & group_mask;
+	for (u32 step = 1; step <= group_mask + 1; step++)
 	{
-		// Get the current entry
-		asset_entry_t *entry = (hash->entries + index);
-		// If the entry has an asset
-		if (entry->asset)
+		const u8 *ctrl = hash->ctrl + group*ASSET_HASH_GROUP;
+		asset_entry_t *entries = hash->entries + group*ASSET_HASH_GROUP;
+		for (u32 matches = asset_hash_match(ctrl, name_hash & 0x7F); matches; matches &= matches - 1)
 		{
-			// Check if the asset name matches, return if true
-			if (strcmp(entry->name, file_name) == 0)
+			asset_entry_t *entry = entries + __builtin_ctz(matches);
+			if ((entry->hash == name_hash) && (strcmp(entry->name, file_name) == 0))
 				return entry;
-		} else {
-			// We found an empty entry, set the entry file name
-			strcpy(entry->name, file_name);
-			// Return the entry
-			return entry;
 		}
-		// Go to the next entry
-		index = (index + 1) % ASSET_HASH_LEN;
-		// Continue until we get to the original hash entry
-	} while(index != init_index);
-	// No open slots and no matches, the hash list is full
+		// The name would have gone in the first empty slot
+		if (asset_hash_match(ctrl, ASSET_SLOT_EMPTY))
+			break;
+		group = (group + step) & group_mask;
+	}
 	return NULL;
 };
+// Find the entry of a name, adding it (with a null handle) if it isn't in the map
+// NOTE: NULL if the map can't grow
+static asset_entry_t* asset_hash_lookup(asset_hash_t *hash, const char *file_name)
+{
+	const u32 name_hash = FNV_hash_32(file_name);
+	const u8 tag = (u8) (name_hash & 0x7F);
+	const u32 group_mask = hash->capacity / ASSET_HASH_GROUP - 1;
+	// First free slot on the way, and the tombstone of this name if it was removed
+	u32 free_slot = hash->capacity;
+	u32 tombstone = hash->capacity;
+	u32 group = (name_hash >> 7) & group_mask;
+	for (u32 step = 1; step <= group_mask + 1; step++)
+	{
+		const u8 *ctrl = hash->ctrl + group*ASSET_HASH_GROUP;
+		asset_entry_t *entries = hash->entries + group*ASSET_HASH_GROUP;
+		for (u32 matches = asset_hash_match(ctrl, tag); matches; matches &= matches - 1)
+		{
+			asset_entry_t *entry = entries + __builtin_ctz(matches);
+			if ((entry->hash == name_hash) && (strcmp(entry->name, file_name) == 0))
+				return entry;
+		}
+		const u32 deleted = asset_hash_match(ctrl, ASSET_SLOT_DELETED);
+		for (u32 matches = deleted; matches && (tombstone == hash->capacity); matches &= matches - 1)
+		{
+			const u32 slot = group*ASSET_HASH_GROUP + __builtin_ctz(matches);
+			if ((hash->entries[slot].hash == name_hash) && (strcmp(hash->entries[slot].name, file_name) == 0))
+				tombstone = slot;
+		}
+		if (deleted && (free_slot == hash->capacity))
+			free_slot = group*ASSET_HASH_GROUP + __builtin_ctz(deleted);
+		const u32 empty = asset_hash_match(ctrl, ASSET_SLOT_EMPTY);
+		if (empty)
+		{
+			if (free_slot == hash->capacity)
+				free_slot = group*ASSET_HASH_GROUP + __builtin_ctz(empty);
+			break;
+		}
+		group = (group + step) & group_mask;
+	}
+
+	// Bring a removed name back, its interned name is still there
+	if (tombstone < hash->capacity)
+	{
+		hash->ctrl[tombstone] = tag;
+		hash->deleted --;
+		hash->count ++;
+		return hash->entries + tombstone;
+	}
+	// Filling an empty slot, keep at least an eighth of them empty so probes end quickly
+	if ((free_slot == hash->capacity) ||
+		((hash->ctrl[free_slot] == ASSET_SLOT_EMPTY) && ((hash->count + hash->deleted + 1)*8 > hash->capacity*7)))
+	{
+		// Grow if live entries fill more than half of that, otherwise rebuilding clears enough tombstones
+		const u32 capacity = ((hash->count + 1)*16 > hash->capacity*7) ? hash->capacity*2 : hash->capacity;
+		if (!asset_hash_resize(hash, capacity))
+			return NULL;
+		free_slot = asset_hash_free_slot(hash, name_hash);
+	}
+	// Intern the name
+	const size_t length = strlen(file_name) + 1;
+	char *name = arena_push(&hash->names, length, 1);
+	if (!name)
+		return NULL;
+	memcpy(name, file_name, length);
+	if (hash->ctrl[free_slot] == ASSET_SLOT_DELETED)
+		hash->deleted --;
+	hash->ctrl[free_slot] = tag;
+	hash->count ++;
+	asset_entry_t *entry = hash->entries + free_slot;
+	entry->hash = name_hash;
+	entry->handle = ASSET_NULL_HANDLE;
+	entry->name = name;
+	return entry;
+};
+// Remove an entry, leaving a tombstone
+static void asset_hash_remove(asset_hash_t *hash, asset_entry_t *entry)
+{
+	const u32 slot = (u32) (entry - hash->entries);
+	hash->ctrl[slot] = ASSET_SLOT_DELETED;
+	entry->handle = ASSET_NULL_HANDLE;
+	hash->count --;
+	hash->deleted ++;
+};
 
 // Asset cache data structure
 struct assets_t
 {
-	// Hash map for asset lookup
+	// Hash map for asset lookup, and its lock
+	// NOTE: Lookups of loaded names share the lock, only adding and removing names takes it exclusively
 	asset_hash_t hash;
-	// Queue for asset loading
+	pthread_rwlock_t hash_lock;
+	// Asset memory, one pool per type
+	asset_pool_t pools[ASSET_TYPE_COUNT];
+	// Queue for asset loading, and the threads loading from it
 	asset_queue_t load_queue;
-	pthread_t load_thread;
+	u32 load_thread_count;
+	pthread_t load_threads[ASSET_MAX_LOAD_THREADS];
+	// Archive to load from before trying loose files, may be NULL
+	const archive_t *archive;
+	// Directory of the pre-decoded texture cache, NULL if disabled
+	char *cache_dir;
+	// File watcher for hot reloading, NULL until watch_assets
+	watch_t *watch;
+	// Reload statistics, updated by every load thread (latencies in microseconds, so they can be changed atomically)
+	struct
+	{
+		volatile u32 reloads, failed;
+		volatile u32 last_us, max_us;
+	} reload_stats;
+};
+
+// Get the asset of a handle, NULL if it has been released
+static asset_t* get_asset(assets_t *assets, asset_handle_t handle)
+{
+	const u32 type = (handle >> HANDLE_INDEX_BITS) & HANDLE_TYPE_MASK;
+	if ((type == ASSET_NONE) || (type >= ASSET_TYPE_COUNT))
+		return NULL;
+	return asset_pool_get(assets->pools + type, handle);
+};
+
+// Helper, monotonic time for reload latencies, in milliseconds
+static f64 asset_time_ms()
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (f64) counter.QuadPart*1e3 / (f64) frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+#endif
+};
+// Watch the file of a loaded asset, if hot reloading is on and the file isn't archived
+// NOTE: The watch id is the asset handle, so a change queues it without touching the hash map
+static void watch_asset(assets_t *assets, asset_handle_t handle, const char *file_name)
+{
+	// Pairs with the barrier in watch_assets, an asset loaded meanwhile is added by one side or both
+	__sync_synchronize();
+	watch_t *watch = assets->watch;
+	if (watch && !(assets->archive && archive_find(assets->archive, file_name, NULL)))
+		watch_add(watch, file_name, handle);
+};
+// Reload a loaded asset whose file changed, on a load thread
+// NOTE: Reports nothing, the results are counted in the reload statistics
+static void reload_asset(assets_t *assets, asset_t *asset, const char *file_name)
+{
+	bool result = false;
+	switch (asset->type)
+	{
+		case ASSET_NONE:
+		case ASSET_TYPE_COUNT: break;
+		case ASSET_IMAGE:
+		{
+			result = reload_image((image_t *) asset, assets->archive, file_name);
+		} break;
+	}
+	if (result)
+	{
+		const f64 latency = asset_time_ms() - asset->reload_start;
+		const u32 latency_us = (u32) min(latency*1e3, (f64) U32_MAX);
+		u32_atomic_inc(&assets->reload_stats.reloads);
+		assets->reload_stats.last_us = latency_us;
+		for (u32 max_us = assets->reload_stats.max_us; latency_us > max_us; max_us = assets->reload_stats.max_us)
+		{
+			if (u32_atomic_cas(&assets->reload_stats.max_us, max_us, latency_us))
+				break;
+		}
+	} else {
+		u32_atomic_inc(&assets->reload_stats.failed);
+	}
+};
+// Called by the file watcher when the file of a loaded asset changes
+static void asset_file_changed(const char *file_name, u64 id, void *user)
+{
+	assets_t *assets = (assets_t*) user;
+	const asset_handle_t handle = (asset_handle_t) id;
+	// The asset may have been released since its file was watched
+	asset_t *asset = get_asset(assets, handle);
+	if (!asset || (asset->state != ASSET_STATE_LOADED))
+		return;
+	// One reload at a time, changes seen while one is pending are picked up by it
+	if (!__sync_bool_compare_and_swap(&asset->reload, ASSET_RELOAD_NONE, ASSET_RELOAD_PENDING))
+		return;
+	asset->reload_start = asset_time_ms();
+	// Reloads go ahead of everything else, the file is being worked on
+	if (!enqueue_asset(&assets->load_queue, handle, ASSET_PRIORITY_VISIBLE))
+		__sync_bool_compare_and_swap(&asset->reload, ASSET_RELOAD_PENDING, ASSET_RELOAD_NONE);
+	(void) file_name;
+};
+// Stop reloads of an asset that is being released, waiting for one in progress
+static void cancel_asset_reload(asset_t *asset)
+{
+	for (;;)
+	{
+		const u32 reload = asset->reload;
+		if (reload == ASSET_RELOAD_RUNNING)
+			_mm_pause();
+		else if (__sync_bool_compare_and_swap(&asset->reload, reload, ASSET_RELOAD_CANCELLED))
+			return;
+	}
+};
+
+// Stop a queued load from starting, or wait for a running one to finish, before the asset is freed
+static void cancel_asset_load(asset_t *asset)
+{
+	while (!__sync_bool_compare_and_swap(&asset->state, ASSET_STATE_QUEUED, ASSET_STATE_FAILED) &&
+		(asset->state == ASSET_STATE_LOADING))
+	{
+		_mm_pause();
+	}
 };
 
 static void* load_proc(void *data)
 {
 	// Get the queue
-	asset_queue_t *queue = (asset_queue_t*) data;
-	// So long as we don't have a termination signal
-	while (!queue->done)
+	assets_t *assets = (assets_t*) data;
+	asset_queue_t *queue = &assets->load_queue;
+	for (;;)
 	{
-		// If there's anything in the queue
-		if (queue->count != 0)
+		// Wait until a load is queued (or the termination signal)
+		sem_wait(&queue->sem);
+		if (queue->done)
+			break;
+		// Get the most urgent load
+		const asset_handle_t handle = dequeue_asset(queue);
+		// Get the data pointers, skipping assets released before they were loaded
+		asset_t *asset = get_asset(assets, handle);
+		if (!asset)
+			continue;
+		const char *file_name = asset->name;
+		// Claim the load, an asset raised to a higher priority is queued more than once
+		if (!__sync_bool_compare_and_swap(&asset->state, ASSET_STATE_QUEUED, ASSET_STATE_LOADING))
+		{
+			// Or the reload of a loaded asset whose file changed
+			if (__sync_bool_compare_and_swap(&asset->reload, ASSET_RELOAD_PENDING, ASSET_RELOAD_RUNNING))
+			{
+				reload_asset(assets, asset, file_name);
+				asset->reload = ASSET_RELOAD_NONE;
+			}
+			continue;
+		}
+		// Handle of the asset claimed, a release waits for the load so it stays valid until the state is published
+		// NOTE: The slot may have been released and handed to a new asset since the lookup, the claim then loads the new one
+		const asset_handle_t claimed = asset_pool_handle(assets->pools + asset->type, handle & HANDLE_INDEX_MASK);
+		// Load based on type
+		switch (asset->type)
 		{
-			// Get the head entry
-			asset_entry_t *entry = dequeue_asset_entry(queue);
-			assert (entry != NULL);
-			// Get the data pointers
-			asset_t *asset = entry->asset;
-			const char *file_name = entry->name;
-			// Load based on type
-			switch (asset->type)
+			case ASSET_NONE:
+			case ASSET_TYPE_COUNT: break;
+			case ASSET_IMAGE:
 			{
-				case ASSET_NONE: break;
-				case ASSET_IMAGE:
+				file_name = asset->name;
+				image_t *image = (image_t *) asset;
+				if (load_image(image, assets->archive, assets->cache_dir, file_name))
 				{
-					image_t *image = (image_t *) asset;
-					if (load_image(image, file_name))
-					{
-						asset->state = ASSET_STATE_LOADED;
-					} else {
-						asset->state = ASSET_STATE_FAILED;
-					}
-				};
+					// Watch before publishing, once loaded the asset may be released at any time
+					watch_asset(assets, claimed, file_name);
+					asset->state = ASSET_STATE_LOADED;
+				} else {
+					asset->state = ASSET_STATE_FAILED;
+				}
 			};
 		};
-		// Wait until the signal semaphore is signaled
-		sem_wait(&queue->sem);
 	};
 	return NULL;
 };
-assets_t* alloc_assets()
+assets_t* alloc_assets(u32 load_threads, const archive_t *archive, const char *cache_dir)
 {
 	assets_t *assets = malloc(sizeof(assets_t));
 	assert(assets != NULL);
 	memset(assets, 0, sizeof(assets_t));
+	assets->archive = archive;
+	if (cache_dir)
+	{
+		assets->cache_dir = malloc(strlen(cache_dir) + 1);
+		if (assets->cache_dir)
+			strcpy(assets->cache_dir, cache_dir);
+	}
+
+	// Create the asset pools and the hash map
+	const bool pools_ok = asset_pool_init(assets->pools + ASSET_IMAGE, ASSET_IMAGE, sizeof(image_t));
+	assert(pools_ok);
+	(void) pools_ok;
+	const bool hash_ok = asset_hash_init(&assets->hash, ASSET_HASH_INIT_LEN) && (pthread_rwlock_init(&assets->hash_lock, NULL) == 0);
+	assert(hash_ok);
+	(void) hash_ok;
 
 	// Create the load queue
 	asset_queue_t *load_queue = &assets->load_queue;
-	load_queue->head = 0; 
-	load_queue->tail = (ASSET_QUEUE_LEN-1); 
-	sem_init(&load_queue->sem, 0, ASSET_QUEUE_LEN);
-	// Create the load thread
-	pthread_create(&assets->load_thread, NULL, load_proc, load_queue);
+	sem_init(&load_queue->sem, 0, 0);
+	for (u32 i = 0; i < ASSET_PRIORITY_COUNT; i++)
+	{
+		const bool queue_ok = mpmc_init(load_queue->queues + i, ASSET_QUEUE_LEN);
+		assert(queue_ok);
+		(void) queue_ok;
+	}
+	// Create the load threads, leaving a core for the main thread by default
+	if (load_threads == 0)
+		load_threads = max(jobs_core_count(), 2) - 1;
+	load_threads = min(load_threads, ASSET_MAX_LOAD_THREADS);
+	for (u32 i = 0; i < load_threads; i++)
+	{
+		if (pthread_create(assets->load_threads + i, NULL, load_proc, assets) != 0)
+			break;
+		assets->load_thread_count ++;
+	}
+	assert(assets->load_thread_count > 0);
 
 	return assets;
 };
@@ -252,70 +719,210 @@ void free_assets(assets_t *assets)
 
 	// Set the termination signal 
 	load_queue->done = true;
-	// Wake up the load thread (if not already awake)
-	sem_post(&load_queue->sem);
-	// Join the load thread
-	pthread_join(assets->load_thread, NULL);
+	// Wake up every load thread, and join them
+	// NOTE: Threads finish the load they are on, anything still queued is dropped
+	for (u32 i = 0; i < assets->load_thread_count; i++)
+		sem_post(&load_queue->sem);
+	for (u32 i = 0; i < assets->load_thread_count; i++)
+		pthread_join(assets->load_threads[i], NULL);
+	// Then stop the file watcher, finished loads add files to it and it queues reloads until it's gone
+	watch_free(assets->watch);
+	assets->watch = NULL;
+	sem_destroy(&load_queue->sem);
+	for (u32 i = 0; i < ASSET_PRIORITY_COUNT; i++)
+		mpmc_free(load_queue->queues + i);
 	// Free the loaded assets
-	for (u32 i = 0; i < ASSET_HASH_LEN; i++)
+	// NOTE: Removed entries have a null handle
+	for (u32 i = 0; i < hash->capacity; i++)
 	{
 
 		asset_entry_t *entry = hash->entries + i;
-		if (entry->asset)
+		asset_t *asset = get_asset(assets, entry->handle);
+		if (asset)
 		{
-			asset_t *asset = entry->asset;
 			free_asset(asset);
 		};
 	};
-	// Free the assets structure
+	// Free the pools, the hash map and the assets structure
+	for (u32 i = 0; i < ASSET_TYPE_COUNT; i++)
+	{
+		asset_pool_free(assets->pools + i);
+	}
+	asset_hash_free(hash);
+	pthread_rwlock_destroy(&assets->hash_lock);
+	free(assets->cache_dir);
 	free(assets);
 };
 
-image_t* get_image_asset(assets_t *assets, const char *file_name)
+asset_handle_t get_image_asset(assets_t *assets, const char *file_name)
+{
+	return get_image_asset_priority(assets, file_name, ASSET_PRIORITY_NORMAL);
+};
+// Queue the load of a new asset, or queue it again at a higher priority
+static void queue_asset(assets_t *assets, asset_handle_t handle, asset_t *asset, asset_priority_t priority)
+{
+	assert(priority < ASSET_PRIORITY_COUNT);
+	if (asset->state == ASSET_STATE_NONE)
+	{
+		// Set the state to queued, before a load thread can see it
+		asset->state = ASSET_STATE_QUEUED;
+		asset->priority = priority;
+		if (!enqueue_asset(&assets->load_queue, handle, priority))
+			asset->state = ASSET_STATE_FAILED;
+	} else {
+		// Raise the priority of a queued load, lookups race on it under the shared lock so only the thread that raises it queues again
+		// NOTE: The earlier load is skipped by whichever load runs second, a failed enqueue leaves the earlier one
+		for (;;)
+		{
+			const asset_priority_t current = asset->priority;
+			if ((asset->state != ASSET_STATE_QUEUED) || (priority <= current))
+				return;
+			if (__sync_bool_compare_and_swap(&asset->priority, current, priority))
+				break;
+		}
+		enqueue_asset(&assets->load_queue, handle, priority);
+	}
+};
+
+// Take a reference to an asset, false if its last reference has been released
+// NOTE: A count that reached zero is never raised again, the asset is on its way out
+static bool acquire_asset(asset_t *asset)
+{
+	for (;;)
+	{
+		const i32 ref_count = asset->ref_count;
+		if (ref_count <= 0)
+			return false;
+		if (__sync_bool_compare_and_swap(&asset->ref_count, ref_count, ref_count + 1))
+			return true;
+	}
+};
+asset_handle_t get_image_asset_priority(assets_t *assets, const char *file_name, asset_priority_t priority)
 {
-	image_t *image = NULL;
+	asset_handle_t handle = ASSET_NULL_HANDLE;
 
 	asset_hash_t *hash = &assets->hash;
-	asset_queue_t *load_queue = &assets->load_queue;
 
-	// Get the entry for this asset
-	asset_entry_t *entry = asset_hash_lookup(hash, file_name);
-	if (entry != NULL)
+	// Names already loaded only need the shared lock
+	pthread_rwlock_rdlock(&assets->hash_lock);
 	{
-		// If the entry is empty
-		if (!entry->asset)
+		asset_entry_t *entry = asset_hash_find(hash, file_name);
+		asset_t *asset = entry ? get_asset(assets, entry->handle) : NULL;
+		if (asset && (asset->type == ASSET_IMAGE) && acquire_asset(asset))
 		{
-			// Create a new image and set it as the asset for this entry
-			image = (image_t*) asset_alloc(sizeof(image_t), ASSET_IMAGE); 
-			entry->asset = (asset_t*) image;
-			// Enqueue a load for it
-			enqueue_asset_entry(load_queue, entry);
-		}else {
-			// Get the asset
-			asset_t *asset = entry->asset;
-			// Make sure it's an image
-			if (asset->type == ASSET_IMAGE)
-			{
-				image = (image_t*) asset;
-			}
+			handle = entry->handle;
+			// Make sure it loads at least as soon as requested
+			queue_asset(assets, handle, asset, priority);
 		}
-		// Increment the reference count and return the asset
-		if (image)
+	}
+	pthread_rwlock_unlock(&assets->hash_lock);
+	if (handle != ASSET_NULL_HANDLE)
+		return handle;
+
+	// New name, or its asset is being released, look again with the exclusive lock
+	pthread_rwlock_wrlock(&assets->hash_lock);
+	{
+		// Get the entry for this asset
+		asset_entry_t *entry = asset_hash_lookup(hash, file_name);
+		if (entry != NULL)
 		{
-			image->asset.ref_count ++;
+			// Another thread may have created it in the meantime, make sure it's an image
+			asset_t *asset = get_asset(assets, entry->handle);
+			if (asset && (asset->type == ASSET_IMAGE) && acquire_asset(asset))
+			{
+				handle = entry->handle;
+				queue_asset(assets, handle, asset, priority);
+			} else if (!asset || (asset->ref_count <= 0)) {
+				// Create a new image and set it as the asset for this entry
+				// NOTE: A release in progress only removes the entry if it still has the old handle
+				entry->handle = asset_pool_alloc(assets->pools + ASSET_IMAGE);
+				asset = get_asset(assets, entry->handle);
+				if (asset)
+				{
+					asset->name = entry->name;
+					asset->ref_count = 1;
+					// Enqueue a load for it
+					handle = entry->handle;
+					queue_asset(assets, handle, asset, priority);
+				} else {
+					asset_hash_remove(hash, entry);
+				}
+			}
 		}
 	}
-	return image;
+	pthread_rwlock_unlock(&assets->hash_lock);
+	return handle;
 };
-void release_asset(assets_t *assets, asset_t *asset)
+image_t* get_image(assets_t *assets, asset_handle_t handle)
 {
+	asset_t *asset = get_asset(assets, handle);
+	if (asset && (asset->type == ASSET_IMAGE))
+		return (image_t*) asset;
+	return NULL;
+};
+void prioritize_asset(assets_t *assets, asset_handle_t handle, asset_priority_t priority)
+{
+	asset_t *asset = get_asset(assets, handle);
+	if (asset && (asset->state == ASSET_STATE_QUEUED))
+		queue_asset(assets, handle, asset, priority);
+};
+void release_asset(assets_t *assets, asset_handle_t handle)
+{
+	asset_t *asset = get_asset(assets, handle);
+	if (!asset)
+		return;
 	// Decrement the reference count
-	asset->ref_count --;
-	// If it goes to zero, free the asset
-	if (asset->ref_count <= 0)
+	if (__sync_sub_and_fetch(&asset->ref_count, 1) > 0)
+		return;
+	// It went to zero, forget its name so lookups stop finding it
+	// NOTE: The name may have been handed a new asset already
+	pthread_rwlock_wrlock(&assets->hash_lock);
 	{
-		free_asset(asset);
+		asset_entry_t *entry = asset_hash_find(&assets->hash, asset->name);
+		if (entry && (entry->handle == handle))
+			asset_hash_remove(&assets->hash, entry);
 	}
+	pthread_rwlock_unlock(&assets->hash_lock);
+	// Then free the asset and its slot
+	cancel_asset_load(asset);
+	cancel_asset_reload(asset);
+	// Stop watching its file, a load finished meanwhile has added it by now
+	watch_t *watch = assets->watch;
+	if (watch)
+		watch_remove(watch, handle);
+	free_asset(asset);
+	asset_pool_release(assets->pools + asset->type, handle);
+};
+bool watch_assets(assets_t *assets)
+{
+	if (assets->watch)
+		return true;
+	watch_t *watch = watch_alloc(asset_file_changed, assets);
+	if (!watch)
+		return false;
+	assets->watch = watch;
+	// Watch the assets loaded so far, load threads add the rest as they finish
+	__sync_synchronize();
+	asset_hash_t *hash = &assets->hash;
+	pthread_rwlock_rdlock(&assets->hash_lock);
+	for (u32 i = 0; i < hash->capacity; i++)
+	{
+		asset_entry_t *entry = hash->entries + i;
+		asset_t *asset = get_asset(assets, entry->handle);
+		if (asset && (asset->state == ASSET_STATE_LOADED))
+			watch_asset(assets, entry->handle, entry->name);
+	}
+	pthread_rwlock_unlock(&assets->hash_lock);
+	return true;
+};
+asset_reload_stats_t get_asset_reload_stats(assets_t *assets)
+{
+	asset_reload_stats_t stats;
+	stats.reloads = assets->reload_stats.reloads;
+	stats.failed = assets->reload_stats.failed;
+	stats.last_ms = assets->reload_stats.last_us*1e-3f;
+	stats.max_ms = assets->reload_stats.max_us*1e-3f;
+	return stats;
 };
 void wait_for_asset(asset_t *assets, const asset_t *asset)
 {
@@ -8,20 +8,34 @@
 
 #include "core.h"
 #include "render2d.h"
+#include "archive.h"
 
 // General asset header data
 typedef enum
 {
 	ASSET_NONE,
 	ASSET_IMAGE,
+	ASSET_TYPE_COUNT,
 } asset_type_t;
 typedef enum
 {
 	ASSET_STATE_NONE,
 	ASSET_STATE_QUEUED,
+	ASSET_STATE_LOADING,
 	ASSET_STATE_LOADED,
 	ASSET_STATE_FAILED,
 } asset_state_t;
+// Load priorities, higher priorities are loaded first and equal ones in request order
+typedef enum
+{
+	ASSET_PRIORITY_NORMAL,
+	// Near the camera, likely to be on screen soon
+	ASSET_PRIORITY_NEAR,
+	// On screen
+	ASSET_PRIORITY_VISIBLE,
+	ASSET_PRIORITY_COUNT,
+} asset_priority_t;
+
 typedef struct
 {
 	// Asset type marker
@@ -29,9 +43,27 @@ typedef struct
 	// Asset state marker
 	asset_state_t state;
 	// Reference count, when zero the asset is unloaded
-	i32 ref_count;
+	// NOTE: Changed atomically, handles are acquired and released from any thread
+	volatile i32 ref_count;
+	// Name of the asset (interned by the asset cache), and the highest priority it was queued at
+	// NOTE: The priority is raised atomically, lookups on several threads can raise it at once
+	const char *name;
+	volatile asset_priority_t priority;
+	// Hot reload state (see watch_assets), and when the change to the file was seen
+	volatile u32 reload;
+	f64 reload_start;
 } asset_t;
 
+// Asset handle, the pool slot of an asset and the generation the slot had when the asset was created
+// NOTE: Handles to released assets are detected and resolve to NULL, zero is never a valid handle
+typedef u32 asset_handle_t;
+#define ASSET_NULL_HANDLE	(0)
+// Assets of each type that can be alive at once
+#define ASSET_POOL_LEN		(4096)
+// Maximum threads loading assets
+#define ASSET_MAX_LOAD_THREADS	(16)
+
+
 // Specific asset data
 typedef struct
 {
@@ -45,15 +77,43 @@ typedef struct
 // Declare the asset cache structure
 decl_struct(assets_t);
 
-// Creates/destroys the asset cache
-assets_t* alloc_assets();
+// Creates/destroys the asset cache, with a number of load threads
+// NOTE: Pass 0 for one thread per core, leaving one for the calling thread
+// Assets are looked up in archive first (if not NULL) then on disk, the archive must outlive the cache
+// Images are decoded once into cache_dir (see texcache.h) and loaded from there afterwards, NULL disables it
+assets_t* alloc_assets(u32 load_threads, const archive_t *archive, const char *cache_dir);
 void      free_assets(assets_t *assets);
 
-// Gets an image asset handle from the asset cache
-image_t*  get_image_asset(assets_t *assets, const char *file_name);
+// Gets an image asset handle from the asset cache, ASSET_NULL_HANDLE if the cache is full
+// NOTE: Loaded at ASSET_PRIORITY_NORMAL, or at the given priority
+// Thread safe, names already in the cache are found under a shared lock so threads looking them up don't wait on each other
+asset_handle_t get_image_asset(assets_t *assets, const char *file_name);
+asset_handle_t get_image_asset_priority(assets_t *assets, const char *file_name, asset_priority_t priority);
+// Gets the image of a handle, NULL if the image has been released
+image_t*       get_image(assets_t *assets, asset_handle_t handle);
+
+// Raises the load priority of an asset that is still queued, for assets that came into view
+void prioritize_asset(assets_t *assets, asset_handle_t handle, asset_priority_t priority);
+
+// Returns an asset to the cache
+// NOTE: Stale handles are ignored, thread safe
+void release_asset(assets_t *assets, asset_handle_t handle);
+// Reload images when their files change, swapping the new pixels into the existing textures
+// NOTE: Handles and texture pointers stay valid, meant for development builds
+// Only loose files are watched, ones found in the archive can't change
+// False if the file watcher can't be started
+bool watch_assets(assets_t *assets);
+
+// Hot reload statistics, latencies are from the change being seen to the new pixels being queued for upload
+typedef struct
+{
+	u32 reloads;
+	u32 failed;
+	f32 last_ms;
+	f32 max_ms;
+} asset_reload_stats_t;
+asset_reload_stats_t get_asset_reload_stats(assets_t *assets);
 
-// Returns an asset to the cache 
-void release_asset(assets_t *assets, asset_t *asset);
 // Wait until an asset is completely loaded
 // NOTE: Blocking! Don't use unless completely necessary
 void wait_for_asset(asset_t *assets, const asset_t *asset);
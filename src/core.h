@@ -74,24 +74,54 @@ typedef double f64;
 #define bit_clear(v, i)	((v) &= ~(1 << (i)))
 
 // Floating point functions
-inline f32 f32_abs(f32 v)         { return fabsf(v); };
-inline f32 f32_sqrt(f32 v)        { return sqrtf(v); };
-inline f32 f32_pow(f32 v, f32 p)  { return powf(v, p); };
-inline f32 f32_isqrt(f32 v)       { return (1.f / sqrtf(v)); };
-
-inline f32 f32_sin(f32 v)         { return sinf(v); }
-inline f32 f32_cos(f32 v)         { return cosf(v); }
-inline f32 f32_atan(f32 v)        { return atanf(v); }
+static inline f32 f32_abs(f32 v)         { return fabsf(v); };
+static inline f32 f32_sqrt(f32 v)        { return sqrtf(v); };
+static inline f32 f32_pow(f32 v, f32 p)  { return powf(v, p); };
+static inline f32 f32_isqrt(f32 v)       { return (1.f / sqrtf(v)); };
+
+static inline f32 f32_sin(f32 v)         { return sinf(v); }
+static inline f32 f32_cos(f32 v)         { return cosf(v); }
+static inline f32 f32_atan(f32 v)        { return atanf(v); }
+
+// 32bit FNV-1a hash
+// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+static inline uint32_t FNV_hash_32(const char* str)
+{
+	// NOTE: These change based on the size of the output hash, see above webpage
+	static const uint32_t magic_offset = 0x811c9dc5;
+	static const uint32_t magic_prime = 16777619;
+
+	uint32_t hash = magic_offset;
+	while (*str != '\0')
+	{
+		hash ^= *str++;
+		hash *= magic_prime;
+	};       
+	return hash;                                           
+}
 
 // Atomic operations
-inline u32 u32_atomic_inc(volatile u32 *value)
+static inline u32 u32_atomic_inc(volatile u32 *value)
 {
 	return __sync_fetch_and_add(value, 1);
 };
-inline u64 u64_atomic_inc(volatile u64 *value)
+static inline u32 u32_atomic_dec(volatile u32 *value)
+{
+	return __sync_fetch_and_sub(value, 1);
+};
+static inline u64 u64_atomic_inc(volatile u64 *value)
 {
 	return __sync_fetch_and_add(value, 1);
 };
+// Compare and swap, stores desired if value is expected and returns true if it did
+static inline bool u32_atomic_cas(volatile u32 *value, u32 expected, u32 desired)
+{
+	return __sync_bool_compare_and_swap(value, expected, desired);
+};
+static inline bool u64_atomic_cas(volatile u64 *value, u64 expected, u64 desired)
+{
+	return __sync_bool_compare_and_swap(value, expected, desired);
+};
 
 // Ticket mutex implementation
 typedef struct
@@ -100,14 +130,121 @@ typedef struct
 	volatile u64 current;
 } ticket_mtx_t;
 
-inline void ticket_mtx_lock(ticket_mtx_t *mtx)
+static inline void ticket_mtx_lock(ticket_mtx_t *mtx)
 {
 	const u64 ticket = u64_atomic_inc(&mtx->next);
 	while (ticket != mtx->current) _mm_pause();
 };
-inline void ticket_mtx_unlock(ticket_mtx_t *mtx)
+static inline void ticket_mtx_unlock(ticket_mtx_t *mtx)
 {
 	u64_atomic_inc(&mtx->current);
 };
 
+// Linear (bump) allocator, everything is freed at once by arena_reset
+// NOTE: Pushes that don't fit go to overflow blocks, arena_reset merges them into one block so the arena settles at its high water mark
+typedef struct arena_block_t
+{
+	struct arena_block_t *next;
+	size_t size;
+} arena_block_t;
+typedef struct
+{
+	u8 *base;
+	size_t size;
+	size_t used;
+	// Blocks allocated since the last reset, and the bytes pushed into them
+	arena_block_t *overflow;
+	size_t overflow_used;
+	// Most bytes in use between two resets
+	size_t high_water;
+} arena_t;
+
+// Bytes in use since the last reset
+static inline size_t arena_used(const arena_t *arena)
+{
+	return arena->used + arena->overflow_used;
+};
+static inline bool arena_init(arena_t *arena, size_t size)
+{
+	memset(arena, 0, sizeof(arena_t));
+	arena->base = malloc(size);
+	if (arena->base)
+		arena->size = size;
+	return (arena->base != NULL);
+};
+static inline void arena_free_overflow(arena_t *arena)
+{
+	arena_block_t *block = arena->overflow;
+	while (block)
+	{
+		arena_block_t *next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->overflow = NULL;
+	arena->overflow_used = 0;
+};
+static inline void arena_free(arena_t *arena)
+{
+	arena_free_overflow(arena);
+	free(arena->base);
+	memset(arena, 0, sizeof(arena_t));
+};
+// Push size bytes aligned to align (a power of two up to 16), returns NULL if out of memory
+static inline void* arena_push(arena_t *arena, size_t size, size_t align)
+{
+	assert((align > 0) && (align <= 16) && !(align & (align - 1)));
+	// Malloc'd memory is 16 byte aligned, so offsets only need aligning
+	const size_t offset = (arena->used + align - 1) & ~(align - 1);
+	void *data = NULL;
+	if ((offset + size) <= arena->size)
+	{
+		arena->used = offset + size;
+		data = arena->base + offset;
+	} else {
+		// Out of space, give the push a block of its own until the next reset
+		// NOTE: The header is 16 bytes, so the data stays 16 byte aligned
+		arena_block_t *block = malloc(sizeof(arena_block_t) + size);
+		if (!block)
+			return NULL;
+		block->next = arena->overflow;
+		block->size = size;
+		arena->overflow = block;
+		arena->overflow_used += size;
+		data = block + 1;
+	}
+	arena->high_water = max(arena->high_water, arena_used(arena));
+	return data;
+};
+#define arena_push_array(ARENA, TYPE, COUNT)	((TYPE*) arena_push((ARENA), sizeof(TYPE)*(COUNT), _Alignof(TYPE)))
+// Free everything pushed since the last reset
+// NOTE: Grows the arena if it overflowed, at least doubling it so growth stops quickly
+static inline void arena_reset(arena_t *arena)
+{
+	if (arena->overflow)
+	{
+		arena_free_overflow(arena);
+		const size_t size = max(arena->size*2, arena->high_water);
+		u8 *base = malloc(size);
+		if (base)
+		{
+			free(arena->base);
+			arena->base = base;
+			arena->size = size;
+		}
+	}
+	arena->used = 0;
+};
+// Save/restore the arena position, for scratch memory within a frame
+// NOTE: Overflow blocks pushed since the mark are kept until the next reset
+static inline size_t arena_mark(const arena_t *arena)
+{
+	return arena->used;
+};
+static inline void arena_restore(arena_t *arena, size_t mark)
+{
+	assert(mark <= arena->used);
+	arena->used = mark;
+};
+
 #endif
\ No newline at end of file
@@ -1,3 +1,10 @@
+// Monotonic clocks are POSIX, not C11
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 #include "game.h"
 
 #define MAX_ENTITIES	(256)
@@ -16,18 +23,23 @@ typedef enum
 typedef struct
 {
 	aabb_t aabb;
-	image_t *image;
+	asset_handle_t image;
 } sprite_t;
 
 #define TILE_MAP_W		16
 #define TILE_MAP_H		8
 #define TILE_MAP_TILES	16
 
+// Tile map layers
+#define TILE_LAYER_FLOOR	0
+#define TILE_LAYER_WALLS	1
+
 typedef struct
 {
-	image_t *image;
-	aabb_t tiles[TILE_MAP_TILES];
-	u8 data[TILE_MAP_H][TILE_MAP_W];
+	asset_handle_t image;
+	// Floor and wall tiles, the texture is set once the image is loaded
+	tilemap_t *map;
+	bool has_texture;
 } tile_map_t;
 
 typedef struct
@@ -50,8 +62,8 @@ static void     free_world(world_t *world, assets_t *assets);
 static entity_t create_entity(world_t *world, component_set_t components);
 static void     destroy_entity(world_t *world, assets_t *assets, entity_t entity);
 
-static void system_draw_tile_map(world_t *world, v2 camera, f64 delta);
-static void system_draw_sprites(world_t *world, v2 camera, f64 delta);
+static void system_draw_tile_map(world_t *world, assets_t *assets, v2 camera, f64 delta);
+static void system_draw_sprites(world_t *world, assets_t *assets, v2 camera, f64 delta);
 
 static entity_t create_player(world_t *world, assets_t *assets, v2 pos)
 {
@@ -99,34 +111,109 @@ static void create_tile_map(world_t *world, assets_t *assets)
 
 	tile_map_t *tile_map = &world->tile_map;
 	tile_map->image = get_image_asset(assets, "data/dungeon_sheet.png");
-	memcpy(tile_map->tiles, tiles, sizeof(tiles));
-	memcpy(tile_map->data, data, sizeof(data));
+	tile_map->map = tilemap_alloc(TILE_MAP_W, TILE_MAP_H, 2, tiles, TILE_MAP_TILES, 16.f);
+	tile_map->has_texture = false;
+	if (!tile_map->map)
+		return;
+	// Floor everywhere, walls where the data has a tile
+	for (u32 j = 0; j < TILE_MAP_H; j++)
+	{
+		for (u32 i = 0; i < TILE_MAP_W; i++)
+		{
+			tilemap_set(tile_map->map, TILE_LAYER_FLOOR, i, j, 0);
+			if (data[j][i] != 0)
+				tilemap_set(tile_map->map, TILE_LAYER_WALLS, i, j, data[j][i]);
+		}
+	}
 };
 
 static world_t *g_world;
 static assets_t *g_assets;
+// Packed data, NULL to use the loose files in data/
+static archive_t *g_archive;
 
 static entity_t g_player;
 
+#if DEBUG
+// Watches the loose shader files, they are rebuilt on the rendering thread once the flag is set
+static watch_t *g_shader_watch;
+static volatile u32 g_shader_changed;
+static f64 g_shader_changed_ms;
+// Asset reloads reported so far
+static asset_reload_stats_t g_reload_stats;
+
+static f64 game_time_ms()
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (f64) counter.QuadPart*1e3 / (f64) frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+#endif
+};
+static void shader_changed(const char *file_name, u64 id, void *user)
+{
+	g_shader_changed_ms = game_time_ms();
+	g_shader_changed = 1;
+};
+#endif
+
 bool init_game()
 {
-	if (r2d_init())
+	// Prefer the packed data (see tools/pack.c), the shaders are read straight from the mapping
+	r2d_config_t config = {0};
+	// Stream textures in over several frames rather than stalling one
+	config.upload_budget_bytes = megabytes(4);
+	config.upload_budget_ms = 2.f;
+	g_archive = archive_open("data.pak");
+	if (g_archive)
+	{
+		config.vertex_shader = archive_find(g_archive, "data/shader.vert", NULL);
+		config.fragment_shader = archive_find(g_archive, "data/shader.frag", NULL);
+	}
+	if (r2d_init(&config))
 	{
 		g_world = alloc_world();
-		g_assets = alloc_assets();
+		// Decoded images are kept in cache/, so later runs skip PNG decoding
+		g_assets = alloc_assets(0, g_archive, "cache");
+
+#if DEBUG
+		// Hot reload loose images and shaders while working on them
+		watch_assets(g_assets);
+		if (!config.vertex_shader && !config.fragment_shader)
+		{
+			g_shader_watch = watch_alloc(shader_changed, NULL);
+			if (g_shader_watch)
+			{
+				watch_add(g_shader_watch, "data/shader.vert", 0);
+				watch_add(g_shader_watch, "data/shader.frag", 0);
+			}
+		}
+#endif
 
 		create_tile_map(g_world, g_assets);
 		g_player = create_player(g_world, g_assets, V2(100.f, 100.f));
 
 		return true;
 	}
+	archive_close(g_archive);
+	g_archive = NULL;
 	return false;
 };
 void free_game()
 {
+#if DEBUG
+	watch_free(g_shader_watch);
+	g_shader_watch = NULL;
+#endif
 	free_world(g_world, g_assets);
 	free_assets(g_assets);
 	r2d_free();
+	archive_close(g_archive);
 }
 void update_and_draw_game(i32 width, i32 height, f64 delta)
 {
@@ -134,10 +221,29 @@ void update_and_draw_game(i32 width, i32 height, f64 delta)
 	camera = v2_sub(g_world->transform[g_player].pos, camera);
 	camera = v2_scale(camera, 0.25f);
 
+#if DEBUG
+	// Rebuild changed shaders here, the rendering thread owns the GL context
+	if (g_shader_changed && __sync_bool_compare_and_swap(&g_shader_changed, 1, 0))
+	{
+		if (r2d_reload_shader(NULL, NULL))
+			printf("Reloaded shaders (%.1f ms)\n", game_time_ms() - g_shader_changed_ms);
+		else
+			fprintf(stderr, "Failed to reload shaders, keeping the old ones\n");
+	}
+	// Report the images reloaded since the last frame
+	const asset_reload_stats_t reload_stats = get_asset_reload_stats(g_assets);
+	if (reload_stats.reloads != g_reload_stats.reloads)
+		printf("Reloaded %u image(s) (%.1f ms)\n", reload_stats.reloads - g_reload_stats.reloads, reload_stats.last_ms);
+	if (reload_stats.failed != g_reload_stats.failed)
+		fprintf(stderr, "Failed to reload %u image(s)\n", reload_stats.failed - g_reload_stats.failed);
+	g_reload_stats = reload_stats;
+#endif
+
 	r2d_clear(width, height);
 	{
-		system_draw_tile_map(g_world, camera, delta);
-		system_draw_sprites(g_world, camera, delta);
+		// The map is a static layer, so it stays beneath the entities
+		system_draw_tile_map(g_world, g_assets, camera, delta);
+		system_draw_sprites(g_world, g_assets, camera, delta);
 	}
 	r2d_flush();
 };
@@ -158,6 +264,8 @@ static world_t* alloc_world()
 };
 static void free_world(world_t *world, assets_t *assets)
 {
+	tilemap_free(world->tile_map.map);
+	release_asset(assets, world->tile_map.image);
 	for (u32 i = 0; i < world->entity_count; i++)
 	{
 		destroy_entity(world, assets, i);
@@ -186,60 +294,34 @@ static void destroy_entity(world_t *world, assets_t *assets, entity_t entity)
 	if (world->components[entity] & COMPONENT_SPRITE)
 	{
 		sprite_t *sprite = world->sprite + entity;
-		release_asset(assets, (asset_t*) sprite->image);
+		release_asset(assets, sprite->image);
 	};
 
 	world->next_free[entity] = world->free_entity;
 	world->free_entity = entity;
 };
 
-static void system_draw_tile_map(world_t *world, v2 camera, f64 delta)
+static void system_draw_tile_map(world_t *world, assets_t *assets, v2 camera, f64 delta)
 {
-	const tile_map_t *tile_map = &world->tile_map;
-	const image_t *image = tile_map->image;
-	// Draw floor
-	for (u32 j = 0; j < TILE_MAP_H; j++)
+	tile_map_t *tile_map = &world->tile_map;
+	const image_t *image = get_image(assets, tile_map->image);
+	if (!tile_map->map || !image)
+		return;
+	if (image->asset.state != ASSET_STATE_LOADED)
 	{
-		for (u32 i = 0; i < TILE_MAP_W; i++)
-		{
-			const aabb_t aabb = tile_map->tiles[0];
-
-			xform2d_t xform = xform2d_id();
-			xform.pos = V2(i*16.f, j*16.f);
-
-			xform.pos = v2_sub(xform.pos, camera);
-
-			if (image->asset.state == ASSET_STATE_LOADED)
-			{
-				r2d_texture_t *texture = image->texture; 
-				r2d_draw_sprite(texture, aabb, xform);
-			}
-		}
+		// Load what's on screen first
+		prioritize_asset(assets, tile_map->image, ASSET_PRIORITY_VISIBLE);
+		return;
 	}
-	// Draw map
-	for (u32 j = 0; j < TILE_MAP_H; j++)
+	if (!tile_map->has_texture)
 	{
-		for (u32 i = 0; i < TILE_MAP_W; i++)
-		{
-			const u8 data = tile_map->data[j][i];
-			if (data == 0)
-				continue;
-			const aabb_t aabb = tile_map->tiles[data];
-
-			xform2d_t xform = xform2d_id();
-			xform.pos = V2(i*16.f, j*16.f);
-
-			xform.pos = v2_sub(xform.pos, camera);
-
-			if (image->asset.state == ASSET_STATE_LOADED)
-			{
-				r2d_texture_t *texture = image->texture; 
-				r2d_draw_sprite(texture, aabb, xform);
-			}
-		};
-	};
+		tilemap_set_texture(tile_map->map, image->texture);
+		tile_map->has_texture = true;
+	}
+	// Tiles cover [i, i + 1)*16, the map was drawn with tiles centered on i*16
+	tilemap_draw(tile_map->map, v2_add(camera, V2(8.f, 8.f)));
 };
-static void system_draw_sprites(world_t *world, v2 camera, f64 delta)
+static void system_draw_sprites(world_t *world, assets_t *assets, v2 camera, f64 delta)
 {
 	const component_set_t components = (COMPONENT_TRANSFORM | COMPONENT_SPRITE);
 	for (u32 i = 0; i < world->entity_count; i++)
@@ -251,11 +333,14 @@ static void system_draw_sprites(world_t *world, v2 camera, f64 delta)
 			xform2d_t xform = world->transform[i];
 			xform.pos = v2_sub(xform.pos, camera);
 
-			const image_t *image = sprite->image;
-			if (image->asset.state == ASSET_STATE_LOADED)
+			const image_t *image = get_image(assets, sprite->image);
+			if (image && (image->asset.state == ASSET_STATE_LOADED))
 			{
 				r2d_texture_t *texture = image->texture; 
 				r2d_draw_sprite(texture, sprite->aabb, xform);
+			} else if ((xform.pos.x >= 0.f) && (xform.pos.x < R2D_SCREEN_W) && (xform.pos.y >= 0.f) && (xform.pos.y < R2D_SCREEN_H)) {
+				// On screen, load it before anything off screen
+				prioritize_asset(assets, sprite->image, ASSET_PRIORITY_VISIBLE);
 			}
 		};
 	};
@@ -6,6 +6,8 @@
 #include "geom.h"
 #include "assets.h"
 #include "render2d.h"
+#include "tilemap.h"
+#include "watch.h"
 
 bool init_game();
 void free_game();
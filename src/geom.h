@@ -49,23 +49,23 @@ typedef union
 } m44;
 
 /* V2 */
-inline v2 V2(f32 x, f32 y)
+static inline v2 V2(f32 x, f32 y)
 {
 	v2 v;
 	v.x = x;
 	v.y = y;
 	return v;
 }
-inline v2  v2_add(v2 a, v2 b)		{ return V2(a.x+b.x, a.y+b.y); };
-inline v2  v2_sub(v2 a, v2 b)  		{ return V2(a.x-b.x, a.y-b.y); };
-inline v2  v2_mul(v2 a, v2 b)	    { return V2(a.x*b.x, a.y*b.y); };
-inline v2  v2_scale(v2 v, f32 s)	{ return V2(v.x*s, v.y*s); };
-inline v2  v2_neg(v2 v)  			{ return V2(-v.x, -v.y); };
-inline v2  v2_perp(v2 v)			{ return V2(v.y, -v.x); }
-inline f32 v2_cross(v2 a, v2 b)		{ return a.x*b.y - a.y*b.x; };
-inline f32 v2_dot(v2 a, v2 b)		{ return a.x*b.x + a.y*b.y; };
-inline f32 v2_len2(v2 v)			{ return v2_dot(v, v); };
-inline v2  v2_norm(v2 v)	
+static inline v2  v2_add(v2 a, v2 b)		{ return V2(a.x+b.x, a.y+b.y); };
+static inline v2  v2_sub(v2 a, v2 b)  		{ return V2(a.x-b.x, a.y-b.y); };
+static inline v2  v2_mul(v2 a, v2 b)	    { return V2(a.x*b.x, a.y*b.y); };
+static inline v2  v2_scale(v2 v, f32 s)	{ return V2(v.x*s, v.y*s); };
+static inline v2  v2_neg(v2 v)  			{ return V2(-v.x, -v.y); };
+static inline v2  v2_perp(v2 v)			{ return V2(v.y, -v.x); }
+static inline f32 v2_cross(v2 a, v2 b)		{ return a.x*b.y - a.y*b.x; };
+static inline f32 v2_dot(v2 a, v2 b)		{ return a.x*b.x + a.y*b.y; };
+static inline f32 v2_len2(v2 v)			{ return v2_dot(v, v); };
+static inline v2  v2_norm(v2 v)	
 {
 	const f32 l2 = v2_len2(v);
 	if(l2 > 1e-8f)
@@ -74,7 +74,7 @@ inline v2  v2_norm(v2 v)
 }
 
 /* V3 */
-inline v3 V3(f32 x, f32 y, f32 z)
+static inline v3 V3(f32 x, f32 y, f32 z)
 {
 	v3 v;
 	v.x = x;
@@ -83,7 +83,7 @@ inline v3 V3(f32 x, f32 y, f32 z)
 	return v;
 }
 
-inline v3 v3_cross(v3 a, v3 b)
+static inline v3 v3_cross(v3 a, v3 b)
 {
 	v3 r;
 	r.x = a.y*b.z - a.z*b.y;
@@ -93,7 +93,7 @@ inline v3 v3_cross(v3 a, v3 b)
 };
 
 /* V4 */
-inline v4 V4(f32 x, f32 y, f32 z, f32 w)
+static inline v4 V4(f32 x, f32 y, f32 z, f32 w)
 {
 	v4 v;
 	v.x = x;
@@ -104,7 +104,7 @@ inline v4 V4(f32 x, f32 y, f32 z, f32 w)
 }
 
 /* M22 */
-inline m22 m22_identity()
+static inline m22 m22_identity()
 {
 	return (m22)
 	{{
@@ -112,7 +112,7 @@ inline m22 m22_identity()
 		0.f, 1.f,
 	}};
 };
-inline m22 m22_rotation(f32 theta)
+static inline m22 m22_rotation(f32 theta)
 {
 	const f32 c = f32_cos(theta);
 	const f32 s = f32_sin(theta);
@@ -122,7 +122,7 @@ inline m22 m22_rotation(f32 theta)
 		s,   c,
 	}};
 };
-inline v2 m22_transform(m22 m, v2 v)
+static inline v2 m22_transform(m22 m, v2 v)
 {
 	v2 r;
 	r.x = v.x*m.x0 + v.y*m.y0;
@@ -131,28 +131,28 @@ inline v2 m22_transform(m22 m, v2 v)
 };
 
 /* XFORM */
-inline xform2d_t xform2d(v2 pos, f32 angle)
+static inline xform2d_t xform2d(v2 pos, f32 angle)
 {
 	xform2d_t xform;
 	xform.pos = pos;
 	xform.rot = m22_rotation(angle);
 	return xform;
 };
-inline xform2d_t xform2d_id()
+static inline xform2d_t xform2d_id()
 {
 	xform2d_t xform;
 	xform.pos = V2(0.f,0.f);
 	xform.rot = m22_identity();
 	return xform;
 };
-inline v2 xform2d_apply(xform2d_t xform, v2 v)
+static inline v2 xform2d_apply(xform2d_t xform, v2 v)
 {
 	return v2_add(xform.pos, m22_transform(xform.rot, v));
 };
 
 
 /* M44 */
-inline m44 m44_identity()
+static inline m44 m44_identity()
 {
 	return (m44)
 	{{
@@ -162,7 +162,7 @@ inline m44 m44_identity()
 		0.f, 0.f, 0.f, 1.f,
 	}};
 };
-inline m44 m44_scale(f32 x, f32 y, f32 z)
+static inline m44 m44_scale(f32 x, f32 y, f32 z)
 {
 	return (m44)
 	{{
@@ -172,7 +172,7 @@ inline m44 m44_scale(f32 x, f32 y, f32 z)
 		0.f, 0.f, 0.f, 1.f,
 	}};
 };
-inline m44 m44_rotationZ(f32 theta)
+static inline m44 m44_rotationZ(f32 theta)
 {
 	const f32 c = f32_cos(theta);
 	const f32 s = f32_sin(theta);
@@ -184,7 +184,7 @@ inline m44 m44_rotationZ(f32 theta)
 		0.f, 0.f, 0.f, 1.f,
 	}};
 };
-inline m44 m44_translation(f32 x, f32 y, f32 z)
+static inline m44 m44_translation(f32 x, f32 y, f32 z)
 {
 	return (m44)
 	{{
@@ -194,7 +194,7 @@ inline m44 m44_translation(f32 x, f32 y, f32 z)
 		x,   y,   z,   1.f,
 	}};
 };
-inline m44 m44_orthoOffCenter(f32 l, f32 r, f32 b, f32 t, f32 zn, f32 zf)
+static inline m44 m44_orthoOffCenter(f32 l, f32 r, f32 b, f32 t, f32 zn, f32 zf)
 {
 	const f32 sx = (2.f / (r-l));
 	const f32 sy = (2.f / (t-b));
@@ -212,7 +212,7 @@ inline m44 m44_orthoOffCenter(f32 l, f32 r, f32 b, f32 t, f32 zn, f32 zf)
 		tx,  ty,  tz, 1.f,
 	}};
 };
-inline m44 m44_mul(m44 a, m44 b)
+static inline m44 m44_mul(m44 a, m44 b)
 {
 	m44 out;
 	for(u32 i = 0; i < 4; i++)
@@ -234,7 +234,7 @@ typedef struct
 	v2 min, max;
 } aabb_t;
 
-inline aabb_t aabb_rect(f32 x, f32 y, f32 w, f32 h)
+static inline aabb_t aabb_rect(f32 x, f32 y, f32 w, f32 h)
 {
 	aabb_t aabb;
 	aabb.min.x = x;
@@ -243,13 +243,13 @@ inline aabb_t aabb_rect(f32 x, f32 y, f32 w, f32 h)
 	aabb.max.y = y+h;
 	return aabb;
 };
-inline f32 aabb_perimeter(aabb_t aabb)
+static inline f32 aabb_perimeter(aabb_t aabb)
 {
 	const f32 d_x = aabb.max.x - aabb.min.x;
 	const f32 d_y = aabb.max.y - aabb.min.y;
 	return 2.f*(d_x+d_y);
 };
-inline bool aabbs_overlap(aabb_t aabb_a, aabb_t aabb_b)
+static inline bool aabbs_overlap(aabb_t aabb_a, aabb_t aabb_b)
 {
 	const bool x_min = (aabb_a.min.x <= aabb_b.max.x); 
 	const bool x_max = (aabb_a.max.x >= aabb_b.min.x);
@@ -257,7 +257,7 @@ inline bool aabbs_overlap(aabb_t aabb_a, aabb_t aabb_b)
 	const bool y_max = (aabb_a.max.y >= aabb_b.min.y); 
 	return x_min && x_max && y_min && y_max;
 };
-inline aabb_t aabbs_merge(aabb_t aabb_a, aabb_t aabb_b)
+static inline aabb_t aabbs_merge(aabb_t aabb_a, aabb_t aabb_b)
 {
 	aabb_t aabb;
 	aabb.min.x = min(aabb_a.min.x, aabb_b.min.x); 
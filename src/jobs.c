@@ -0,0 +1,145 @@
+#include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "jobs.h"
+
+// Spins waiting for workers before yielding the thread
+#define JOBS_SPIN_COUNT		(1024)
+
+static struct
+{
+	// Worker threads, woken once per loop
+	u32 worker_count;
+	pthread_t workers[JOBS_MAX_WORKERS];
+	sem_t wake;
+	volatile bool done;
+
+	// Current loop
+	job_func_t func;
+	void *data;
+	u32 count;
+	u32 chunk_size;
+	u32 chunk_count;
+	// Next chunk to hand out
+	volatile u32 next_chunk;
+	// Workers woken for the loop that haven't finished yet
+	volatile u32 active;
+} g_jobs;
+
+// Take chunks of the current loop until there are none left
+static void jobs_run_chunks()
+{
+	for (;;)
+	{
+		const u32 chunk = u32_atomic_inc(&g_jobs.next_chunk);
+		if (chunk >= g_jobs.chunk_count)
+			break;
+		const u32 begin = chunk*g_jobs.chunk_size;
+		const u32 end = min(begin + g_jobs.chunk_size, g_jobs.count);
+		g_jobs.func(g_jobs.data, begin, end);
+	}
+};
+static void* jobs_worker_proc(void *data)
+{
+	for (;;)
+	{
+		// Wait for a loop (or the termination signal)
+		sem_wait(&g_jobs.wake);
+		if (g_jobs.done)
+			break;
+		jobs_run_chunks();
+		u32_atomic_dec(&g_jobs.active);
+	}
+	return NULL;
+};
+
+bool jobs_init(u32 worker_count)
+{
+	memset(&g_jobs, 0, sizeof(g_jobs));
+	if (sem_init(&g_jobs.wake, 0, 0) != 0)
+		return false;
+	worker_count = min(worker_count, JOBS_MAX_WORKERS);
+	for (u32 i = 0; i < worker_count; i++)
+	{
+		if (pthread_create(g_jobs.workers + i, NULL, jobs_worker_proc, NULL) != 0)
+			break;
+		g_jobs.worker_count ++;
+	}
+	// Couldn't start every worker, stop the ones that did start
+	if (g_jobs.worker_count != worker_count)
+	{
+		jobs_free();
+		return false;
+	}
+	return true;
+};
+void jobs_free()
+{
+	// Wake every worker with the termination signal set
+	g_jobs.done = true;
+	for (u32 i = 0; i < g_jobs.worker_count; i++)
+		sem_post(&g_jobs.wake);
+	for (u32 i = 0; i < g_jobs.worker_count; i++)
+		pthread_join(g_jobs.workers[i], NULL);
+	sem_destroy(&g_jobs.wake);
+	g_jobs.worker_count = 0;
+};
+
+u32 jobs_worker_count()
+{
+	return g_jobs.worker_count;
+};
+u32 jobs_core_count()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	const i64 count = (i64) info.dwNumberOfProcessors;
+#else
+	const i64 count = (i64) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return (count > 0) ? (u32) count : 1;
+};
+
+void jobs_parallel_for(u32 count, u32 chunk_size, job_func_t func, void *data)
+{
+	assert(chunk_size > 0);
+	const u32 chunk_count = (count + chunk_size - 1) / chunk_size;
+	// The calling thread takes a chunk too, so a single chunk wakes nobody
+	const u32 wake_count = (chunk_count > 1) ? min(g_jobs.worker_count, chunk_count - 1) : 0;
+	if (wake_count == 0)
+	{
+		// Still one call per chunk, callers may keep per chunk results
+		for (u32 begin = 0; begin < count; begin += chunk_size)
+			func(data, begin, min(begin + chunk_size, count));
+		return;
+	}
+	assert(g_jobs.active == 0);
+	g_jobs.func = func;
+	g_jobs.data = data;
+	g_jobs.count = count;
+	g_jobs.chunk_size = chunk_size;
+	g_jobs.chunk_count = chunk_count;
+	g_jobs.next_chunk = 0;
+	g_jobs.active = wake_count;
+	// Posting the semaphore publishes the loop to the workers
+	for (u32 i = 0; i < wake_count; i++)
+		sem_post(&g_jobs.wake);
+	jobs_run_chunks();
+	// Wait for the workers, a worker only finishes once every chunk has been taken
+	// NOTE: The loop state has to stay put until then, so this also waits for late wakers
+	for (u32 spin = 0; g_jobs.active; spin++)
+	{
+		// Give up the core if a worker hasn't been scheduled yet
+		if (spin < JOBS_SPIN_COUNT)
+			_mm_pause();
+		else
+			sched_yield();
+	}
+};
@@ -0,0 +1,26 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "core.h"
+
+// Maximum worker threads in the pool
+#define JOBS_MAX_WORKERS	(64)
+
+// Job function, processes the items [begin, end) of a parallel loop
+typedef void (*job_func_t)(void *data, u32 begin, u32 end);
+
+// Start/stop the worker pool
+// NOTE: With zero workers every loop runs on the calling thread
+bool jobs_init(u32 worker_count);
+void jobs_free();
+
+// Number of worker threads, not counting the calling thread
+u32 jobs_worker_count();
+// Number of logical cores on the machine, at least 1
+u32 jobs_core_count();
+
+// Run func over [0, count) in chunks of chunk_size items, blocks until every chunk is done
+// NOTE: The calling thread works on chunks too, loops must not be started from inside a job
+void jobs_parallel_for(u32 count, u32 chunk_size, job_func_t func, void *data);
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef MPMC_H
+#define MPMC_H
+
+#include <stdatomic.h>
+
+#include "core.h"
+
+// Bounded lock-free multi-producer/multi-consumer queue of u64 values (Dmitry Vyukov's design)
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// Every cell carries a sequence number saying whose turn it is: a producer may write cell i once its
+// sequence is i, a consumer may read it once it is i + 1, and reading hands it to the producer one lap ahead
+// NOTE: Neither side waits on the other, a full or empty queue fails the push/pop instead
+
+// Cache line size, the producer and consumer positions get a line each
+#define MPMC_CACHE_LINE	(64)
+
+typedef struct
+{
+	atomic_size_t sequence;
+	u64 value;
+} mpmc_cell_t;
+
+typedef struct
+{
+	_Alignas(MPMC_CACHE_LINE) atomic_size_t enqueue_pos;
+	_Alignas(MPMC_CACHE_LINE) atomic_size_t dequeue_pos;
+	_Alignas(MPMC_CACHE_LINE) mpmc_cell_t *cells;
+	size_t mask;
+} mpmc_queue_t;
+
+// Create/destroy a queue, capacity must be a power of two
+static inline bool mpmc_init(mpmc_queue_t *queue, size_t capacity)
+{
+	assert((capacity >= 2) && !(capacity & (capacity - 1)));
+	queue->cells = malloc(capacity*sizeof(mpmc_cell_t));
+	if (!queue->cells)
+		return false;
+	queue->mask = capacity - 1;
+	for (size_t i = 0; i < capacity; i++)
+		atomic_init(&queue->cells[i].sequence, i);
+	atomic_init(&queue->enqueue_pos, 0);
+	atomic_init(&queue->dequeue_pos, 0);
+	return true;
+};
+static inline void mpmc_free(mpmc_queue_t *queue)
+{
+	free(queue->cells);
+	queue->cells = NULL;
+};
+
+// Push a value, returns false if the queue is full
+static inline bool mpmc_push(mpmc_queue_t *queue, u64 value)
+{
+	size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+	for (;;)
+	{
+		mpmc_cell_t *cell = queue->cells + (pos & queue->mask);
+		// Acquire, so the consumer's read of the cell happens before we overwrite it
+		const size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		const intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+		if (diff == 0)
+		{
+			// The cell is free, claim it by moving the position on
+			// NOTE: A failed exchange reloads pos, so the loop retries with the current position
+			if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+			{
+				cell->value = value;
+				// Release, publishing the value to the consumer
+				atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+				return true;
+			}
+		} else if (diff < 0) {
+			// The cell still holds the value from a lap ago, the queue is full
+			return false;
+		} else {
+			// Another producer took the cell
+			pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+		}
+	}
+};
+// Pop a value, returns false if the queue is empty
+// NOTE: Also fails while the oldest push is claimed but not yet written, even if later pushes are done
+static inline bool mpmc_pop(mpmc_queue_t *queue, u64 *value)
+{
+	size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+	for (;;)
+	{
+		mpmc_cell_t *cell = queue->cells + (pos & queue->mask);
+		// Acquire, pairing with the producer's release so the value is visible
+		const size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		const intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+			{
+				*value = cell->value;
+				// Release, handing the cell to the producer a lap ahead
+				atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+				return true;
+			}
+		} else if (diff < 0) {
+			// Nothing written to the cell yet, the queue is empty
+			return false;
+		} else {
+			// Another consumer took the cell
+			pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+		}
+	}
+};
+
+#endif
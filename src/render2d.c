@@ -1,73 +1,36 @@
-#include "render2d.h"
+// Monotonic clocks are POSIX, not C11
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "render2d_backend.h"
+#include "render2d_atlas.h"
+#include "render2d_simd.h"
+#include "jobs.h"
 
 #define MAX_TEXTURES		(256)
-// Maximum draw commands allowed in the draw list 
-#define MAX_DRAW_CMDS		(1024)
+// Draw commands per draw list chunk
+#define DRAW_CHUNK_CMDS		(4096)
+// Initial size of each frame arena, they grow to fit the largest frame
+#define FRAME_ARENA_SIZE	(megabytes(1))
 // Batch limits
-#define MAX_BATCH_RANGES	(1024)
-#define MAX_BATCH_VERTS		(MAX_DRAW_CMDS*6)
-
-// Helper function for loading a file from disk
-static u8* r2d_load_entire_file(const char *file_name, size_t *size)
-{
-	u8* buffer = NULL;
-
-	FILE *f = fopen(file_name, "rb");
-	if (f)
-	{
-		fseek(f, 0, SEEK_END);
-		const size_t f_size = ftell(f);
-		fseek(f, 0, SEEK_SET);
-
-		buffer = malloc((f_size+1)*sizeof(u8));
-		assert(buffer != NULL);
-		fread(buffer, sizeof(u8), f_size, f);
-		fclose(f);
+// NOTE: One range per sprite worst case, so only the vertex count can fill a batch
+#define MAX_BATCH_RANGES	(R2D_MAX_BATCH_SPRITES)
+// Sprites written per job when building a batch
+#define BATCH_JOB_SPRITES	(1024)
+#define BATCH_JOB_COUNT		((R2D_MAX_BATCH_SPRITES + BATCH_JOB_SPRITES - 1) / BATCH_JOB_SPRITES)
+// Largest strip of rows uploaded at once, so a time budget is checked between strips of large textures
+#define UPLOAD_STRIP_BYTES	(megabytes(1))
 
-		buffer[f_size] = '\0';
+// Draw command sort key layout, from most to least significant
+// NOTE: The sequence number is the command's position in the draw list, so draws with equal keys keep call order
+#define SORT_LAYER_SHIFT	(56)
+#define SORT_SHADER_SHIFT	(48)	// Reserved, there is a single sprite shader for now
+#define SORT_TEXTURE_SHIFT	(32)	// 16 bits, a dense id of the backend texture rather than its handle (see r2d_texture_sort_id)
+#define SORT_SEQUENCE_MASK	(0xFFFFFFFFull)
 
-		if (size) *size = f_size;
-	};
-	return buffer;
-};
-
-// Structure for describing OpenGL vertex layouts
-typedef struct
-{
-	u32 size;			// Size (in # of members) of the vertex attrib
-	GLenum type;		// Type (BYTE, SHORT, FLOAT, etc)
-	bool normalized;	// Normalized? (See OpenGL docs) 
-	size_t stride;		// Stride in bytes to next instance of this attrib
-	size_t offset;		// Offset in bytes from the beginning of the vertex data to this attrib
-} r2d_vertex_layout_t;
-
-// Bind a vertex layout array
-static inline void r2d_bind_vertex_layout(const r2d_vertex_layout_t *layout, size_t len)
-{
-	for (size_t i = 0; i < len; i++)
-	{
-		glEnableVertexAttribArray(i);
-		glVertexAttribPointer(i, 
-			layout[i].size,
-			layout[i].type,
-			layout[i].normalized,
-			layout[i].stride,
-			(const void*) layout[i].offset);
-	}
-};
-
-// Default vertex structure
-typedef struct
-{
-	v2 pos;
-	v2 uv;
-} r2d_vertex_t;
-// Default vertex structure layout
-static const r2d_vertex_layout_t g_vertex_layout[] =
-{
-	{ 2, GL_FLOAT, false, sizeof(r2d_vertex_t), offsetof(r2d_vertex_t, pos) },
-	{ 2, GL_FLOAT, false, sizeof(r2d_vertex_t), offsetof(r2d_vertex_t, uv) },
-};
 // Helper, create a vertex struct
 static inline r2d_vertex_t r2d_vertex(v2 pos, v2 uv)
 {
@@ -76,61 +39,68 @@ static inline r2d_vertex_t r2d_vertex(v2 pos, v2 uv)
 	vertex.uv = uv;
 	return vertex;
 }
-
-// Default drawing shader
-static struct
+// Helper, convert [0,1] to a normalized u16
+// NOTE: Clamped after the integer conversion, float clamps compile to branches here
+static inline u16 r2d_unorm16(f32 v)
 {
-	u32 program;
-	// Locations
-	u32 u_projection;
-	u32 u_sampler;
-} g_draw_shader;
+	const i32 i = (i32) (v*(f32) U16_MAX + 0.5f);
+	return (u16) clamp(i, 0, U16_MAX);
+}
+// Helper, convert a position to packed sub-pixel units, clamped to the i16 range
+static inline i16 r2d_packed_pos(f32 v)
+{
+	const i32 i = _mm_cvt_ss2si(_mm_set_ss(v*(f32) R2D_PACKED_POS_SCALE));
+	return (i16) clamp(i, -32768, 32767);
+}
 
-static bool r2d_load_draw_shader();
-static void r2d_free_draw_shader();
+// Active configuration and backend
+static r2d_config_t g_config;
+static const r2d_backend_t *g_backend;
+// Sprite corner kernel, selected for the CPU at init
+static r2d_corner_kernel_t g_corner_kernel;
 
-// Viewport structure, used for resolution independent rendering
-static struct
-{
-	// Viewport coordinates
-	int x,y,w,h;
-	// Viewport scale
-	v2 scale;
-	// Viewport projection matrix
-	m44 projection;
-} g_viewport;
+// Viewport for the current frame
+static r2d_viewport_t g_viewport;
+// Visible part of the virtual screen, sprites outside it are culled
+static aabb_t g_cull_rect;
+// Framebuffer size for the current frame
+static u32 g_frame_w, g_frame_h;
 
-static void r2d_calculate_viewport(u32 width, u32 height);
+// Statistics, reset every flush
+static r2d_stats_t g_stats;
 
-typedef struct
-{
-	// Range texture
-	u32 texture_handle;
-	// Range coordinates
-	u32 offset; // Offset, in number of vertices
-	u32 count;	// Count, in number of vertices
-} r2d_batch_range_t;
+// Per-frame memory, swapped and reset by r2d_clear
+// NOTE: Double buffered, so allocations stay valid until the end of the following frame
+static arena_t g_frame_arenas[2];
+static arena_t *g_frame_arena;
 
-// Double buffered dynamic vertex array, used for quickly rendering many sprites
+static void r2d_calculate_viewport(u32 width, u32 height);
+
+// Current batch, handed to the backend when flushed
+// NOTE: Holds vertices or instances depending on the batch mode
 static struct
 {
-	// Current buffer to write to
-	u32 current;
-	// OpenGL handles
-	u32 vao[2];
-	u32 buf[2];
-	// Vertex array, host allocated
-	u32 vertex_count;
-	r2d_vertex_t *vertices;
-	// Range list
+	// Elements written per sprite, and the size of one element
+	u32 sprite_elements;
+	size_t element_size;
+	// Element array, mapped from the backend by the first sprite of a batch
+	u32 capacity;
+	u32 count;
+	void *data;
+	// Range list, from the frame arena
 	u32 range_count;
 	r2d_batch_range_t *ranges;
+	// Sort keys of the sprites being written
+	const u64 *keys;
+	// Ranges found by each job, job i writes them from job_ranges[i*BATCH_JOB_SPRITES]
+	// NOTE: From the frame arena, like ranges
+	u32 job_range_counts[BATCH_JOB_COUNT];
+	r2d_batch_range_t *job_ranges;
 } g_batch;
 
 static void r2d_alloc_batch();
-static void r2d_free_batch();
 
-static void r2d_push_sprite(const r2d_texture_t *texture, aabb_t sprite, xform2d_t xform);
+static void r2d_build_batch(const u64 *keys, u32 count);
 static void r2d_flush_batch();
 
 typedef struct
@@ -138,15 +108,45 @@ typedef struct
 	aabb_t sprite;
 	xform2d_t xform;
 	r2d_texture_t *texture;
+	u32 layer;
+	u32 tint;
 } draw_cmd_t;
+// Fixed size block of draw commands
+// NOTE: Chunks come from the frame arena, so the list never mallocs once the arena has grown to fit
+typedef struct draw_chunk_t
+{
+	u32 cmd_count;
+	draw_cmd_t cmds[DRAW_CHUNK_CMDS];
+	struct draw_chunk_t *next;
+} draw_chunk_t;
 static struct
 {
+	// Total commands and chunks in the list
 	u32 cmd_count;
-	draw_cmd_t *cmds;
+	u32 chunk_count;
+	// Chunk list, commands are written to the current chunk
+	draw_chunk_t *head;
+	draw_chunk_t *current;
+	// Layer of new commands
+	u32 layer;
 } g_draw_list;
 
-static bool r2d_alloc_draw_list();
-static void r2d_free_draw_list();
+static draw_chunk_t* r2d_alloc_draw_chunk();
+static void r2d_reset_draw_list();
+
+// Draw list sort buffers
+// NOTE: From the frame arena, sized for the draw list when it is sorted
+static struct
+{
+	// Sort keys, and the radix sort scratch buffer
+	u32 count;
+	u64 *keys;
+	u64 *temp;
+	// Chunk table, to find commands by sequence number
+	const draw_chunk_t **chunks;
+} g_sort;
+static u32 r2d_cull_cmds(const draw_cmd_t *cmds, u32 count);
+static const u64* r2d_sort_draw_list();
 
 // Internal texture handle
 struct r2d_texture_t
@@ -154,12 +154,35 @@ struct r2d_texture_t
 	// Texture data
 	u32 w, h;
 	u8 *pixels;
-	// OpenGL texture handle
+	// Frees the pixels, NULL to use free
+	r2d_free_pixels_t free_pixels;
+	void *free_user;
+	// Backend texture handle, shared by every texture in an atlas page
+	// NOTE: Zero until the texture is fully uploaded, so it isn't drawn before then
 	u32 handle;
+	// Backend texture being uploaded a strip at a time, and the rows uploaded so far
+	u32 upload_handle;
+	u32 upload_rows;
+	// Atlas page holding the texture, NULL for a standalone backend texture
+	r2d_atlas_page_t *page;
+	// Texture this one replaces the contents of once uploaded (see r2d_replace_texture), NULL for normal textures
+	r2d_texture_t *replaces;
+	// Texel to UV transform, uv = (texel + offset)*scale
+	v2 uv_offset;
+	v2 uv_scale;
 	// Free list pointer
 	r2d_texture_t *next_free;
 };
 
+// Helper, get the normalized texture rectangle of a sprite
+static inline aabb_t r2d_sprite_uv(const r2d_texture_t *texture, aabb_t sprite)
+{
+	aabb_t uv;
+	uv.min = v2_mul(v2_add(sprite.min, texture->uv_offset), texture->uv_scale);
+	uv.max = v2_mul(v2_add(sprite.max, texture->uv_offset), texture->uv_scale);
+	return uv;
+};
+
 static struct
 {
 	// Texture list write mutex
@@ -171,6 +194,9 @@ static struct
 	r2d_texture_t textures[MAX_TEXTURES];
 	r2d_texture_t *free_texture; // Texture free list
 
+	// Pixels held by textures, in bytes
+	u64 pixel_bytes;
+
 	// Creation list
 	u32 create_count;
 	r2d_texture_t *create[MAX_TEXTURES];
@@ -186,15 +212,99 @@ static void r2d_free_all_textures();
 
 static void r2d_create_queued_textures();
 static void r2d_destroy_queued_textures();
+static void r2d_apply_replacement(r2d_texture_t *replacement);
+static void r2d_cancel_replacements(r2d_texture_t *texture);
 
-bool r2d_init()
+// Textures waiting for upload, in creation order
+// NOTE: Only touched by the thread calling r2d_flush, so uploads run without holding the texture list mutex
+static struct
 {
-	if (r2d_load_draw_shader())
-	{	
+	u32 count;
+	r2d_texture_t *textures[MAX_TEXTURES];
+} g_upload;
+
+// Atlas pages, filled as textures are created
+static struct
+{
+	u32 page_count;
+	r2d_atlas_page_t *pages[R2D_ATLAS_MAX_PAGES];
+} g_atlas;
+
+// Bumped whenever textures get a new backend texture or move within one
+// NOTE: Static layers rewrite their elements when it changes, their UVs may be stale
+static u32 g_texture_generation;
+
+// Retained sprites, the elements live in a backend buffer between frames
+struct r2d_static_layer_t
+{
+	// Sprites, one past the highest index set
+	u32 capacity;
+	u32 count;
+	draw_cmd_t *cmds;
+	// Sprites [dirty_begin, dirty_end) changed since the buffer was written
+	u32 dirty_begin, dirty_end;
+	// Texture generation the buffer was written with
+	u32 generation;
+	// Backend buffer, and the host elements it is uploaded from
+	u32 buffer;
+	void *elements;
+	// Texture ranges of the buffer, and the sprites they draw
+	u32 range_count;
+	r2d_batch_range_t *ranges;
+	u32 sprite_count;
+};
+// Static layers drawn this frame, their offsets and the sprites [first, end) drawn from them
+static struct
+{
+	u32 count;
+	r2d_static_layer_t *layers[R2D_MAX_STATIC_LAYERS];
+	v2 offsets[R2D_MAX_STATIC_LAYERS];
+	u32 firsts[R2D_MAX_STATIC_LAYERS];
+	u32 ends[R2D_MAX_STATIC_LAYERS];
+} g_static_draws;
+
+static void r2d_draw_static_layers();
+
+static bool r2d_atlas_accepts(const r2d_texture_t *texture);
+static bool r2d_atlas_add_texture(r2d_texture_t *texture);
+static void r2d_atlas_remove_texture(r2d_texture_t *texture);
+static void r2d_free_atlas();
+
+bool r2d_init(const r2d_config_t *config)
+{
+	const r2d_config_t default_config = {0};
+	if (!config)
+		config = &default_config;
+	g_config = *config;
+	// Select the backend
+	switch (config->backend)
+	{
+		case R2D_BACKEND_GL:       g_backend = &g_r2d_gl_backend; break;
+		case R2D_BACKEND_SOFTWARE: g_backend = &g_r2d_soft_backend; break;
+		case R2D_BACKEND_NULL:     g_backend = &g_r2d_null_backend; break;
+		default: return false;
+	}
+	if (g_backend->init(config))
+	{
+		if (!jobs_init(config->worker_threads))
+		{
+			g_backend->free();
+			return false;
+		}
+		g_corner_kernel = r2d_get_corner_kernel(config->simd, NULL);
 		r2d_init_textures();
 
 		r2d_alloc_batch();
-		r2d_alloc_draw_list();
+		// Start out with a draw list, sprites may be drawn before the first clear
+		if (!arena_init(&g_frame_arenas[0], FRAME_ARENA_SIZE) || !arena_init(&g_frame_arenas[1], FRAME_ARENA_SIZE))
+		{
+			arena_free(&g_frame_arenas[0]);
+			jobs_free();
+			g_backend->free();
+			return false;
+		}
+		g_frame_arena = &g_frame_arenas[0];
+		r2d_reset_draw_list();
 		return true;
 	}
 	return false;
@@ -202,9 +312,12 @@ bool r2d_init()
 void r2d_free()
 {
 	r2d_free_all_textures();
-	r2d_free_draw_shader();
-	r2d_free_draw_list();
-	r2d_free_batch();
+	arena_free(&g_frame_arenas[0]);
+	arena_free(&g_frame_arenas[1]);
+	g_frame_arena = NULL;
+	memset(&g_sort, 0, sizeof(g_sort));
+	jobs_free();
+	g_backend->free();
 };
 
 v2 r2d_screen_to_viewport(v2 screen)
@@ -217,118 +330,168 @@ v2 r2d_screen_to_viewport(v2 screen)
 
 void r2d_clear(u32 width, u32 height)
 {
+	// Switch frame arenas, the one being reset was last used two frames ago
+	g_frame_arena = (g_frame_arena == &g_frame_arenas[0]) ? &g_frame_arenas[1] : &g_frame_arenas[0];
+	arena_reset(g_frame_arena);
 	// Clear the draw list
-	g_draw_list.cmd_count = 0;
+	r2d_reset_draw_list();
+	g_static_draws.count = 0;
 	// Calculate the viewport for the frame
 	r2d_calculate_viewport(width, height);
 };
+void r2d_set_layer(u8 layer)
+{
+	g_draw_list.layer = layer;
+};
 void r2d_draw_sprite(r2d_texture_t *texture, aabb_t sprite, xform2d_t xform)
 {
-	assert((g_draw_list.cmd_count+1) < MAX_DRAW_CMDS);
+	draw_chunk_t *chunk = g_draw_list.current;
+	// Current chunk is full, start the next one
+	if (chunk->cmd_count == DRAW_CHUNK_CMDS)
+	{
+		chunk->next = r2d_alloc_draw_chunk();
+		chunk = chunk->next;
+		g_draw_list.current = chunk;
+	}
+	g_draw_list.cmd_count ++;
 
-	const u32 index = g_draw_list.cmd_count ++;
-	draw_cmd_t *cmd = g_draw_list.cmds + index;
+	draw_cmd_t *cmd = chunk->cmds + chunk->cmd_count++;
 	cmd->xform = xform;
 	cmd->sprite = sprite;
 	cmd->texture = texture;
+	cmd->layer = g_draw_list.layer;
+	cmd->tint = R2D_WHITE;
+};
+void r2d_draw_sprite_tint(r2d_texture_t *texture, aabb_t sprite, xform2d_t xform, u32 tint)
+{
+	r2d_draw_sprite(texture, sprite, xform);
+	// Patch the tint of the command just written
+	draw_chunk_t *chunk = g_draw_list.current;
+	chunk->cmds[chunk->cmd_count - 1].tint = tint;
 };
 void r2d_flush()
 {
-	// Create/upload any waiting textures
+	// Reset the frame statistics
+	memset(&g_stats, 0, sizeof(g_stats));
+
+	// Create/upload any waiting textures, within the upload budget
 	// NOTE: Done at start of frame to make sure textures are ready for use
 	r2d_create_queued_textures();
 
-	// Clear the whole screen for the "black bars" effect
-	glDisable(GL_SCISSOR_TEST);
-	glClearColor(0.0f, 0.0f, 0.0f, 1.f);
-	glClear(GL_COLOR_BUFFER_BIT);
-
-	// Set the viewport/scissor region
-	glEnable(GL_SCISSOR_TEST);
-	glScissor(
-		g_viewport.x, g_viewport.y, 
-		g_viewport.w, g_viewport.h);
-	glViewport(
-		g_viewport.x, g_viewport.y, 
-		g_viewport.w, g_viewport.h);
-	// Clear the render area
-	glClearColor(0.2f, 0.2f, 0.2f, 1.f);
-	glClear(GL_COLOR_BUFFER_BIT);
-	{
-		// Set the drawing settings
-		glDisable(GL_DEPTH_TEST);
-		
-		glEnable(GL_BLEND);
-		glBlendEquation(GL_FUNC_ADD);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-		// Build the vertex batch
-		for (u32 i = 0; i < g_draw_list.cmd_count; i++)
+	// Clear the screen and set the viewport
+	g_backend->begin_frame(g_frame_w, g_frame_h, &g_viewport);
+	{
+		// Static layers go beneath everything else
+		r2d_draw_static_layers();
+		// Collect the draw commands, sorted by layer and texture unless preserving call order
+		const u64 *keys = r2d_sort_draw_list();
+		// One range per sprite worst case
+		const u32 max_ranges = min(g_sort.count, MAX_BATCH_RANGES);
+		g_batch.ranges = arena_push_array(g_frame_arena, r2d_batch_range_t, max_ranges);
+		g_batch.job_ranges = arena_push_array(g_frame_arena, r2d_batch_range_t, max_ranges);
+		assert((g_batch.ranges != NULL) && (g_batch.job_ranges != NULL));
+		// Build and draw the batches, a full batch at a time
+		for (u32 first = 0; first < g_sort.count; first += R2D_MAX_BATCH_SPRITES)
 		{
-			const draw_cmd_t *cmd = g_draw_list.cmds + i;
-			const r2d_texture_t *texture = cmd->texture;
-			if (texture->handle)
-			{
-				r2d_push_sprite(texture, cmd->sprite, cmd->xform);
-			}
-		};
-		// Render the vertex batch
-		r2d_flush_batch();
+			r2d_build_batch(keys + first, min(g_sort.count - first, R2D_MAX_BATCH_SPRITES));
+			r2d_flush_batch();
+		}
 	}
+	g_backend->end_frame();
+
+	// Frame memory, for sizing FRAME_ARENA_SIZE
+	g_stats.frame_bytes = arena_used(g_frame_arena);
+	g_stats.frame_bytes_peak = max(g_frame_arenas[0].high_water, g_frame_arenas[1].high_water);
+	g_stats.pixel_bytes = g_texture_list.pixel_bytes;
 	// Destroy any waiting textures
 	// NOTE: Done at end of frame in case any textures are still in use
 	r2d_destroy_queued_textures();
 };
-
-static bool r2d_load_draw_shader()
+r2d_static_layer_t* r2d_alloc_static_layer(u32 capacity)
 {
-	bool result = false;
-
-	char *vert_code = (char*) r2d_load_entire_file("data/shader.vert", NULL);
-	char *frag_code = (char*) r2d_load_entire_file("data/shader.frag", NULL);
-	if (vert_code && frag_code)
+	r2d_static_layer_t *layer = calloc(1, sizeof(r2d_static_layer_t));
+	if (!layer)
+		return NULL;
+	const size_t sprite_size = g_batch.sprite_elements*g_batch.element_size;
+	layer->capacity = capacity;
+	layer->cmds = calloc(capacity, sizeof(draw_cmd_t));
+	layer->elements = malloc(capacity*sprite_size);
+	// A range has at least one sprite
+	layer->ranges = malloc(capacity*sizeof(r2d_batch_range_t));
+	layer->buffer = g_backend->create_buffer(capacity*sprite_size);
+	if (!layer->cmds || !layer->elements || !layer->ranges || !layer->buffer)
 	{
-		const u32 shader_vert = glCreateShader(GL_VERTEX_SHADER);
-		const u32 shader_frag = glCreateShader(GL_FRAGMENT_SHADER);
-
-		glShaderSource(shader_vert, 1, (const char**) &vert_code, NULL);
-		glShaderSource(shader_frag, 1, (const char**) &frag_code, NULL);
-
-		glCompileShader(shader_vert);
-		glCompileShader(shader_frag);
-
-		g_draw_shader.program = glCreateProgram();
-		glAttachShader(g_draw_shader.program, shader_vert);
-		glAttachShader(g_draw_shader.program, shader_frag);
-		glLinkProgram(g_draw_shader.program);
-
-		glDeleteShader(shader_vert);
-		glDeleteShader(shader_frag);
-
-		int len;
-		char buf[1024];
-		glGetProgramInfoLog(g_draw_shader.program, static_len(buf), &len, buf);
-		if (!len)
-		{
-			g_draw_shader.u_projection = glGetUniformLocation(g_draw_shader.program, "u_projection");
-			g_draw_shader.u_sampler = glGetUniformLocation(g_draw_shader.program, "u_sampler");
-			result = true;
-		} else {
-			fprintf(stderr, buf);
-		}
-
-		free(vert_code);
-		free(frag_code);
+		r2d_free_static_layer(layer);
+		return NULL;
 	}
-	return result;
-}
-static void r2d_free_draw_shader()
+	layer->generation = g_texture_generation;
+	return layer;
+};
+void r2d_free_static_layer(r2d_static_layer_t *layer)
+{
+	if (!layer)
+		return;
+	if (layer->buffer)
+		g_backend->destroy_buffer(layer->buffer);
+	free(layer->cmds);
+	free(layer->elements);
+	free(layer->ranges);
+	free(layer);
+};
+void r2d_set_static_sprite(r2d_static_layer_t *layer, u32 index, r2d_texture_t *texture, aabb_t sprite, xform2d_t xform)
 {
-	glDeleteProgram(g_draw_shader.program);
+	assert(index < layer->capacity);
+	draw_cmd_t *cmd = layer->cmds + index;
+	cmd->xform = xform;
+	cmd->sprite = sprite;
+	cmd->texture = texture;
+	cmd->layer = 0;
+	cmd->tint = R2D_WHITE;
+	layer->count = max(layer->count, index + 1);
+	// Grow the dirty range to include the sprite
+	if (layer->dirty_begin < layer->dirty_end)
+	{
+		layer->dirty_begin = min(layer->dirty_begin, index);
+		layer->dirty_end = max(layer->dirty_end, index + 1);
+	} else {
+		layer->dirty_begin = index;
+		layer->dirty_end = index + 1;
+	}
+};
+void r2d_draw_static_layer(r2d_static_layer_t *layer, v2 offset)
+{
+	r2d_draw_static_layer_range(layer, 0, layer->capacity, offset);
+};
+void r2d_draw_static_layer_range(r2d_static_layer_t *layer, u32 first, u32 count, v2 offset)
+{
+	assert(g_static_draws.count < R2D_MAX_STATIC_LAYERS);
+	assert(first <= layer->capacity);
+	g_static_draws.layers[g_static_draws.count] = layer;
+	g_static_draws.offsets[g_static_draws.count] = offset;
+	g_static_draws.firsts[g_static_draws.count] = first;
+	g_static_draws.ends[g_static_draws.count] = first + min(count, layer->capacity - first);
+	g_static_draws.count ++;
+};
+r2d_stats_t r2d_get_stats()
+{
+	return g_stats;
+};
+arena_t* r2d_get_frame_arena()
+{
+	return g_frame_arena;
+};
+const u8* r2d_get_framebuffer(u32 *width, u32 *height)
+{
+	if (g_backend && g_backend->get_framebuffer)
+		return g_backend->get_framebuffer(width, height);
+	return NULL;
 };
 
 static void r2d_calculate_viewport(u32 width, u32 height)
 {
+	g_frame_w = width;
+	g_frame_h = height;
+
 	const f32 aspect_ratio = ((f32) R2D_SCREEN_W / (f32) R2D_SCREEN_H);
 
 	g_viewport.w = width;
@@ -347,151 +510,345 @@ static void r2d_calculate_viewport(u32 width, u32 height)
 	const m44 ortho = m44_orthoOffCenter(0.f, (f32) width, (f32) height, 0.f, -1.f, 1.f);
 	const m44 scale = m44_scale(g_viewport.scale.x, g_viewport.scale.y, 1.f);
 	g_viewport.projection = m44_mul(ortho, scale);
+
+	// The projection maps the whole virtual screen onto the viewport, whatever its letterboxing
+	// NOTE: Grown by a unit so rounding never culls a sprite that touches the edge
+	g_cull_rect.min.x = -1.f;
+	g_cull_rect.min.y = -1.f;
+	g_cull_rect.max.x = (f32) R2D_SCREEN_W + 1.f;
+	g_cull_rect.max.y = (f32) R2D_SCREEN_H + 1.f;
 };
 
 static void r2d_alloc_batch()
 {
-	// Set the current buffer
-	g_batch.current = 0;
 	g_batch.range_count = 0;
-	g_batch.vertex_count = 0;
-	// Allocate memory
-	g_batch.vertices = malloc(MAX_BATCH_VERTS*sizeof(r2d_vertex_t));
-	assert(g_batch.vertices != NULL);
-	g_batch.ranges = malloc(MAX_BATCH_RANGES*sizeof(r2d_batch_range_t));
-	assert(g_batch.ranges != NULL);
-	// Generate some arrays/buffers
-	glGenVertexArrays(2, g_batch.vao);
-	glGenBuffers(2, g_batch.buf);
-	// Make sure the buffers are big enough
-	for (u32 i = 0; i < 2; i++)
-	{
-		glBindVertexArray(g_batch.vao[i]);
-		{
-			glBindBuffer(GL_ARRAY_BUFFER, g_batch.buf[i]);
-			glBufferData(GL_ARRAY_BUFFER, (MAX_BATCH_VERTS*sizeof(r2d_vertex_t)), NULL, GL_STREAM_DRAW);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-		}
-		glBindVertexArray(0);
-	}
+	g_batch.count = 0;
+	// Element layout for the batch mode
+	g_batch.sprite_elements = r2d_batch_sprite_elements(g_config.batch_mode);
+	g_batch.element_size = r2d_batch_element_size(&g_config);
+	g_batch.capacity = R2D_MAX_BATCH_SPRITES*g_batch.sprite_elements;
+	// Element memory comes from the backend, range memory from the frame arena
+	g_batch.data = NULL;
+	g_batch.ranges = NULL;
+	g_batch.job_ranges = NULL;
 };
-static void r2d_free_batch()
-{
-	glDeleteVertexArrays(2, g_batch.vao);
-	glDeleteBuffers(2, g_batch.buf);
-	free(g_batch.vertices);
-	free(g_batch.ranges);
-}
-static void r2d_push_sprite(const r2d_texture_t *texture, aabb_t sprite, xform2d_t xform)
+// Helper, write the 4 corners of a sprite as a quad or a triangle list
+// NOTE: size is a constant once inlined, so the copies become plain moves
+static inline void r2d_emit_corners(u8 *vertices, const u8 *corners, size_t size)
 {
-	// Get the range
-	r2d_batch_range_t *range = NULL;
-	if (g_batch.range_count == 0)
+	if (g_config.batch_mode == R2D_BATCH_INDEXED)
 	{
-		// No current range, initialze one
-		range = g_batch.ranges + g_batch.range_count++;
-		range->texture_handle = texture->handle;
-		range->offset = 0;
-		range->count = 0;
+		// Push the unique corners, the backend supplies the indices
+		memcpy(vertices, corners, 4*size);
 	} else {
-		// Get the current range
-		range = g_batch.ranges + (g_batch.range_count-1);
-	}
-	// There's a new texture!
-	if (range->texture_handle != texture->handle)
-	{
-		// Create a new range
-		range = g_batch.ranges + g_batch.range_count ++;
-		range->texture_handle = texture->handle;
-		range->offset = g_batch.vertex_count;
-		range->count = 0;
+		// Push a vertex per sprite index
+		const u16 indices[] = R2D_QUAD_INDICES;
+		for (u32 i = 0; i < static_len(indices); i++)
+			memcpy(vertices + i*size, corners + indices[i]*size, size);
 	};
-	// Inverse texture size for UV calculation
-	const v2 i_size = V2(1.f / (f32) texture->w, 1.f / (f32) texture->h);
-	// Get the size of the sprite
-	const v2 sprite_scale = v2_sub(sprite.max, sprite.min);
-	// Calculate the transformed sprite vertices
+};
+// Write the 4 or 6 vertices of sprite i of a transformed corner block, in the configured vertex format
+static void r2d_write_sprite_vertices(void *vertices, const r2d_texture_t *texture, aabb_t sprite, u32 tint, const r2d_corner_block_t *block, u32 i)
+{
+	// Get the texture rectangle of the sprite
+	const aabb_t uv = r2d_sprite_uv(texture, sprite);
+	// Get the transformed sprite vertices
 	const v2 sprite_verts[] = 
 	{
-		xform2d_apply(xform, v2_mul(sprite_scale, V2(-0.5f, -0.5f))),
-		xform2d_apply(xform, v2_mul(sprite_scale, V2( 0.5f, -0.5f))),
-		xform2d_apply(xform, v2_mul(sprite_scale, V2( 0.5f,  0.5f))),
-		xform2d_apply(xform, v2_mul(sprite_scale, V2(-0.5f,  0.5f))),
+		V2(block->corner_x[0][i], block->corner_y[0][i]),
+		V2(block->corner_x[1][i], block->corner_y[1][i]),
+		V2(block->corner_x[2][i], block->corner_y[2][i]),
+		V2(block->corner_x[3][i], block->corner_y[3][i]),
 	};
 	// Calculate the sprite texture coordinates
 	const v2 sprite_uvs[] = 
 	{
-		v2_mul(i_size, V2(sprite.min.x, sprite.min.y)),
-		v2_mul(i_size, V2(sprite.max.x, sprite.min.y)),
-		v2_mul(i_size, V2(sprite.max.x, sprite.max.y)),
-		v2_mul(i_size, V2(sprite.min.x, sprite.max.y)),
+		V2(uv.min.x, uv.min.y),
+		V2(uv.max.x, uv.min.y),
+		V2(uv.max.x, uv.max.y),
+		V2(uv.min.x, uv.max.y),
 	};
 
-	// Sprite indices
-	const u16 indices[] = { 0, 1, 2, 0, 2, 3 };
-	// For each index
-	for (u32 i = 0; i < static_len(indices); i++)
+	switch (g_config.vertex_format)
 	{
-		// Get the index
-		const u16 index = indices[i];
-		// Push the vertex data
-		g_batch.vertices[g_batch.vertex_count++] = r2d_vertex(sprite_verts[index], sprite_uvs[index]);
-		// Increment the range index count
-		range->count ++;
+		case R2D_VERTEX_PACKED:
+		{
+			r2d_packed_vertex_t corners[4];
+			for (u32 k = 0; k < 4; k++)
+			{
+				corners[k].pos[0] = r2d_packed_pos(sprite_verts[k].x);
+				corners[k].pos[1] = r2d_packed_pos(sprite_verts[k].y);
+				corners[k].uv[0] = r2d_unorm16(sprite_uvs[k].x);
+				corners[k].uv[1] = r2d_unorm16(sprite_uvs[k].y);
+			}
+			r2d_emit_corners(vertices, (const u8*) corners, sizeof(r2d_packed_vertex_t));
+		} break;
+		case R2D_VERTEX_PACKED_TINT:
+		{
+			r2d_tinted_vertex_t corners[4];
+			for (u32 k = 0; k < 4; k++)
+			{
+				corners[k].pos[0] = r2d_packed_pos(sprite_verts[k].x);
+				corners[k].pos[1] = r2d_packed_pos(sprite_verts[k].y);
+				corners[k].uv[0] = r2d_unorm16(sprite_uvs[k].x);
+				corners[k].uv[1] = r2d_unorm16(sprite_uvs[k].y);
+				corners[k].tint = tint;
+			}
+			r2d_emit_corners(vertices, (const u8*) corners, sizeof(r2d_tinted_vertex_t));
+		} break;
+		default:
+		{
+			r2d_vertex_t corners[4];
+			for (u32 k = 0; k < 4; k++)
+				corners[k] = r2d_vertex(sprite_verts[k], sprite_uvs[k]);
+			r2d_emit_corners(vertices, (const u8*) corners, sizeof(r2d_vertex_t));
+		} break;
 	}
 };
-static void r2d_flush_batch()
+// Write the instance record of a sprite, the corners are expanded by the vertex shader
+static void r2d_write_sprite_instance(r2d_instance_t *instance, const r2d_texture_t *texture, aabb_t sprite, xform2d_t xform)
 {
-	// If any ranges were recorded
-	if (g_batch.range_count)
+	// Get the texture rectangle of the sprite
+	const aabb_t uv = r2d_sprite_uv(texture, sprite);
+	// Get the size of the sprite
+	const v2 sprite_scale = v2_sub(sprite.max, sprite.min);
+
+	instance->pos = xform.pos;
+	instance->axis_x = m22_transform(xform.rot, V2(sprite_scale.x, 0.f));
+	instance->axis_y = m22_transform(xform.rot, V2(0.f, sprite_scale.y));
+	instance->uv[0] = r2d_unorm16(uv.min.x);
+	instance->uv[1] = r2d_unorm16(uv.min.y);
+	instance->uv[2] = r2d_unorm16(uv.max.x);
+	instance->uv[3] = r2d_unorm16(uv.max.y);
+};
+// Write up to R2D_CORNER_BLOCK sprites as consecutive batch elements
+// NOTE: Sprites without a backend texture get zeroed (degenerate) elements
+static void r2d_write_sprites(void *elements, const draw_cmd_t *const *cmds, u32 count)
+{
+	const size_t sprite_size = g_batch.sprite_elements*g_batch.element_size;
+	const bool instanced = (g_config.batch_mode == R2D_BATCH_INSTANCED);
+	assert(count <= R2D_CORNER_BLOCK);
+
+	// Gather the transforms, the corners are transformed a block at a time by the corner kernel
+	r2d_corner_block_t block;
+	if (!instanced)
+	{
+		for (u32 i = 0; i < count; i++)
+		{
+			const draw_cmd_t *cmd = cmds[i];
+			block.pos_x[i] = cmd->xform.pos.x;
+			block.pos_y[i] = cmd->xform.pos.y;
+			block.rot_x0[i] = cmd->xform.rot.x0;
+			block.rot_y0[i] = cmd->xform.rot.y0;
+			block.rot_x1[i] = cmd->xform.rot.x1;
+			block.rot_y1[i] = cmd->xform.rot.y1;
+			block.half_w[i] = (cmd->sprite.max.x - cmd->sprite.min.x)*0.5f;
+			block.half_h[i] = (cmd->sprite.max.y - cmd->sprite.min.y)*0.5f;
+		}
+		g_corner_kernel(&block, count);
+	}
+	// Write the sprite data
+	for (u32 i = 0; i < count; i++)
+	{
+		const draw_cmd_t *cmd = cmds[i];
+		const r2d_texture_t *texture = cmd->texture;
+		void *element = (u8*) elements + i*sprite_size;
+		if (!texture || !texture->handle)
+			memset(element, 0, sprite_size);
+		else if (instanced)
+			r2d_write_sprite_instance((r2d_instance_t*) element, texture, cmd->sprite, cmd->xform);
+		else
+			r2d_write_sprite_vertices(element, texture, cmd->sprite, cmd->tint, &block, i);
+	}
+};
+// Job, write sprites [begin, end) of the batch and record their texture ranges
+// NOTE: Every job writes its own slice of the batch and range lists
+static void r2d_build_batch_job(void *data, u32 begin, u32 end)
+{
+	const u32 sprite_elements = g_batch.sprite_elements;
+	const size_t element_size = g_batch.element_size;
+
+	r2d_batch_range_t *ranges = g_batch.job_ranges + begin;
+	u32 range_count = 0;
+	const draw_cmd_t *cmds[R2D_CORNER_BLOCK];
+	for (u32 first = begin; first < end; first += R2D_CORNER_BLOCK)
 	{
-		// Bind the shader
-		glUseProgram(g_draw_shader.program);
+		const u32 count = min(end - first, R2D_CORNER_BLOCK);
+		// Find the commands
+		for (u32 i = 0; i < count; i++)
+		{
+			const u32 sequence = (u32) (g_batch.keys[first + i] & SORT_SEQUENCE_MASK);
+			const draw_chunk_t *chunk = g_sort.chunks[sequence / DRAW_CHUNK_CMDS];
+			cmds[i] = chunk->cmds + (sequence % DRAW_CHUNK_CMDS);
+		}
+		r2d_write_sprites((u8*) g_batch.data + first*sprite_elements*element_size, cmds, count);
+		// Record the texture ranges
+		for (u32 i = 0; i < count; i++)
 		{
-			// Set the projection uniform
-			glProgramUniformMatrix4fv(g_draw_shader.program, g_draw_shader.u_projection,
-				1, false, (const f32*) g_viewport.projection.m);
-			// Bind the vertex array
-			glBindVertexArray(g_batch.vao[g_batch.current]);
+			const r2d_texture_t *texture = cmds[i]->texture;
+			const u32 offset = (first + i)*sprite_elements;
+			// There's a new texture, start a range
+			if ((range_count == 0) || (ranges[range_count - 1].texture_handle != texture->handle))
 			{
-				// Bind the buffer
-				glBindBuffer(GL_ARRAY_BUFFER, g_batch.buf[g_batch.current]);
-				// Map the buffer for data upload
-				void *data = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-				if (data)
-				{
-					// Copy the data and un-map the buffer
-					memcpy(data, g_batch.vertices, g_batch.vertex_count*sizeof(r2d_vertex_t));
-					glUnmapBuffer(GL_ARRAY_BUFFER);
-					// Bind the vertex layout
-					r2d_bind_vertex_layout(g_vertex_layout, static_len(g_vertex_layout));
-					// For each range
-					for (u32 i = 0; i < g_batch.range_count; i++)
-					{
-						// Get the range
-						const r2d_batch_range_t *range = g_batch.ranges + i;
-						// Bind the range texture
-						glActiveTexture(GL_TEXTURE0); 
-						glBindTexture(GL_TEXTURE_2D, range->texture_handle);
-						// Issue the range draw call
-						glDrawArrays(GL_TRIANGLES, range->offset, range->count);
-					};
-				}
+				r2d_batch_range_t *range = ranges + range_count++;
+				range->texture_handle = texture->handle;
+				range->offset = offset;
+				range->count = 0;
 			}
-			glBindVertexArray(0);
+			ranges[range_count - 1].count += sprite_elements;
 		}
-		glUseProgram(0);
+	}
+	g_batch.job_range_counts[begin / BATCH_JOB_SPRITES] = range_count;
+};
+static void r2d_build_batch(const u64 *keys, u32 count)
+{
+	assert(count <= R2D_MAX_BATCH_SPRITES);
+	// Map the memory for the batch
+	// NOTE: Sprites are written straight into backend (GPU visible) memory, there is no staging copy
+	g_batch.data = g_backend->map_batch();
+	assert(g_batch.data != NULL);
+	// Write the sprites across the job system
+	g_batch.keys = keys;
+	jobs_parallel_for(count, BATCH_JOB_SPRITES, r2d_build_batch_job, NULL);
+	// Merge the ranges of every job, joining ranges that continue across jobs
+	g_batch.range_count = 0;
+	const u32 job_count = (count + BATCH_JOB_SPRITES - 1) / BATCH_JOB_SPRITES;
+	for (u32 i = 0; i < job_count; i++)
+	{
+		const r2d_batch_range_t *ranges = g_batch.job_ranges + i*BATCH_JOB_SPRITES;
+		for (u32 j = 0; j < g_batch.job_range_counts[i]; j++)
+		{
+			const u32 last = g_batch.range_count - 1;
+			if (g_batch.range_count && (g_batch.ranges[last].texture_handle == ranges[j].texture_handle))
+				g_batch.ranges[last].count += ranges[j].count;
+			else
+				g_batch.ranges[g_batch.range_count++] = ranges[j];
+		}
+	}
+	g_batch.count = count*g_batch.sprite_elements;
+	g_stats.sprites += count;
+};
+static void r2d_flush_batch()
+{
+	// If any ranges were recorded
+	if (g_batch.range_count)
+	{
+		// Hand the batch to the backend
+		g_backend->draw_batch(g_batch.count, g_batch.ranges, g_batch.range_count);
+
+		g_stats.batches ++;
+		g_stats.draw_calls += g_batch.range_count;
+		g_stats.vertices += (g_batch.count / g_batch.sprite_elements)*r2d_batch_sprite_vertices(g_config.batch_mode);
+		g_stats.upload_bytes += g_batch.count*g_batch.element_size;
 	}
 	// Clear the batch
-	g_batch.vertex_count = 0;
+	g_batch.data = NULL;
+	g_batch.count = 0;
 	g_batch.range_count = 0;
-	// Go to the next buffer
-	g_batch.current = 1 - g_batch.current;
+};
+
+// Rewrite and upload the changed sprites of a static layer, and rebuild its ranges
+static void r2d_update_static_layer(r2d_static_layer_t *layer)
+{
+	// Textures were created or moved, every sprite may be affected
+	if (layer->generation != g_texture_generation)
+	{
+		layer->dirty_begin = 0;
+		layer->dirty_end = layer->count;
+		layer->generation = g_texture_generation;
+	}
+	if (layer->dirty_begin >= layer->dirty_end)
+		return;
+
+	const u32 sprite_elements = g_batch.sprite_elements;
+	const size_t sprite_size = sprite_elements*g_batch.element_size;
+	const draw_cmd_t *cmds[R2D_CORNER_BLOCK];
+	for (u32 first = layer->dirty_begin; first < layer->dirty_end; first += R2D_CORNER_BLOCK)
+	{
+		const u32 count = min(layer->dirty_end - first, R2D_CORNER_BLOCK);
+		for (u32 i = 0; i < count; i++)
+			cmds[i] = layer->cmds + first + i;
+		r2d_write_sprites((u8*) layer->elements + first*sprite_size, cmds, count);
+	}
+	const size_t offset = layer->dirty_begin*sprite_size;
+	const size_t size = (layer->dirty_end - layer->dirty_begin)*sprite_size;
+	g_backend->update_buffer(layer->buffer, offset, size, (const u8*) layer->elements + offset);
+	g_stats.upload_bytes += size;
+	layer->dirty_begin = layer->dirty_end = 0;
+
+	// Join sprites sharing a texture into ranges
+	// NOTE: Sprites without a texture are degenerate, so ranges run across them instead of splitting
+	layer->range_count = 0;
+	layer->sprite_count = 0;
+	r2d_batch_range_t *range = NULL;
+	for (u32 i = 0; i < layer->count; i++)
+	{
+		const r2d_texture_t *texture = layer->cmds[i].texture;
+		const u32 handle = texture ? texture->handle : 0;
+		if (!handle)
+			continue;
+		const u32 offset = i*sprite_elements;
+		// Ranges hold at most a batch of sprites, the index buffer covers that many
+		if (!range || (range->texture_handle != handle) || ((offset - range->offset) >= R2D_MAX_BATCH_SPRITES*sprite_elements))
+		{
+			range = layer->ranges + layer->range_count++;
+			range->texture_handle = handle;
+			range->offset = offset;
+		}
+		range->count = offset + sprite_elements - range->offset;
+		layer->sprite_count ++;
+	}
+};
+static void r2d_draw_static_layers()
+{
+	for (u32 i = 0; i < g_static_draws.count; i++)
+	{
+		r2d_static_layer_t *layer = g_static_draws.layers[i];
+		r2d_update_static_layer(layer);
+		if (!layer->range_count)
+			continue;
+		const u32 first = g_static_draws.firsts[i];
+		const u32 end = min(g_static_draws.ends[i], layer->count);
+		if ((first == 0) && (end == layer->count))
+		{
+			g_backend->draw_buffer(layer->buffer, g_static_draws.offsets[i], layer->ranges, layer->range_count);
+			g_stats.draw_calls += layer->range_count;
+			g_stats.static_sprites += layer->sprite_count;
+			continue;
+		}
+
+		// Clip the ranges to the sprites drawn
+		const u32 sprite_elements = g_batch.sprite_elements;
+		const u32 begin_offset = first*sprite_elements, end_offset = end*sprite_elements;
+		r2d_batch_range_t *ranges = arena_push_array(g_frame_arena, r2d_batch_range_t, layer->range_count);
+		assert(ranges != NULL);
+		u32 range_count = 0;
+		for (u32 r = 0; r < layer->range_count; r++)
+		{
+			const r2d_batch_range_t *range = layer->ranges + r;
+			const u32 offset = max(range->offset, begin_offset);
+			const u32 offset_end = min(range->offset + range->count, end_offset);
+			if (offset >= offset_end)
+				continue;
+			ranges[range_count].texture_handle = range->texture_handle;
+			ranges[range_count].offset = offset;
+			ranges[range_count].count = offset_end - offset;
+			range_count ++;
+		}
+		if (!range_count)
+			continue;
+		g_backend->draw_buffer(layer->buffer, g_static_draws.offsets[i], ranges, range_count);
+		g_stats.draw_calls += range_count;
+		for (u32 s = first; s < end; s++)
+			g_stats.static_sprites += (layer->cmds[s].texture && layer->cmds[s].texture->handle) ? 1 : 0;
+	}
 };
 
 static void r2d_init_textures()
 {
-	g_texture_list.mtx = (ticket_mtx_t){0};
+	// Reset everything, the library may be re-initialized
+	memset(&g_texture_list, 0, sizeof(g_texture_list));
+	g_upload.count = 0;
 };
 static r2d_texture_t* r2d_get_texture_handle()
 {
@@ -519,11 +876,37 @@ static void r2d_free_texture_handle(r2d_texture_t *texture)
 	g_texture_list.free_texture = texture;
 }
 
-r2d_texture_t* r2d_alloc_texture(u32 width, u32 height, u8 *pixels)
+// Free the pixels of a texture, once they are uploaded or the texture is destroyed
+// NOTE: Only call with the texture list mutex held
+static void r2d_release_pixels(r2d_texture_t *texture)
+{
+	if (!texture->pixels)
+		return;
+	if (texture->free_pixels)
+		texture->free_pixels(texture->pixels, texture->free_user);
+	else
+		free(texture->pixels);
+	g_texture_list.pixel_bytes -= (u64) texture->w*texture->h*4;
+	texture->pixels = NULL;
+	texture->free_pixels = NULL;
+	texture->free_user = NULL;
+};
+
+r2d_texture_t* r2d_alloc_texture(u32 width, u32 height, const u8 *pixels)
 {
 	// TODO: Texture formats
-	const size_t size = width*height*4;
-	
+	const size_t size = (size_t) width*height*4;
+
+	// Copy the pixel array, outside the lock
+	u8 *copy = malloc(size);
+	assert(copy != NULL);
+	memcpy(copy, pixels, size);
+	return r2d_adopt_texture(width, height, copy, NULL, NULL);
+};
+// Helper, queue a texture for upload, replacing the contents of another one once uploaded if set
+static r2d_texture_t* r2d_queue_texture(u32 width, u32 height, u8 *pixels, r2d_free_pixels_t free_pixels, void *user, r2d_texture_t *replaces)
+{
+	assert((pixels != NULL) && (width > 0) && (height > 0));
 	r2d_texture_t *texture = NULL;
 	ticket_mtx_lock(&g_texture_list.mtx);
 	{
@@ -532,10 +915,11 @@ r2d_texture_t* r2d_alloc_texture(u32 width, u32 height, u8 *pixels)
 		// Set the data
 		texture->w = width;
 		texture->h = height;
-		// Allocate and copy the pixel array
-		texture->pixels = malloc(size);
-		assert(texture->pixels != NULL);
-		memcpy(texture->pixels, pixels, size);
+		texture->pixels = pixels;
+		texture->free_pixels = free_pixels;
+		texture->free_user = user;
+		texture->replaces = replaces;
+		g_texture_list.pixel_bytes += (u64) width*height*4;
 		// Insert into the creation list
 		assert ((g_texture_list.create_count + 1) < MAX_TEXTURES);
 		g_texture_list.create[g_texture_list.create_count++] = texture;
@@ -543,17 +927,36 @@ r2d_texture_t* r2d_alloc_texture(u32 width, u32 height, u8 *pixels)
 	ticket_mtx_unlock(&g_texture_list.mtx);
 	return texture;
 };
+r2d_texture_t* r2d_adopt_texture(u32 width, u32 height, u8 *pixels, r2d_free_pixels_t free_pixels, void *user)
+{
+	return r2d_queue_texture(width, height, pixels, free_pixels, user, NULL);
+};
 void r2d_free_texture(r2d_texture_t *texture)
 {
 	ticket_mtx_lock(&g_texture_list.mtx);
 	{
 		// Insert into the destroy list
 		assert ((g_texture_list.destroy_count + 1) < MAX_TEXTURES);
-		g_texture_list.create[g_texture_list.destroy_count++] = texture;
+		g_texture_list.destroy[g_texture_list.destroy_count++] = texture;
 	}
 	ticket_mtx_unlock(&g_texture_list.mtx);
 };
 
+void r2d_replace_texture(r2d_texture_t *texture, u32 width, u32 height, u8 *pixels, r2d_free_pixels_t free_pixels, void *user)
+{
+	assert(texture != NULL);
+	// Queue a hidden texture with the new pixels, it takes the place of the old ones when its upload is done
+	// NOTE: Uploads go in creation order, so a texture is always uploaded before its replacements
+	r2d_queue_texture(width, height, pixels, free_pixels, user, texture);
+};
+
+bool r2d_reload_shader(const char *vertex_shader, const char *fragment_shader)
+{
+	if (!g_backend->reload_shader)
+		return true;
+	return g_backend->reload_shader(vertex_shader, fragment_shader);
+};
+
 static void r2d_free_all_textures()
 {
 	ticket_mtx_lock(&g_texture_list.mtx);
@@ -562,50 +965,174 @@ static void r2d_free_all_textures()
 		{
 			// Free texture data
 			r2d_texture_t *texture = g_texture_list.textures + i;
-			if (texture->handle)
-				glDeleteTextures(1, &texture->handle);
-			if (texture->pixels)
-				free(texture->pixels);
+			if (texture->handle && !texture->page)
+				g_backend->destroy_texture(texture->handle);
+			if (texture->upload_handle)
+				g_backend->destroy_texture(texture->upload_handle);
+			r2d_release_pixels(texture);
 		}
+		// Atlas pages own the rest of the backend textures
+		r2d_free_atlas();
 		g_texture_list.texture_count = 0;
+		g_texture_list.free_texture = NULL;
+		g_texture_list.create_count = 0;
+		g_texture_list.destroy_count = 0;
+		g_upload.count = 0;
 	}
 	ticket_mtx_unlock(&g_texture_list.mtx);
 };
 
-static void r2d_create_queued_textures()
+// Helper, monotonic time for the upload budget, in milliseconds
+// NOTE: Not the wall clock, which jumps when the system time is set
+static f64 r2d_time_ms()
 {
-	ticket_mtx_lock(&g_texture_list.mtx);
+#ifdef _WIN32
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (f64) counter.QuadPart*1e3 / (f64) frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+#endif
+};
+// Upload as much of a texture as the budget allows, returns true once it is ready to draw
+// NOTE: Uploads nothing if nothing fits, unless first is set (nothing was uploaded this flush yet)
+static bool r2d_upload_texture(r2d_texture_t *texture, u64 *budget, bool first)
+{
+	const u64 row_bytes = (u64) texture->w*4;
+	const u64 size = row_bytes*texture->h;
+
+	// Pack small textures into the atlas, whole
+	if (!texture->upload_handle && r2d_atlas_accepts(texture))
 	{
-		// Create every texture in the creation list
-		for (u32 i = 0; i < g_texture_list.create_count; i++)
+		if ((size > *budget) && !first)
+			return false;
+		if (r2d_atlas_add_texture(texture))
 		{
-			r2d_texture_t *texture = g_texture_list.create[i];
+			*budget -= min(size, *budget);
+			g_stats.texture_upload_bytes += size;
+			// The page has its own copy now, repacking copies it on the device
+			ticket_mtx_lock(&g_texture_list.mtx);
+			r2d_release_pixels(texture);
+			ticket_mtx_unlock(&g_texture_list.mtx);
+			return true;
+		}
+	}
 
-			glGenTextures(1, &texture->handle);
+	// Anything else gets a texture of its own, uploaded in strips of the rows that fit the budget
+	u64 rows = min(*budget, UPLOAD_STRIP_BYTES) / row_bytes;
+	if (!rows)
+	{
+		if (!first)
+			return false;
+		// A row is past the budget, upload one anyway so the texture makes progress
+		rows = 1;
+	}
+	rows = min(rows, (u64) (texture->h - texture->upload_rows));
+	if (!texture->upload_handle)
+		texture->upload_handle = g_backend->reserve_texture(texture->w, texture->h);
+	g_backend->update_texture(texture->upload_handle, 0, texture->upload_rows, texture->w, (u32) rows,
+		texture->pixels + texture->upload_rows*row_bytes);
+	texture->upload_rows += (u32) rows;
+	*budget -= min(rows*row_bytes, *budget);
+	g_stats.texture_upload_bytes += rows*row_bytes;
+	if (texture->upload_rows < texture->h)
+		return false;
 
-			glBindTexture(GL_TEXTURE_2D, texture->handle);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexImage2D(GL_TEXTURE_2D, 
-				0, GL_RGBA, texture->w, texture->h, 
-				0, GL_RGBA, GL_UNSIGNED_BYTE, texture->pixels);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
+	// Done, the texture can be drawn from now on
+	texture->handle = texture->upload_handle;
+	texture->upload_handle = 0;
+	texture->upload_rows = 0;
+	texture->uv_offset = V2(0.f, 0.f);
+	texture->uv_scale = V2(1.f / (f32) texture->w, 1.f / (f32) texture->h);
+	// The backend has its own copy now
+	ticket_mtx_lock(&g_texture_list.mtx);
+	r2d_release_pixels(texture);
+	ticket_mtx_unlock(&g_texture_list.mtx);
+	return true;
+};
+// Remove a texture from the upload queue, if it is still waiting
+static void r2d_cancel_upload(r2d_texture_t *texture)
+{
+	for (u32 i = 0; i < g_upload.count; i++)
+	{
+		if (g_upload.textures[i] != texture)
+			continue;
+		if (texture->upload_handle)
+			g_backend->destroy_texture(texture->upload_handle);
+		texture->upload_handle = 0;
+		texture->upload_rows = 0;
+		memmove(g_upload.textures + i, g_upload.textures + i + 1, (g_upload.count - i - 1)*sizeof(r2d_texture_t*));
+		g_upload.count --;
+		return;
+	}
+};
+
+static void r2d_create_queued_textures()
+{
+	// Take the new textures, the uploads run without the lock so loading threads aren't held up
+	ticket_mtx_lock(&g_texture_list.mtx);
+	{
+		assert((g_upload.count + g_texture_list.create_count) <= MAX_TEXTURES);
+		memcpy(g_upload.textures + g_upload.count, g_texture_list.create, g_texture_list.create_count*sizeof(r2d_texture_t*));
+		g_upload.count += g_texture_list.create_count;
 		// Reset list
 		g_texture_list.create_count = 0;
 	}
 	ticket_mtx_unlock(&g_texture_list.mtx);
+
+	// Upload in creation order until the budget runs out
+	// NOTE: The time budget is checked between textures and strips, so it can be overrun by one of them
+	u64 budget = g_config.upload_budget_bytes ? g_config.upload_budget_bytes : U64_MAX;
+	const f64 deadline = (g_config.upload_budget_ms > 0.f) ? r2d_time_ms() + g_config.upload_budget_ms : 0.0;
+	u32 uploaded = 0;
+	bool first = true;
+	while (uploaded < g_upload.count)
+	{
+		const u64 before = budget;
+		r2d_texture_t *texture = g_upload.textures[uploaded];
+		if (r2d_upload_texture(texture, &budget, first))
+		{
+			if (texture->replaces)
+				r2d_apply_replacement(texture);
+			uploaded ++;
+		} else if (budget == before)
+			break;
+		first = false;
+		if ((deadline > 0.0) && (r2d_time_ms() >= deadline))
+			break;
+	}
+	if (uploaded)
+	{
+		g_texture_generation ++;
+		memmove(g_upload.textures, g_upload.textures + uploaded, (g_upload.count - uploaded)*sizeof(r2d_texture_t*));
+		g_upload.count -= uploaded;
+	}
+	g_stats.textures_uploaded = uploaded;
+	g_stats.textures_pending = g_upload.count;
 };
 static void r2d_destroy_queued_textures()
 {
 	ticket_mtx_lock(&g_texture_list.mtx);
 	{	
+		if (g_texture_list.destroy_count)
+			g_texture_generation ++;
 		for (u32 i = 0; i < g_texture_list.destroy_count; i++)
 		{
 			// Free texture data
-			r2d_texture_t *texture = g_texture_list.create[i];
-			glDeleteTextures(1, &texture->handle);
-			free(texture->pixels);
+			r2d_texture_t *texture = g_texture_list.destroy[i];
+			// Textures can be freed before they are uploaded, or with replacements on the way
+			if (!texture->handle)
+				r2d_cancel_upload(texture);
+			r2d_cancel_replacements(texture);
+			if (texture->page)
+				r2d_atlas_remove_texture(texture);
+			else if (texture->handle)
+				g_backend->destroy_texture(texture->handle);
+			r2d_release_pixels(texture);
+			texture->handle = 0;
 			// Add to the free list
 			r2d_free_texture_handle(texture);
 		}
@@ -615,14 +1142,366 @@ static void r2d_destroy_queued_textures()
 	ticket_mtx_unlock(&g_texture_list.mtx);
 };
 
-static bool r2d_alloc_draw_list()
+// Swap the uploaded contents of a replacement into the texture it replaces, then free the replacement
+// NOTE: The texture keeps its address, so pointers held by the game stay valid
+static void r2d_apply_replacement(r2d_texture_t *replacement)
+{
+	r2d_texture_t *texture = replacement->replaces;
+	assert(texture->handle != 0);
+	ticket_mtx_lock(&g_texture_list.mtx);
+	{
+		// Drop the old contents
+		if (texture->page)
+			r2d_atlas_remove_texture(texture);
+		else
+			g_backend->destroy_texture(texture->handle);
+		r2d_release_pixels(texture);
+		// Take over the new ones, pixels included (none left once uploaded)
+		texture->w = replacement->w;
+		texture->h = replacement->h;
+		texture->pixels = replacement->pixels;
+		texture->free_pixels = replacement->free_pixels;
+		texture->free_user = replacement->free_user;
+		texture->handle = replacement->handle;
+		texture->page = replacement->page;
+		texture->uv_offset = replacement->uv_offset;
+		texture->uv_scale = replacement->uv_scale;
+		// Free the replacement without touching what it handed over
+		replacement->pixels = NULL;
+		replacement->handle = 0;
+		replacement->page = NULL;
+		replacement->replaces = NULL;
+		r2d_free_texture_handle(replacement);
+	}
+	ticket_mtx_unlock(&g_texture_list.mtx);
+};
+// Drop the replacements waiting for a texture that is being destroyed
+// NOTE: Only call with the texture list mutex held, from the thread calling r2d_flush
+static void r2d_cancel_replacements(r2d_texture_t *texture)
+{
+	for (u32 i = 0; i < g_upload.count;)
+	{
+		r2d_texture_t *replacement = g_upload.textures[i];
+		if (replacement->replaces != texture)
+		{
+			i ++;
+			continue;
+		}
+		r2d_cancel_upload(replacement);
+		r2d_release_pixels(replacement);
+		replacement->replaces = NULL;
+		r2d_free_texture_handle(replacement);
+	}
+	// Replacements queued since the last flush haven't reached the upload queue yet
+	for (u32 i = 0; i < g_texture_list.create_count;)
+	{
+		r2d_texture_t *replacement = g_texture_list.create[i];
+		if (replacement->replaces != texture)
+		{
+			i ++;
+			continue;
+		}
+		memmove(g_texture_list.create + i, g_texture_list.create + i + 1, (g_texture_list.create_count - i - 1)*sizeof(r2d_texture_t*));
+		g_texture_list.create_count --;
+		r2d_release_pixels(replacement);
+		replacement->replaces = NULL;
+		r2d_free_texture_handle(replacement);
+	}
+};
+
+static draw_chunk_t* r2d_alloc_draw_chunk()
+{
+	draw_chunk_t *chunk = arena_push_array(g_frame_arena, draw_chunk_t, 1);
+	assert(chunk != NULL);
+	chunk->cmd_count = 0;
+	chunk->next = NULL;
+	g_draw_list.chunk_count ++;
+	return chunk;
+};
+static void r2d_reset_draw_list()
 {
 	g_draw_list.cmd_count = 0;
-	g_draw_list.cmds = malloc(MAX_DRAW_CMDS*sizeof(draw_cmd_t));
-	assert(g_draw_list.cmds != NULL);
-	return true;
+	g_draw_list.chunk_count = 0;
+	g_draw_list.head = r2d_alloc_draw_chunk();
+	g_draw_list.current = g_draw_list.head;
+	g_draw_list.layer = 0;
 };
-static void r2d_free_draw_list()
+// Stable LSD radix sort on the bytes above the sequence number
+// NOTE: Bytes every key shares are skipped, returns the buffer holding the result
+static u64* r2d_radix_sort(u64 *keys, u64 *temp, u32 count, u64 diff)
 {
-	free(g_draw_list.cmds);
+	for (u32 shift = SORT_TEXTURE_SHIFT; shift < 64; shift += 8)
+	{
+		if (((diff >> shift) & 0xFF) == 0)
+			continue;
+		// Histogram the digits
+		u32 offsets[256] = {0};
+		for (u32 i = 0; i < count; i++)
+		{
+			offsets[(keys[i] >> shift) & 0xFF] ++;
+		}
+		// Convert to starting offsets
+		u32 total = 0;
+		for (u32 i = 0; i < 256; i++)
+		{
+			const u32 digit_count = offsets[i];
+			offsets[i] = total;
+			total += digit_count;
+		}
+		// Scatter
+		for (u32 i = 0; i < count; i++)
+		{
+			const u64 key = keys[i];
+			temp[offsets[(key >> shift) & 0xFF]++] = key;
+		}
+		swap(u64*, keys, temp);
+	}
+	return keys;
+};
+// Test up to 4 draw commands against the cull rectangle, bit i of the result is set if command i is visible
+// NOTE: Tests the bounding box of the rotated sprite, so rotated sprites just off a corner can still pass
+static u32 r2d_cull_cmds(const draw_cmd_t *cmds, u32 count)
+{
+	assert((count > 0) && (count <= 4));
+	// Gather the commands into lanes, repeating the last one past count
+	const draw_cmd_t *c0 = cmds, *c1 = cmds + min(1, count - 1), *c2 = cmds + min(2, count - 1), *c3 = cmds + min(3, count - 1);
+	const __m128 pos_x  = _mm_setr_ps(c0->xform.pos.x, c1->xform.pos.x, c2->xform.pos.x, c3->xform.pos.x);
+	const __m128 pos_y  = _mm_setr_ps(c0->xform.pos.y, c1->xform.pos.y, c2->xform.pos.y, c3->xform.pos.y);
+	const __m128 rot_x0 = _mm_setr_ps(c0->xform.rot.x0, c1->xform.rot.x0, c2->xform.rot.x0, c3->xform.rot.x0);
+	const __m128 rot_y0 = _mm_setr_ps(c0->xform.rot.y0, c1->xform.rot.y0, c2->xform.rot.y0, c3->xform.rot.y0);
+	const __m128 rot_x1 = _mm_setr_ps(c0->xform.rot.x1, c1->xform.rot.x1, c2->xform.rot.x1, c3->xform.rot.x1);
+	const __m128 rot_y1 = _mm_setr_ps(c0->xform.rot.y1, c1->xform.rot.y1, c2->xform.rot.y1, c3->xform.rot.y1);
+	const __m128 width  = _mm_setr_ps(
+		c0->sprite.max.x - c0->sprite.min.x, c1->sprite.max.x - c1->sprite.min.x,
+		c2->sprite.max.x - c2->sprite.min.x, c3->sprite.max.x - c3->sprite.min.x);
+	const __m128 height = _mm_setr_ps(
+		c0->sprite.max.y - c0->sprite.min.y, c1->sprite.max.y - c1->sprite.min.y,
+		c2->sprite.max.y - c2->sprite.min.y, c3->sprite.max.y - c3->sprite.min.y);
+
+	// Half extents of the rotated box, |a| + |b| for the rotated half width/height vectors
+	const __m128 sign = _mm_set1_ps(-0.f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 half_w = _mm_mul_ps(width, half);
+	const __m128 half_h = _mm_mul_ps(height, half);
+	const __m128 ext_x = _mm_add_ps(
+		_mm_andnot_ps(sign, _mm_mul_ps(half_w, rot_x0)),
+		_mm_andnot_ps(sign, _mm_mul_ps(half_h, rot_y0)));
+	const __m128 ext_y = _mm_add_ps(
+		_mm_andnot_ps(sign, _mm_mul_ps(half_w, rot_x1)),
+		_mm_andnot_ps(sign, _mm_mul_ps(half_h, rot_y1)));
+
+	// Overlap test against the cull rectangle
+	__m128 visible = _mm_cmple_ps(_mm_sub_ps(pos_x, ext_x), _mm_set1_ps(g_cull_rect.max.x));
+	visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(pos_x, ext_x), _mm_set1_ps(g_cull_rect.min.x)));
+	visible = _mm_and_ps(visible, _mm_cmple_ps(_mm_sub_ps(pos_y, ext_y), _mm_set1_ps(g_cull_rect.max.y)));
+	visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(pos_y, ext_y), _mm_set1_ps(g_cull_rect.min.y)));
+	return (u32) _mm_movemask_ps(visible) & ((1u << count) - 1);
+};
+// Sort key id of the backend texture a texture is drawn from, the atlas page or the texture's own slot
+// NOTE: Backend handles aren't bounded, truncating them to the key's 16 bits could interleave textures that collide
+static_assert((MAX_TEXTURES + R2D_ATLAS_MAX_PAGES) <= (1 << 16), "Texture sort ids must fit the key");
+static inline u32 r2d_texture_sort_id(const r2d_texture_t *texture)
+{
+	if (texture->page)
+		return MAX_TEXTURES + texture->page->index;
+	return (u32) (texture - g_texture_list.textures);
+};
+static const u64* r2d_sort_draw_list()
+{
+	// Size the buffers for the draw list
+	g_sort.keys = arena_push_array(g_frame_arena, u64, g_draw_list.cmd_count);
+	g_sort.temp = arena_push_array(g_frame_arena, u64, g_draw_list.cmd_count);
+	g_sort.chunks = arena_push_array(g_frame_arena, const draw_chunk_t*, g_draw_list.chunk_count);
+	assert((g_sort.keys != NULL) && (g_sort.temp != NULL) && (g_sort.chunks != NULL));
+	// Build the keys, skipping culled sprites and textures that aren't uploaded yet
+	u32 last_handle = 0;
+	u64 last_key = 0, diff = 0;
+	bool sorted = true;
+	u32 chunk_index = 0;
+	g_sort.count = 0;
+	for (const draw_chunk_t *chunk = g_draw_list.head; chunk; chunk = chunk->next, chunk_index++)
+	{
+		g_sort.chunks[chunk_index] = chunk;
+
+		const u32 sequence = chunk_index*DRAW_CHUNK_CMDS;
+		u32 visible = 0;
+		for (u32 i = 0; i < chunk->cmd_count; i++)
+		{
+			// Cull the commands 4 at a time
+			if ((i & 3) == 0)
+			{
+				const u32 count = min(chunk->cmd_count - i, 4);
+				visible = g_config.disable_culling ? ((1u << count) - 1) : r2d_cull_cmds(chunk->cmds + i, count);
+				g_stats.culled += count - __builtin_popcount(visible);
+			}
+			if (!(visible & (1u << (i & 3))))
+				continue;
+
+			const draw_cmd_t *cmd = chunk->cmds + i;
+			const u32 handle = cmd->texture->handle;
+			if (!handle)
+				continue;
+			if (handle != last_handle)
+				g_stats.unsorted_ranges ++;
+			last_handle = handle;
+			// Key on the backend texture, so textures sharing an atlas page share a range
+			const u64 key =
+				((u64) cmd->layer << SORT_LAYER_SHIFT) |
+				((u64) r2d_texture_sort_id(cmd->texture) << SORT_TEXTURE_SHIFT) |
+				(u64) (sequence + i);
+			// Track the bytes that differ, and whether the list is already in order
+			if (g_sort.count)
+			{
+				diff |= key ^ last_key;
+				sorted &= (key >= last_key);
+			}
+			last_key = key;
+
+			g_sort.keys[g_sort.count++] = key;
+		}
+	}
+	// Keep call order if requested, the keys still locate the commands
+	if (g_config.preserve_order || sorted || (g_sort.count < 2))
+		return g_sort.keys;
+	return r2d_radix_sort(g_sort.keys, g_sort.temp, g_sort.count, diff);
+};
+
+// Place a texture in an atlas page, its pixels are uploaded or copied into place by the caller
+static void r2d_atlas_place_texture(r2d_texture_t *texture, r2d_atlas_page_t *page, u32 x, u32 y)
+{
+	texture->page = page;
+	texture->handle = page->handle;
+	texture->uv_offset = V2((f32) x, (f32) y);
+	texture->uv_scale = V2(1.f / (f32) R2D_ATLAS_PAGE_SIZE, 1.f / (f32) R2D_ATLAS_PAGE_SIZE);
+	// Clear the padding to the right and below, it may hold a freed texture's pixels
+	static const u8 zero[(R2D_ATLAS_MAX_IMAGE + R2D_ATLAS_PADDING)*R2D_ATLAS_PADDING*4];
+	if ((x + texture->w + R2D_ATLAS_PADDING) <= R2D_ATLAS_PAGE_SIZE)
+		g_backend->update_texture(page->handle, x + texture->w, y, R2D_ATLAS_PADDING, texture->h, zero);
+	if ((y + texture->h + R2D_ATLAS_PADDING) <= R2D_ATLAS_PAGE_SIZE)
+		g_backend->update_texture(page->handle, x, y + texture->h, texture->w + R2D_ATLAS_PADDING, R2D_ATLAS_PADDING, zero);
+};
+// Sort textures tallest first, which packs a skyline much tighter
+static int r2d_compare_texture_height(const void *a, const void *b)
+{
+	const r2d_texture_t *texture_a = *(const r2d_texture_t**) a;
+	const r2d_texture_t *texture_b = *(const r2d_texture_t**) b;
+	return (int) texture_b->h - (int) texture_a->h;
+};
+// Pack the live textures of a page from scratch, reclaiming the space of freed textures
+// NOTE: Atlas textures have no pixels left in memory, they are copied over from the old page on the device
+// Textures that no longer fit are moved to a texture of their own
+// Runs on the upload path, without the texture list mutex
+static void r2d_atlas_repack(r2d_atlas_page_t *page)
+{
+	static r2d_texture_t *textures[MAX_TEXTURES];
+	u32 count = 0;
+	// Loading threads allocate textures meanwhile, hold the lock for the walk and the moves
+	ticket_mtx_lock(&g_texture_list.mtx);
+	for (u32 i = 0; i < g_texture_list.texture_count; i++)
+	{
+		r2d_texture_t *texture = g_texture_list.textures + i;
+		if (texture->page == page)
+			textures[count++] = texture;
+	}
+	qsort(textures, count, sizeof(r2d_texture_t*), r2d_compare_texture_height);
+	g_texture_generation ++;
+	g_stats.atlas_repacks ++;
+
+	// Start over with a blank page texture, the old one is the source of the copies
+	const u32 old_handle = page->handle;
+	page->handle = g_backend->create_texture(R2D_ATLAS_PAGE_SIZE, R2D_ATLAS_PAGE_SIZE, NULL);
+	r2d_atlas_page_reset(page);
+	for (u32 i = 0; i < count; i++)
+	{
+		r2d_texture_t *texture = textures[i];
+		const u32 old_x = (u32) texture->uv_offset.x;
+		const u32 old_y = (u32) texture->uv_offset.y;
+		u32 x, y;
+		if (r2d_atlas_page_insert(page, texture->w, texture->h, &x, &y))
+		{
+			r2d_atlas_place_texture(texture, page, x, y);
+			g_backend->copy_texture(old_handle, old_x, old_y, page->handle, x, y, texture->w, texture->h);
+		} else {
+			texture->page = NULL;
+			texture->handle = g_backend->reserve_texture(texture->w, texture->h);
+			g_backend->copy_texture(old_handle, old_x, old_y, texture->handle, 0, 0, texture->w, texture->h);
+			texture->uv_offset = V2(0.f, 0.f);
+			texture->uv_scale = V2(1.f / (f32) texture->w, 1.f / (f32) texture->h);
+		}
+	}
+	g_backend->destroy_texture(old_handle);
+	ticket_mtx_unlock(&g_texture_list.mtx);
+};
+static bool r2d_atlas_accepts(const r2d_texture_t *texture)
+{
+	return !g_config.disable_atlas && (texture->w <= R2D_ATLAS_MAX_IMAGE) && (texture->h <= R2D_ATLAS_MAX_IMAGE);
+};
+static bool r2d_atlas_add_texture(r2d_texture_t *texture)
+{
+	if (!r2d_atlas_accepts(texture))
+		return false;
+
+	u32 x, y;
+	// Try every page in order, so the first pages fill up first
+	for (u32 i = 0; i < g_atlas.page_count; i++)
+	{
+		r2d_atlas_page_t *page = g_atlas.pages[i];
+		if (r2d_atlas_page_insert(page, texture->w, texture->h, &x, &y))
+		{
+			r2d_atlas_place_texture(texture, page, x, y);
+			g_backend->update_texture(page->handle, x, y, texture->w, texture->h, texture->pixels);
+			return true;
+		}
+	}
+	r2d_atlas_page_t *page = NULL;
+	if (g_atlas.page_count < R2D_ATLAS_MAX_PAGES)
+	{
+		// Open a new page
+		page = malloc(sizeof(r2d_atlas_page_t));
+		assert(page != NULL);
+		page->handle = g_backend->create_texture(R2D_ATLAS_PAGE_SIZE, R2D_ATLAS_PAGE_SIZE, NULL);
+		r2d_atlas_page_reset(page);
+		page->index = g_atlas.page_count;
+		g_atlas.pages[g_atlas.page_count++] = page;
+	} else {
+		// Every page is full, repack the one with the least live texture area
+		page = g_atlas.pages[0];
+		for (u32 i = 1; i < g_atlas.page_count; i++)
+		{
+			if (g_atlas.pages[i]->used_area < page->used_area)
+				page = g_atlas.pages[i];
+		}
+		// NOTE: Repacking copies the whole page and rewrites every static layer, skip it when the freed space can't hold the texture anyway
+		const u32 padded_area = (texture->w + R2D_ATLAS_PADDING)*(texture->h + R2D_ATLAS_PADDING);
+		if ((R2D_ATLAS_PAGE_SIZE*R2D_ATLAS_PAGE_SIZE - page->used_area) < padded_area)
+			return false;
+		r2d_atlas_repack(page);
+	}
+	if (r2d_atlas_page_insert(page, texture->w, texture->h, &x, &y))
+	{
+		r2d_atlas_place_texture(texture, page, x, y);
+		g_backend->update_texture(page->handle, x, y, texture->w, texture->h, texture->pixels);
+		return true;
+	}
+	return false;
+};
+static void r2d_atlas_remove_texture(r2d_texture_t *texture)
+{
+	r2d_atlas_page_t *page = texture->page;
+	assert(page->texture_count > 0);
+	page->texture_count --;
+	page->used_area -= texture->w*texture->h;
+	// Reuse the whole page once it's empty, otherwise the space waits for a repack
+	if (page->texture_count == 0)
+		r2d_atlas_page_reset(page);
+	texture->page = NULL;
+};
+static void r2d_free_atlas()
+{
+	for (u32 i = 0; i < g_atlas.page_count; i++)
+	{
+		g_backend->destroy_texture(g_atlas.pages[i]->handle);
+		free(g_atlas.pages[i]);
+	}
+	g_atlas.page_count = 0;
 };
\ No newline at end of file
@@ -3,8 +3,6 @@
 
 #include <stdio.h>
 
-#include <GL\gl3w.h>
-
 #include "core.h"
 #include "geom.h"
 
@@ -12,25 +10,176 @@
 #define R2D_SCREEN_W	(1920 >> 2)
 #define R2D_SCREEN_H	(1080 >> 2)
 
+// Pack an RGBA8 color, for sprite tints
+#define R2D_RGBA(r,g,b,a)	((u32)(r) | ((u32)(g) << 8) | ((u32)(b) << 16) | ((u32)(a) << 24))
+#define R2D_WHITE			R2D_RGBA(255, 255, 255, 255)
+
 // Forward declare some structures for rendering
 decl_struct(r2d_texture_t);
+decl_struct(r2d_static_layer_t);
+
+// Rendering backends
+typedef enum
+{
+	// OpenGL 3.3 core (default)
+	R2D_BACKEND_GL = 0,
+	// CPU rasterizer writing to an RGBA framebuffer, no GPU required
+	R2D_BACKEND_SOFTWARE,
+	// Discards all drawing, for benchmarking the frontend
+	R2D_BACKEND_NULL,
+} r2d_backend_type_t;
+
+// How sprite geometry is submitted to the backend
+typedef enum
+{
+	// 6 vertices per sprite, drawn as a triangle list (default)
+	R2D_BATCH_TRIANGLES = 0,
+	// 4 vertices per sprite, drawn with a static quad index buffer
+	R2D_BATCH_INDEXED,
+	// One instance record per sprite, corners are expanded by the vertex shader
+	R2D_BATCH_INSTANCED,
+} r2d_batch_mode_t;
+
+// Vertex format of R2D_BATCH_TRIANGLES/R2D_BATCH_INDEXED batches
+typedef enum
+{
+	// f32 positions and UVs, 16 bytes (default)
+	R2D_VERTEX_FLOAT = 0,
+	// i16 sub-pixel positions and u16 normalized UVs, 8 bytes
+	// NOTE: Positions are limited to +/-R2D_PACKED_POS_RANGE, anything further is clamped
+	R2D_VERTEX_PACKED,
+	// R2D_VERTEX_PACKED plus the sprite's RGBA8 tint, 12 bytes
+	R2D_VERTEX_PACKED_TINT,
+} r2d_vertex_format_t;
+
+// Sub-pixel steps per unit of packed vertex positions, and the resulting range
+#define R2D_PACKED_POS_SCALE	(8)
+#define R2D_PACKED_POS_RANGE	(32767 / R2D_PACKED_POS_SCALE)
+
+// Instruction set used to transform sprite corners
+typedef enum
+{
+	// Widest one the CPU supports (default)
+	R2D_SIMD_AUTO = 0,
+	R2D_SIMD_SCALAR,
+	R2D_SIMD_SSE2,
+	R2D_SIMD_AVX2,
+} r2d_simd_t;
+
+// Library configuration, zero initialized for the defaults
+typedef struct
+{
+	r2d_backend_type_t backend;
+	r2d_batch_mode_t batch_mode;
+	// Vertex format, ignored by R2D_BATCH_INSTANCED
+	r2d_vertex_format_t vertex_format;
+	// Draw commands in call order instead of sorting them by layer/texture
+	// NOTE: Sorting keeps call order within a layer and texture, only overlapping sprites with different textures are affected
+	bool preserve_order;
+	// Give every texture its own backend texture instead of packing small ones into atlas pages
+	bool disable_atlas;
+	// Draw every sprite instead of skipping the ones outside the viewport
+	bool disable_culling;
+	// Worker threads used to build sprite batches, zero to build them on the calling thread
+	u32 worker_threads;
+	// Sprite corner kernel
+	r2d_simd_t simd;
+	// Texture upload budget of each flush, in bytes of pixels and in milliseconds, zero for no limit
+	// NOTE: Textures past the budget wait for the next flush, ones larger than it are uploaded a strip of rows at a time
+	// At least one strip is uploaded every flush, so uploads always make progress
+	u32 upload_budget_bytes;
+	f32 upload_budget_ms;
+	// GLSL source of the sprite shaders for the GL backend, NULL to load data/shader.vert and data/shader.frag
+	// NOTE: Only read by r2d_init, e.g. straight from an archive mapping
+	const char *vertex_shader;
+	const char *fragment_shader;
+} r2d_config_t;
+
+// Statistics for the last flushed frame
+typedef struct
+{
+	u32 sprites;		// Sprites pushed into the batch
+	u32 culled;			// Sprites skipped outside the viewport
+	u32 static_sprites;	// Sprites drawn from static layers
+	u32 vertices;		// Vertices generated
+	u32 batches;		// Batches handed to the backend
+	u32 draw_calls;		// Draw calls issued (one per batch range)
+	u32 unsorted_ranges;	// Batch ranges the frame would need in call order
+	u64 upload_bytes;	// Vertex data uploaded, in bytes
+	u64 frame_bytes;	// Frame arena memory used, in bytes
+	u64 frame_bytes_peak;	// Most frame arena memory any frame has used
+	u64 pixel_bytes;	// Texture pixels held in memory, waiting for upload, in bytes
+	u64 texture_upload_bytes;	// Texture pixels uploaded, in bytes
+	u32 textures_uploaded;	// Textures that finished uploading
+	u32 textures_pending;	// Textures still waiting for (the rest of) their upload
+	u32 atlas_repacks;	// Atlas pages repacked to reclaim the space of freed textures
+} r2d_stats_t;
 
 // Library initialization/destruction
-bool r2d_init();
+// NOTE: Pass NULL for the default configuration
+bool r2d_init(const r2d_config_t *config);
 void r2d_free();
 
 // Get the viewport position of a point on the screen
 v2 r2d_screen_to_viewport(v2 screen);
 
+// Frees pixels handed over to r2d_adopt_texture
+typedef void (*r2d_free_pixels_t)(u8 *pixels, void *user);
+
 // Allocate/free teextures for drawing
-r2d_texture_t* r2d_alloc_texture(u32 width, u32 height, u8 *pixels);
+// NOTE: r2d_alloc_texture copies the pixels, the caller keeps them
+r2d_texture_t* r2d_alloc_texture(u32 width, u32 height, const u8 *pixels);
+// Allocate a texture that takes ownership of its pixels instead of copying them
+// NOTE: free_pixels (or free, if NULL) is called once the pixels are uploaded, or the texture is freed
+// Atlas textures too, repacking a page copies them over from the old page on the device
+r2d_texture_t* r2d_adopt_texture(u32 width, u32 height, u8 *pixels, r2d_free_pixels_t free_pixels, void *user);
 void           r2d_free_texture(r2d_texture_t *texture);
+// Replace the pixels of a texture in place, taking ownership of them like r2d_adopt_texture
+// NOTE: The old pixels are drawn until the new ones are uploaded, then the swap is atomic to the renderer
+// The size may change, sprite rectangles are in texels so they may need updating too
+void           r2d_replace_texture(r2d_texture_t *texture, u32 width, u32 height, u8 *pixels, r2d_free_pixels_t free_pixels, void *user);
+
+// Rebuild the sprite shaders from GLSL sources, NULL to load data/shader.vert and data/shader.frag
+// NOTE: Call from the rendering thread, on failure the previous shaders stay in use
+// Backends without shaders return true
+bool r2d_reload_shader(const char *vertex_shader, const char *fragment_shader);
 
 // Clear the draw buffer and begin a new frame
 void r2d_clear(u32 width, u32 height);
+// Set the layer of the following sprites, layers are drawn in ascending order
+// NOTE: Reset to 0 by r2d_clear
+void r2d_set_layer(u8 layer);
 // Draw a sprite with a given texture and transformation
 void r2d_draw_sprite(r2d_texture_t *texture, aabb_t sprite, xform2d_t xform);
+// Draw a sprite multiplied by an RGBA8 color (see R2D_RGBA)
+// NOTE: Tints are only applied with R2D_VERTEX_PACKED_TINT, other formats draw the sprite untinted
+void r2d_draw_sprite_tint(r2d_texture_t *texture, aabb_t sprite, xform2d_t xform, u32 tint);
 // Flush the draw buffer to the screen
 void r2d_flush();
 
+// Allocate/free static layers, sprites kept in a backend buffer and redrawn without rebuilding their vertices
+// NOTE: Vertices use the configured format, so packed formats limit positions to +/-R2D_PACKED_POS_RANGE
+r2d_static_layer_t* r2d_alloc_static_layer(u32 capacity);
+void                r2d_free_static_layer(r2d_static_layer_t *layer);
+// Set sprite index of a static layer, a NULL texture removes it
+// NOTE: Only the sprites changed since the layer was last drawn are rewritten
+void r2d_set_static_sprite(r2d_static_layer_t *layer, u32 index, r2d_texture_t *texture, aabb_t sprite, xform2d_t xform);
+// Draw a static layer this frame, with every sprite moved by offset
+// NOTE: Static layers are drawn beneath all other sprites, in call order
+void r2d_draw_static_layer(r2d_static_layer_t *layer, v2 offset);
+// Draw count sprites of a static layer starting at index first, like r2d_draw_static_layer
+// NOTE: For drawing only the part of a layer in view, the sprites are still written and uploaded as a whole
+void r2d_draw_static_layer_range(r2d_static_layer_t *layer, u32 first, u32 count, v2 offset);
+
+// Get the statistics of the last flushed frame
+r2d_stats_t r2d_get_stats();
+
+// Get the arena for per-frame allocations, reset by r2d_clear
+// NOTE: Allocations stay valid until the end of the following frame, the arenas alternate
+arena_t* r2d_get_frame_arena();
+
+// Get the RGBA8 framebuffer of the last flushed frame, rows from top to bottom
+// NOTE: Only available with the software backend, returns NULL otherwise
+const u8* r2d_get_framebuffer(u32 *width, u32 *height);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "render2d_atlas.h"
+
+void r2d_atlas_page_reset(r2d_atlas_page_t *page)
+{
+	page->texture_count = 0;
+	page->used_area = 0;
+	// A single segment along the bottom edge
+	page->node_count = 1;
+	page->nodes[0].x = 0;
+	page->nodes[0].y = 0;
+	page->nodes[0].w = R2D_ATLAS_PAGE_SIZE;
+};
+
+// Get the lowest y a width x height rectangle fits at, starting at a segment
+static bool r2d_skyline_fit(const r2d_atlas_page_t *page, u32 index, u32 width, u32 height, u32 *y)
+{
+	const r2d_skyline_node_t *node = page->nodes + index;
+	if ((node->x + width) > R2D_ATLAS_PAGE_SIZE)
+		return false;
+	// Rest on the highest segment under the rectangle
+	u32 top = 0;
+	i32 remaining = (i32) width;
+	while (remaining > 0)
+	{
+		assert(index < page->node_count);
+		node = page->nodes + index++;
+		top = max(top, node->y);
+		if ((top + height) > R2D_ATLAS_PAGE_SIZE)
+			return false;
+		remaining -= node->w;
+	}
+	*y = top;
+	return true;
+};
+static void r2d_skyline_remove(r2d_atlas_page_t *page, u32 index)
+{
+	memmove(page->nodes + index, page->nodes + index + 1,
+		(page->node_count - index - 1)*sizeof(r2d_skyline_node_t));
+	page->node_count --;
+};
+
+bool r2d_atlas_page_insert(r2d_atlas_page_t *page, u32 width, u32 height, u32 *x, u32 *y)
+{
+	const u32 w = width + R2D_ATLAS_PADDING;
+	const u32 h = height + R2D_ATLAS_PADDING;
+	// Find the segment giving the lowest top edge, then the tightest fit
+	u32 best_index = U32_MAX;
+	u32 best_top = U32_MAX, best_w = U32_MAX;
+	u32 best_y = 0;
+	for (u32 i = 0; i < page->node_count; i++)
+	{
+		u32 fit_y;
+		if (r2d_skyline_fit(page, i, w, h, &fit_y))
+		{
+			const u32 top = fit_y + h;
+			if ((top < best_top) || ((top == best_top) && (page->nodes[i].w < best_w)))
+			{
+				best_index = i;
+				best_top = top;
+				best_w = page->nodes[i].w;
+				best_y = fit_y;
+			}
+		}
+	}
+	if (best_index == U32_MAX)
+		return false;
+	// The page can't have more segments than pixel columns
+	assert(page->node_count < R2D_ATLAS_PAGE_SIZE);
+
+	// Insert the new segment
+	memmove(page->nodes + best_index + 1, page->nodes + best_index,
+		(page->node_count - best_index)*sizeof(r2d_skyline_node_t));
+	page->node_count ++;
+
+	r2d_skyline_node_t *node = page->nodes + best_index;
+	node->y = (u16) (best_y + h);
+	node->w = (u16) w;
+	const u32 left = node->x;
+	// Trim the segments it covers
+	const u32 right = left + w;
+	for (u32 i = best_index + 1; i < page->node_count;)
+	{
+		r2d_skyline_node_t *next = page->nodes + i;
+		if (next->x >= right)
+			break;
+		const u32 overlap = right - next->x;
+		if (next->w > overlap)
+		{
+			next->x += overlap;
+			next->w -= overlap;
+			break;
+		}
+		r2d_skyline_remove(page, i);
+	}
+	// Merge neighbouring segments at the same height
+	for (u32 i = 0; (i + 1) < page->node_count;)
+	{
+		if (page->nodes[i].y == page->nodes[i + 1].y)
+		{
+			page->nodes[i].w += page->nodes[i + 1].w;
+			r2d_skyline_remove(page, i + 1);
+		} else {
+			i ++;
+		}
+	}
+	*x = left;
+	*y = best_y;
+	page->texture_count ++;
+	page->used_area += width*height;
+	return true;
+};
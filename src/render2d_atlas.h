@@ -0,0 +1,44 @@
+#ifndef RENDER_ATLAS_H
+#define RENDER_ATLAS_H
+
+#include "core.h"
+
+// Texture atlas pages, small textures are packed into a few large backend textures
+// so sprites from different images can share a batch range
+
+// Atlas page width/height, in pixels
+#define R2D_ATLAS_PAGE_SIZE		(2048)
+// Maximum atlas pages, once every page is full the emptiest one is repacked
+#define R2D_ATLAS_MAX_PAGES		(8)
+// Textures larger than this (in either dimension) get their own backend texture
+#define R2D_ATLAS_MAX_IMAGE		(512)
+// Empty pixels kept between packed textures, so neighbours can't bleed into each other
+#define R2D_ATLAS_PADDING		(1)
+
+// Skyline segment, the top edge of the packed area over [x, x+w)
+typedef struct
+{
+	u16 x, y;
+	u16 w;
+} r2d_skyline_node_t;
+
+typedef struct
+{
+	// Backend texture handle, and the page's position in the renderer's page list
+	u32 handle;
+	u32 index;
+	// Textures packed into the page, and their area (in pixels)
+	u32 texture_count;
+	u32 used_area;
+	// Skyline, left to right
+	u32 node_count;
+	r2d_skyline_node_t nodes[R2D_ATLAS_PAGE_SIZE];
+} r2d_atlas_page_t;
+
+// Empty an atlas page
+void r2d_atlas_page_reset(r2d_atlas_page_t *page);
+// Find space for a width x height texture, returns false if the page is full
+// NOTE: Uses the bottom-left skyline heuristic, freed space is only reclaimed by a reset
+bool r2d_atlas_page_insert(r2d_atlas_page_t *page, u32 width, u32 height, u32 *x, u32 *y);
+
+#endif
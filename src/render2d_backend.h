@@ -0,0 +1,152 @@
+#ifndef RENDER_BACKEND_H
+#define RENDER_BACKEND_H
+
+#include "render2d.h"
+
+// Internal interface between the render2d frontend (draw list, batching, textures)
+// and the device that actually produces pixels
+
+// Maximum sprites/vertices handed to a backend in a single batch
+// NOTE: Larger frames are split into several batches
+#define R2D_MAX_BATCH_SPRITES	(1 << 14)
+#define R2D_MAX_BATCH_VERTS		(R2D_MAX_BATCH_SPRITES*6)
+
+// Maximum static layers alive at once, each one owns a backend buffer
+#define R2D_MAX_STATIC_LAYERS	(64)
+
+// Triangle list indices of a sprite quad, corners are clockwise from the top left
+#define R2D_QUAD_INDICES		{ 0, 1, 2, 0, 2, 3 }
+
+// Default vertex structure
+typedef struct
+{
+	v2 pos;
+	v2 uv;
+} r2d_vertex_t;
+
+// Packed vertex structure (R2D_VERTEX_PACKED)
+typedef struct
+{
+	i16 pos[2];	// Position, in 1/R2D_PACKED_POS_SCALE units
+	u16 uv[2];	// Normalized texture coordinates
+} r2d_packed_vertex_t;
+// Packed vertex with a tint (R2D_VERTEX_PACKED_TINT), starts like r2d_packed_vertex_t
+typedef struct
+{
+	i16 pos[2];
+	u16 uv[2];
+	u32 tint;	// RGBA8 color
+} r2d_tinted_vertex_t;
+
+// Per sprite instance record (R2D_BATCH_INSTANCED)
+typedef struct
+{
+	v2 pos;		// Sprite center
+	v2 axis_x;	// Transformed sprite width vector
+	v2 axis_y;	// Transformed sprite height vector
+	u16 uv[4];	// Normalized texture rectangle (min x, min y, max x, max y)
+} r2d_instance_t;
+
+// Elements (vertices or instances) written per sprite in a batch mode
+static inline u32 r2d_batch_sprite_elements(r2d_batch_mode_t mode)
+{
+	switch (mode)
+	{
+		case R2D_BATCH_INDEXED:   return 4;
+		case R2D_BATCH_INSTANCED: return 1;
+		default:                  return 6;
+	}
+};
+// Size of a batch element in a configuration
+static inline size_t r2d_batch_element_size(const r2d_config_t *config)
+{
+	if (config->batch_mode == R2D_BATCH_INSTANCED)
+		return sizeof(r2d_instance_t);
+	switch (config->vertex_format)
+	{
+		case R2D_VERTEX_PACKED:      return sizeof(r2d_packed_vertex_t);
+		case R2D_VERTEX_PACKED_TINT: return sizeof(r2d_tinted_vertex_t);
+		default:                     return sizeof(r2d_vertex_t);
+	}
+};
+// Size of a full batch in a configuration, in bytes
+static inline size_t r2d_batch_size(const r2d_config_t *config)
+{
+	return R2D_MAX_BATCH_SPRITES*r2d_batch_sprite_elements(config->batch_mode)*r2d_batch_element_size(config);
+};
+// Vertices processed per sprite in a batch mode
+static inline u32 r2d_batch_sprite_vertices(r2d_batch_mode_t mode)
+{
+	return (mode == R2D_BATCH_TRIANGLES) ? 6 : 4;
+};
+
+// A run of batch elements drawn with a single texture
+// NOTE: In R2D_BATCH_INDEXED mode every 4 vertices form a quad, and a range never holds more than R2D_MAX_BATCH_SPRITES sprites
+typedef struct
+{
+	// Range texture
+	u32 texture_handle;
+	// Range coordinates
+	u32 offset; // Offset, in number of batch elements
+	u32 count;	// Count, in number of batch elements
+} r2d_batch_range_t;
+
+// Viewport structure, used for resolution independent rendering
+typedef struct
+{
+	// Viewport coordinates
+	int x,y,w,h;
+	// Viewport scale
+	v2 scale;
+	// Viewport projection matrix
+	m44 projection;
+} r2d_viewport_t;
+
+typedef struct
+{
+	// Backend initialization/destruction
+	bool (*init)(const r2d_config_t *config);
+	void (*free)();
+	// Rebuild the sprite shaders from GLSL sources (NULL to load them from disk), NULL if the backend has none
+	// NOTE: On failure the previous shaders stay in use
+	bool (*reload_shader)(const char *vertex_shader, const char *fragment_shader);
+
+	// Create a texture from RGBA8 pixels, returns a non-zero handle
+	// NOTE: NULL pixels create a transparent texture
+	u32  (*create_texture)(u32 width, u32 height, const u8 *pixels);
+	// Create a texture with undefined contents, to be filled in with update_texture
+	u32  (*reserve_texture)(u32 width, u32 height);
+	// Replace a rectangle of a texture with RGBA8 pixels
+	void (*update_texture)(u32 handle, u32 x, u32 y, u32 width, u32 height, const u8 *pixels);
+	// Copy a rectangle from one texture to another on the device, without going through CPU memory
+	void (*copy_texture)(u32 src_handle, u32 src_x, u32 src_y, u32 dst_handle, u32 dst_x, u32 dst_y, u32 width, u32 height);
+	void (*destroy_texture)(u32 handle);
+
+	// Clear the target and set up the viewport for a new frame
+	void (*begin_frame)(u32 width, u32 height, const r2d_viewport_t *viewport);
+	// Get write-only memory for the next batch, large enough for a full batch
+	// NOTE: The frontend writes r2d_vertex_t or r2d_instance_t elements (depending on the batch mode) straight into it
+	void* (*map_batch)();
+	// Draw the mapped batch, one texture per range
+	void (*draw_batch)(u32 count, const r2d_batch_range_t *ranges, u32 range_count);
+	// Finish the frame
+	void (*end_frame)();
+
+	// Create a buffer for the batch elements of a static layer, returns a non-zero handle
+	u32  (*create_buffer)(size_t size);
+	// Replace bytes [offset, offset + size) of a static buffer
+	void (*update_buffer)(u32 handle, size_t offset, size_t size, const void *data);
+	void (*destroy_buffer)(u32 handle);
+	// Draw ranges of a static buffer, with every position moved by offset
+	void (*draw_buffer)(u32 handle, v2 offset, const r2d_batch_range_t *ranges, u32 range_count);
+
+	// Read back the color target, NULL if not supported
+	const u8* (*get_framebuffer)(u32 *width, u32 *height);
+} r2d_backend_t;
+
+// Available backends
+extern const r2d_backend_t g_r2d_gl_backend;
+extern const r2d_backend_t g_r2d_soft_backend;
+extern const r2d_backend_t g_r2d_null_backend;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,703 @@
+#include <GL/gl3w.h>
+
+#include "render2d_backend.h"
+
+// Helper function for loading a file from disk
+static u8* r2d_load_entire_file(const char *file_name, size_t *size)
+{
+	u8* buffer = NULL;
+
+	FILE *f = fopen(file_name, "rb");
+	if (f)
+	{
+		fseek(f, 0, SEEK_END);
+		const size_t f_size = ftell(f);
+		fseek(f, 0, SEEK_SET);
+
+		buffer = malloc((f_size+1)*sizeof(u8));
+		assert(buffer != NULL);
+		fread(buffer, sizeof(u8), f_size, f);
+		fclose(f);
+
+		buffer[f_size] = '\0';
+
+		if (size) *size = f_size;
+	};
+	return buffer;
+};
+
+// Structure for describing OpenGL vertex layouts
+typedef struct
+{
+	u32 size;			// Size (in # of members) of the vertex attrib
+	GLenum type;		// Type (BYTE, SHORT, FLOAT, etc)
+	bool normalized;	// Normalized? (See OpenGL docs)
+	size_t stride;		// Stride in bytes to next instance of this attrib
+	size_t offset;		// Offset in bytes from the beginning of the vertex data to this attrib
+	u32 divisor;		// Instance divisor, zero for per-vertex data
+} r2d_vertex_layout_t;
+
+// Bind a vertex layout array, starting base bytes into the buffer
+static inline void r2d_bind_vertex_layout(const r2d_vertex_layout_t *layout, size_t len, size_t base)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		glEnableVertexAttribArray(i);
+		glVertexAttribPointer(i,
+			layout[i].size,
+			layout[i].type,
+			layout[i].normalized,
+			layout[i].stride,
+			(const void*) (base + layout[i].offset));
+		glVertexAttribDivisor(i, layout[i].divisor);
+	}
+};
+
+// Default vertex structure layout
+static const r2d_vertex_layout_t g_vertex_layout[] =
+{
+	{ 2, GL_FLOAT, false, sizeof(r2d_vertex_t), offsetof(r2d_vertex_t, pos) },
+	{ 2, GL_FLOAT, false, sizeof(r2d_vertex_t), offsetof(r2d_vertex_t, uv) },
+};
+// Packed vertex layout (R2D_VERTEX_PACKED), positions stay in sub-pixel units and are scaled by the projection
+static const r2d_vertex_layout_t g_packed_layout[] =
+{
+	{ 2, GL_SHORT,          false, sizeof(r2d_packed_vertex_t), offsetof(r2d_packed_vertex_t, pos) },
+	{ 2, GL_UNSIGNED_SHORT, true,  sizeof(r2d_packed_vertex_t), offsetof(r2d_packed_vertex_t, uv) },
+};
+// Packed vertex layout with a tint (R2D_VERTEX_PACKED_TINT)
+static const r2d_vertex_layout_t g_tinted_layout[] =
+{
+	{ 2, GL_SHORT,          false, sizeof(r2d_tinted_vertex_t), offsetof(r2d_tinted_vertex_t, pos) },
+	{ 2, GL_UNSIGNED_SHORT, true,  sizeof(r2d_tinted_vertex_t), offsetof(r2d_tinted_vertex_t, uv) },
+	{ 4, GL_UNSIGNED_BYTE,  true,  sizeof(r2d_tinted_vertex_t), offsetof(r2d_tinted_vertex_t, tint) },
+};
+// Instance structure layout (R2D_BATCH_INSTANCED)
+static const r2d_vertex_layout_t g_instance_layout[] =
+{
+	{ 2, GL_FLOAT,          false, sizeof(r2d_instance_t), offsetof(r2d_instance_t, pos),    1 },
+	{ 2, GL_FLOAT,          false, sizeof(r2d_instance_t), offsetof(r2d_instance_t, axis_x), 1 },
+	{ 2, GL_FLOAT,          false, sizeof(r2d_instance_t), offsetof(r2d_instance_t, axis_y), 1 },
+	{ 4, GL_UNSIGNED_SHORT, true,  sizeof(r2d_instance_t), offsetof(r2d_instance_t, uv),     1 },
+};
+
+// Default drawing shader
+static struct
+{
+	u32 program;
+	// Locations
+	u32 u_projection;
+	u32 u_offset;
+	u32 u_sampler;
+} g_draw_shader;
+
+// Frames of batch data the ring buffer holds before wrapping, it grows to fit the largest frame that many times
+#define R2D_GL_RING_FRAMES	(3)
+// Largest ring buffer, frames bigger than a third of it wrap onto their own batches
+#define R2D_GL_MAX_RING_SIZE	(megabytes(96))
+// Maximum fences in flight
+#define R2D_GL_MAX_FENCES	(64)
+
+// Fence guarding a region of the ring buffer, in ring positions
+typedef struct
+{
+	GLsync sync;
+	u64 start, end;
+} r2d_gl_fence_t;
+
+// Streaming ring buffer, batches are written straight into it and drawn in place
+// NOTE: Positions count bytes since init, the buffer offset is (position % size)
+static struct
+{
+	// Batch geometry mode and vertex format
+	r2d_batch_mode_t mode;
+	r2d_vertex_format_t format;
+	size_t element_size;
+	// Ring size, and the size reserved for each batch (in bytes)
+	size_t size;
+	size_t batch_size;
+	// Write position, the start of the mapped batch, and of the frame
+	u64 head;
+	u64 batch_start;
+	u64 frame_start;
+	// Start of the data written since the last fence
+	u64 pending;
+	// Persistent (coherent) mapping of the whole ring, NULL when mapping each batch instead
+	u8 *persistent;
+	// Fence queue, oldest first
+	u32 fence_first;
+	u32 fence_count;
+	r2d_gl_fence_t fences[R2D_GL_MAX_FENCES];
+	// OpenGL handles
+	u32 vao;
+	u32 buf;
+	// Static quad index buffer (R2D_BATCH_INDEXED)
+	u32 ibo;
+} g_gl_batch;
+
+// Projection for the current frame
+static m44 g_gl_projection;
+
+// Static layer buffers, handles are (index + 1)
+static struct
+{
+	u32 vao;
+	u32 buf;
+} g_gl_buffers[R2D_MAX_STATIC_LAYERS];
+
+// Build the draw shader from GLSL sources, NULL to load them from disk
+// NOTE: The current program is only replaced once the new one links, so a broken reload keeps the old one
+static bool r2d_load_draw_shader(r2d_batch_mode_t mode, const char *vertex_shader, const char *fragment_shader)
+{
+	bool result = false;
+
+	// Use the given sources, or load them from disk
+	char *vert_file = vertex_shader ? NULL : (char*) r2d_load_entire_file("data/shader.vert", NULL);
+	char *frag_file = fragment_shader ? NULL : (char*) r2d_load_entire_file("data/shader.frag", NULL);
+	const char *vert_code = vertex_shader ? vertex_shader : vert_file;
+	const char *frag_code = fragment_shader ? fragment_shader : frag_file;
+	if (vert_code && frag_code)
+	{
+		const u32 shader_vert = glCreateShader(GL_VERTEX_SHADER);
+		const u32 shader_frag = glCreateShader(GL_FRAGMENT_SHADER);
+
+		// Inject the mode defines after the #version line, which has to come first
+		const char *defines = (mode == R2D_BATCH_INSTANCED) ? "#define R2D_INSTANCED 1\n" : "";
+		const char *vert_body = strchr(vert_code, '\n');
+		vert_body = vert_body ? (vert_body + 1) : (vert_code + strlen(vert_code));
+		const char *vert_sources[] = { vert_code, defines, vert_body };
+		const int vert_lengths[] = { (int) (vert_body - vert_code), -1, -1 };
+
+		glShaderSource(shader_vert, static_len(vert_sources), vert_sources, vert_lengths);
+		glShaderSource(shader_frag, 1, &frag_code, NULL);
+
+		glCompileShader(shader_vert);
+		glCompileShader(shader_frag);
+
+		const u32 program = glCreateProgram();
+		glAttachShader(program, shader_vert);
+		glAttachShader(program, shader_frag);
+		glLinkProgram(program);
+
+		glDeleteShader(shader_vert);
+		glDeleteShader(shader_frag);
+
+		int len;
+		char buf[1024];
+		glGetProgramInfoLog(program, static_len(buf), &len, buf);
+		if (!len)
+		{
+			glDeleteProgram(g_draw_shader.program);
+			g_draw_shader.program = program;
+			g_draw_shader.u_projection = glGetUniformLocation(program, "u_projection");
+			g_draw_shader.u_offset = glGetUniformLocation(program, "u_offset");
+			g_draw_shader.u_sampler = glGetUniformLocation(program, "u_sampler");
+			result = true;
+		} else {
+			fprintf(stderr, "%s", buf);
+			glDeleteProgram(program);
+		}
+	}
+	free(vert_file);
+	free(frag_file);
+	return result;
+}
+static void r2d_free_draw_shader()
+{
+	glDeleteProgram(g_draw_shader.program);
+	g_draw_shader.program = 0;
+};
+
+// Generate the index buffer for a full batch of quads
+// NOTE: R2D_MAX_BATCH_SPRITES*4 vertices still fit in 16 bit indices
+static u32 r2d_gl_alloc_quad_indices()
+{
+	const u16 quad[] = R2D_QUAD_INDICES;
+	const size_t count = R2D_MAX_BATCH_SPRITES*static_len(quad);
+	assert((R2D_MAX_BATCH_SPRITES*4) <= (U16_MAX+1));
+
+	u16 *indices = malloc(count*sizeof(u16));
+	assert(indices != NULL);
+	for (u32 i = 0; i < R2D_MAX_BATCH_SPRITES; i++)
+	{
+		for (u32 j = 0; j < static_len(quad); j++)
+			indices[i*static_len(quad) + j] = (u16) (i*4 + quad[j]);
+	}
+	u32 ibo = 0;
+	glGenBuffers(1, &ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, count*sizeof(u16), indices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	free(indices);
+	return ibo;
+};
+// Check for an OpenGL extension
+static bool r2d_gl_has_extension(const char *name)
+{
+	int count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int i = 0; i < count; i++)
+	{
+		const char *extension = (const char*) glGetStringi(GL_EXTENSIONS, i);
+		if (extension && (strcmp(extension, name) == 0))
+			return true;
+	}
+	return false;
+};
+// Set up the bound vertex array for the batch format, reading from the bound buffer
+// NOTE: Vertices are drawn with a base vertex, so the layout is bound once. Instances are re-bound per range, see r2d_gl_draw_ranges
+static void r2d_gl_bind_batch_layout()
+{
+	if (g_gl_batch.mode != R2D_BATCH_INSTANCED)
+	{
+		switch (g_gl_batch.format)
+		{
+			case R2D_VERTEX_PACKED:      r2d_bind_vertex_layout(g_packed_layout, static_len(g_packed_layout), 0); break;
+			case R2D_VERTEX_PACKED_TINT: r2d_bind_vertex_layout(g_tinted_layout, static_len(g_tinted_layout), 0); break;
+			default:                     r2d_bind_vertex_layout(g_vertex_layout, static_len(g_vertex_layout), 0); break;
+		}
+	}
+	// The element binding is part of the vertex array state
+	if (g_gl_batch.ibo)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_gl_batch.ibo);
+};
+// Allocate the ring buffer and bind it to the batch vertex array
+static void r2d_gl_alloc_ring(size_t size)
+{
+	g_gl_batch.size = size;
+	g_gl_batch.head = g_gl_batch.batch_start = g_gl_batch.frame_start = g_gl_batch.pending = 0;
+	glGenBuffers(1, &g_gl_batch.buf);
+	glBindVertexArray(g_gl_batch.vao);
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, g_gl_batch.buf);
+		// Map the ring once for the lifetime of the buffer if immutable storage is available
+		if (gl3wIsSupported(4, 4) || r2d_gl_has_extension("GL_ARB_buffer_storage"))
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_ARRAY_BUFFER, g_gl_batch.size, NULL, flags);
+			g_gl_batch.persistent = glMapBufferRange(GL_ARRAY_BUFFER, 0, g_gl_batch.size, flags);
+			if (!g_gl_batch.persistent)
+			{
+				// Storage is immutable, start over with a new buffer
+				glDeleteBuffers(1, &g_gl_batch.buf);
+				glGenBuffers(1, &g_gl_batch.buf);
+				glBindBuffer(GL_ARRAY_BUFFER, g_gl_batch.buf);
+			}
+		}
+		if (!g_gl_batch.persistent)
+			glBufferData(GL_ARRAY_BUFFER, g_gl_batch.size, NULL, GL_STREAM_DRAW);
+		r2d_gl_bind_batch_layout();
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+};
+// Free the ring buffer and its fences
+// NOTE: The GL keeps the buffer alive until the draws reading it are done, so nothing waits on the fences
+static void r2d_gl_free_ring()
+{
+	for (u32 i = 0; i < g_gl_batch.fence_count; i++)
+		glDeleteSync(g_gl_batch.fences[(g_gl_batch.fence_first + i) % R2D_GL_MAX_FENCES].sync);
+	g_gl_batch.fence_first = g_gl_batch.fence_count = 0;
+	if (g_gl_batch.persistent)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, g_gl_batch.buf);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		g_gl_batch.persistent = NULL;
+	}
+	glDeleteBuffers(1, &g_gl_batch.buf);
+	g_gl_batch.buf = 0;
+};
+static void r2d_gl_alloc_batch(const r2d_config_t *config)
+{
+	const r2d_batch_mode_t mode = config->batch_mode;
+	memset(&g_gl_batch, 0, sizeof(g_gl_batch));
+	g_gl_batch.mode = mode;
+	g_gl_batch.format = config->vertex_format;
+	g_gl_batch.element_size = r2d_batch_element_size(config);
+	g_gl_batch.batch_size = r2d_batch_size(config);
+
+	glGenVertexArrays(1, &g_gl_batch.vao);
+	if (mode == R2D_BATCH_INDEXED)
+		g_gl_batch.ibo = r2d_gl_alloc_quad_indices();
+	// Start out with room for frames of one batch, r2d_gl_end_frame grows it
+	r2d_gl_alloc_ring(g_gl_batch.batch_size*R2D_GL_RING_FRAMES);
+	// Formats without a tint attribute read the generic value, make it white
+	glVertexAttrib4f(2, 1.f, 1.f, 1.f, 1.f);
+};
+static void r2d_gl_free_batch()
+{
+	r2d_gl_free_ring();
+	glDeleteVertexArrays(1, &g_gl_batch.vao);
+	if (g_gl_batch.ibo)
+		glDeleteBuffers(1, &g_gl_batch.ibo);
+	memset(&g_gl_batch, 0, sizeof(g_gl_batch));
+};
+
+// Block until the oldest fence has signaled, and remove it
+static void r2d_gl_wait_fence()
+{
+	assert(g_gl_batch.fence_count > 0);
+	r2d_gl_fence_t *fence = g_gl_batch.fences + g_gl_batch.fence_first;
+	GLenum result = glClientWaitSync(fence->sync, 0, 0);
+	while (result == GL_TIMEOUT_EXPIRED)
+	{
+		// Flush on the slow path, in case the fence hasn't been submitted yet
+		result = glClientWaitSync(fence->sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+	glDeleteSync(fence->sync);
+	g_gl_batch.fence_first = (g_gl_batch.fence_first + 1) % R2D_GL_MAX_FENCES;
+	g_gl_batch.fence_count --;
+};
+// Fence the ring data written since the last fence
+static void r2d_gl_fence_pending()
+{
+	if (g_gl_batch.head == g_gl_batch.pending)
+		return;
+	if (g_gl_batch.fence_count == R2D_GL_MAX_FENCES)
+		r2d_gl_wait_fence();
+
+	const u32 index = (g_gl_batch.fence_first + g_gl_batch.fence_count++) % R2D_GL_MAX_FENCES;
+	r2d_gl_fence_t *fence = g_gl_batch.fences + index;
+	fence->sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	fence->start = g_gl_batch.pending;
+	fence->end = g_gl_batch.head;
+	g_gl_batch.pending = g_gl_batch.head;
+};
+
+// Texture uploads at least this large are staged through a pixel unpack buffer
+#define R2D_GL_STAGING_MIN_BYTES	(kilobytes(64))
+// Staging buffers, used in turn
+#define R2D_GL_STAGING_BUFFERS		(3)
+
+static struct
+{
+	u32 buffers[R2D_GL_STAGING_BUFFERS];
+	u32 next;
+} g_gl_staging;
+// Framebuffer the source of texture copies is attached to
+static u32 g_gl_copy_fbo;
+
+static bool r2d_gl_init(const r2d_config_t *config)
+{
+	if (r2d_load_draw_shader(config->batch_mode, config->vertex_shader, config->fragment_shader))
+	{
+		r2d_gl_alloc_batch(config);
+		glGenBuffers(R2D_GL_STAGING_BUFFERS, g_gl_staging.buffers);
+		g_gl_staging.next = 0;
+		glGenFramebuffers(1, &g_gl_copy_fbo);
+		return true;
+	}
+	return false;
+};
+static void r2d_gl_free()
+{
+	r2d_free_draw_shader();
+	r2d_gl_free_batch();
+	glDeleteBuffers(R2D_GL_STAGING_BUFFERS, g_gl_staging.buffers);
+	memset(&g_gl_staging, 0, sizeof(g_gl_staging));
+	glDeleteFramebuffers(1, &g_gl_copy_fbo);
+	g_gl_copy_fbo = 0;
+};
+
+static bool r2d_gl_reload_shader(const char *vertex_shader, const char *fragment_shader)
+{
+	return r2d_load_draw_shader(g_gl_batch.mode, vertex_shader, fragment_shader);
+};
+
+static u32 r2d_gl_reserve_texture(u32 width, u32 height)
+{
+	u32 handle = 0;
+	glGenTextures(1, &handle);
+	glBindTexture(GL_TEXTURE_2D, handle);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D,
+		0, GL_RGBA, width, height,
+		0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return handle;
+};
+static u32 r2d_gl_create_texture(u32 width, u32 height, const u8 *pixels)
+{
+	u32 handle = 0;
+	glGenTextures(1, &handle);
+	// Texture storage starts out undefined, clear it
+	u8 *blank = NULL;
+	if (!pixels)
+	{
+		blank = calloc((size_t) width*height, 4);
+		assert(blank != NULL);
+		pixels = blank;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, handle);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D,
+		0, GL_RGBA, width, height,
+		0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	free(blank);
+	return handle;
+};
+static void r2d_gl_update_texture(u32 handle, u32 x, u32 y, u32 width, u32 height, const u8 *pixels)
+{
+	glBindTexture(GL_TEXTURE_2D, handle);
+	const size_t size = (size_t) width*height*4;
+	void *staging = NULL;
+	if (size >= R2D_GL_STAGING_MIN_BYTES)
+	{
+		// Copy into the next staging buffer, orphaning its old storage so the map never waits on the GPU
+		// NOTE: The copy to the texture then runs asynchronously, instead of the driver copying the pixels before returning
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_gl_staging.buffers[g_gl_staging.next]);
+		g_gl_staging.next = (g_gl_staging.next + 1) % R2D_GL_STAGING_BUFFERS;
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (staging)
+		{
+			memcpy(staging, pixels, size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		} else {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+	}
+	// With a staging buffer bound the pixel pointer is an offset into it
+	glTexSubImage2D(GL_TEXTURE_2D,
+		0, x, y, width, height,
+		GL_RGBA, GL_UNSIGNED_BYTE, staging ? NULL : pixels);
+	if (staging)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+};
+static void r2d_gl_copy_texture(u32 src_handle, u32 src_x, u32 src_y, u32 dst_handle, u32 dst_x, u32 dst_y, u32 width, u32 height)
+{
+	// NOTE: glCopyImageSubData needs GL 4.3, reading through a framebuffer works on 3.3
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, g_gl_copy_fbo);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src_handle, 0);
+	glBindTexture(GL_TEXTURE_2D, dst_handle);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, dst_x, dst_y, src_x, src_y, width, height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+};
+static void r2d_gl_destroy_texture(u32 handle)
+{
+	glDeleteTextures(1, &handle);
+};
+
+static void r2d_gl_begin_frame(u32 width, u32 height, const r2d_viewport_t *viewport)
+{
+	g_gl_projection = viewport->projection;
+	// Packed positions are in sub-pixel units, fold the scale into the projection
+	if ((g_gl_batch.mode != R2D_BATCH_INSTANCED) && (g_gl_batch.format != R2D_VERTEX_FLOAT))
+	{
+		const f32 scale = 1.f / (f32) R2D_PACKED_POS_SCALE;
+		g_gl_projection = m44_mul(g_gl_projection, m44_scale(scale, scale, 1.f));
+	}
+
+	// Clear the whole screen for the "black bars" effect
+	glDisable(GL_SCISSOR_TEST);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// Set the viewport/scissor region
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(
+		viewport->x, viewport->y,
+		viewport->w, viewport->h);
+	glViewport(
+		viewport->x, viewport->y,
+		viewport->w, viewport->h);
+	// Clear the render area
+	glClearColor(0.2f, 0.2f, 0.2f, 1.f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// Set the drawing settings
+	glDisable(GL_DEPTH_TEST);
+
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_ADD);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+};
+static void* r2d_gl_map_batch()
+{
+	const size_t size = g_gl_batch.batch_size;
+	// Batches never wrap, skip the end of the ring if it's too small
+	const size_t offset = g_gl_batch.head % g_gl_batch.size;
+	if ((offset + size) > g_gl_batch.size)
+		g_gl_batch.head += g_gl_batch.size - offset;
+	// Wait for the GPU to finish with the data being overwritten
+	// NOTE: The ring holds R2D_GL_RING_FRAMES of the largest frame so far, so this was normally written that many frames ago and the fence has long signaled
+	if ((g_gl_batch.head + size) > g_gl_batch.size)
+	{
+		const u64 limit = (g_gl_batch.head + size) - g_gl_batch.size;
+		// A frame bigger than the ring overwrites its own batches, fence them first
+		// NOTE: Only until r2d_gl_end_frame grows the ring, or past R2D_GL_MAX_RING_SIZE
+		if (g_gl_batch.pending < limit)
+			r2d_gl_fence_pending();
+		while (g_gl_batch.fence_count && (g_gl_batch.fences[g_gl_batch.fence_first].start < limit))
+			r2d_gl_wait_fence();
+	}
+	g_gl_batch.batch_start = g_gl_batch.head;
+
+	const size_t start = g_gl_batch.batch_start % g_gl_batch.size;
+	if (g_gl_batch.persistent)
+		return g_gl_batch.persistent + start;
+	// No persistent mapping, map the batch region without synchronizing (the fences already did)
+	glBindBuffer(GL_ARRAY_BUFFER, g_gl_batch.buf);
+	void *mapped = glMapBufferRange(GL_ARRAY_BUFFER, start, size,
+		GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return mapped;
+};
+// Draw ranges of batch elements from a buffer, element 0 starting start bytes into it
+static void r2d_gl_draw_ranges(u32 vao, u32 buf, size_t start, v2 offset, const r2d_batch_range_t *ranges, u32 range_count)
+{
+	const r2d_batch_mode_t mode = g_gl_batch.mode;
+	const size_t element_size = g_gl_batch.element_size;
+	const u32 base = (u32) (start / element_size);
+	// Packed positions are in sub-pixel units, so is the offset
+	if ((mode != R2D_BATCH_INSTANCED) && (g_gl_batch.format != R2D_VERTEX_FLOAT))
+		offset = v2_scale(offset, (f32) R2D_PACKED_POS_SCALE);
+	// Bind the shader
+	glUseProgram(g_draw_shader.program);
+	{
+		// Set the uniforms
+		glProgramUniformMatrix4fv(g_draw_shader.program, g_draw_shader.u_projection,
+			1, false, (const f32*) g_gl_projection.m);
+		glProgramUniform2f(g_draw_shader.program, g_draw_shader.u_offset, offset.x, offset.y);
+		// Bind the vertex array
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, buf);
+		{
+			// For each range
+			for (u32 i = 0; i < range_count; i++)
+			{
+				// Get the range
+				const r2d_batch_range_t *range = ranges + i;
+				// Bind the range texture
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, range->texture_handle);
+				// Issue the range draw call
+				switch (mode)
+				{
+					case R2D_BATCH_INSTANCED:
+					{
+						// No base instance in GL 3.3, point the attributes at the first instance instead
+						r2d_bind_vertex_layout(g_instance_layout, static_len(g_instance_layout), start + range->offset*element_size);
+						// The vertex shader turns gl_VertexID into quad corners
+						glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, range->count);
+					} break;
+					case R2D_BATCH_INDEXED:
+					{
+						// 6 indices per 4 vertex quad, the base vertex moves the quad indices to the range
+						const size_t count = (range->count / 4)*6;
+						glDrawElementsBaseVertex(GL_TRIANGLES, count, GL_UNSIGNED_SHORT, NULL, base + range->offset);
+					} break;
+					default:
+					{
+						glDrawArrays(GL_TRIANGLES, base + range->offset, range->count);
+					} break;
+				}
+			};
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+	glUseProgram(0);
+};
+static void r2d_gl_draw_batch(u32 count, const r2d_batch_range_t *ranges, u32 range_count)
+{
+	const size_t used = count*g_gl_batch.element_size;
+	assert(used <= g_gl_batch.batch_size);
+	// Ring offset of the batch
+	const size_t start = g_gl_batch.batch_start % g_gl_batch.size;
+	// Commit the batch
+	g_gl_batch.head = g_gl_batch.batch_start + used;
+	if (!g_gl_batch.persistent)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, g_gl_batch.buf);
+		glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, used);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	r2d_gl_draw_ranges(g_gl_batch.vao, g_gl_batch.buf, start, V2(0.f, 0.f), ranges, range_count);
+};
+static void r2d_gl_end_frame()
+{
+	// One fence per frame, signaled once the GPU has read the frame's batches
+	r2d_gl_fence_pending();
+	// Grow the ring to hold R2D_GL_RING_FRAMES frames of this size, in whole batches
+	const size_t frame_size = (size_t) (g_gl_batch.head - g_gl_batch.frame_start);
+	const size_t batches = (frame_size + g_gl_batch.batch_size - 1) / g_gl_batch.batch_size;
+	const size_t size = min(batches*g_gl_batch.batch_size*R2D_GL_RING_FRAMES, (size_t) R2D_GL_MAX_RING_SIZE);
+	if (size > g_gl_batch.size)
+	{
+		r2d_gl_free_ring();
+		r2d_gl_alloc_ring(size);
+	}
+	g_gl_batch.frame_start = g_gl_batch.head;
+};
+
+static u32 r2d_gl_create_buffer(size_t size)
+{
+	// Find a free slot
+	u32 index = 0;
+	while ((index < R2D_MAX_STATIC_LAYERS) && g_gl_buffers[index].vao)
+		index ++;
+	if (index == R2D_MAX_STATIC_LAYERS)
+		return 0;
+
+	glGenVertexArrays(1, &g_gl_buffers[index].vao);
+	glGenBuffers(1, &g_gl_buffers[index].buf);
+	glBindVertexArray(g_gl_buffers[index].vao);
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, g_gl_buffers[index].buf);
+		glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
+		r2d_gl_bind_batch_layout();
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return index + 1;
+};
+static void r2d_gl_update_buffer(u32 handle, size_t offset, size_t size, const void *data)
+{
+	assert((handle > 0) && (handle <= R2D_MAX_STATIC_LAYERS));
+	glBindBuffer(GL_ARRAY_BUFFER, g_gl_buffers[handle - 1].buf);
+	glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+};
+static void r2d_gl_destroy_buffer(u32 handle)
+{
+	assert((handle > 0) && (handle <= R2D_MAX_STATIC_LAYERS));
+	glDeleteVertexArrays(1, &g_gl_buffers[handle - 1].vao);
+	glDeleteBuffers(1, &g_gl_buffers[handle - 1].buf);
+	memset(g_gl_buffers + (handle - 1), 0, sizeof(g_gl_buffers[0]));
+};
+static void r2d_gl_draw_buffer(u32 handle, v2 offset, const r2d_batch_range_t *ranges, u32 range_count)
+{
+	assert((handle > 0) && (handle <= R2D_MAX_STATIC_LAYERS));
+	r2d_gl_draw_ranges(g_gl_buffers[handle - 1].vao, g_gl_buffers[handle - 1].buf, 0, offset, ranges, range_count);
+};
+
+const r2d_backend_t g_r2d_gl_backend =
+{
+	.init = r2d_gl_init,
+	.free = r2d_gl_free,
+	.reload_shader = r2d_gl_reload_shader,
+	.create_texture = r2d_gl_create_texture,
+	.reserve_texture = r2d_gl_reserve_texture,
+	.update_texture = r2d_gl_update_texture,
+	.copy_texture = r2d_gl_copy_texture,
+	.destroy_texture = r2d_gl_destroy_texture,
+	.begin_frame = r2d_gl_begin_frame,
+	.map_batch = r2d_gl_map_batch,
+	.draw_batch = r2d_gl_draw_batch,
+	.end_frame = r2d_gl_end_frame,
+	.create_buffer = r2d_gl_create_buffer,
+	.update_buffer = r2d_gl_update_buffer,
+	.destroy_buffer = r2d_gl_destroy_buffer,
+	.draw_buffer = r2d_gl_draw_buffer,
+	.get_framebuffer = NULL,
+};
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "render2d_backend.h"
+
+// Null backend
+// Accepts every call and draws nothing, used to measure the frontend in isolation
+
+static u32 g_null_texture_count;
+static u32 g_null_buffer_count;
+// Host batch memory, the frontend still writes every sprite
+static void *g_null_batch;
+
+static bool r2d_null_init(const r2d_config_t *config)
+{
+	g_null_texture_count = 0;
+	g_null_buffer_count = 0;
+	g_null_batch = malloc(r2d_batch_size(config));
+	return (g_null_batch != NULL);
+};
+static void r2d_null_free()
+{
+	free(g_null_batch);
+	g_null_batch = NULL;
+};
+
+static u32 r2d_null_create_texture(u32 width, u32 height, const u8 *pixels)
+{
+	// Handles only need to be non-zero
+	return ++g_null_texture_count;
+};
+static u32 r2d_null_reserve_texture(u32 width, u32 height)
+{
+	return ++g_null_texture_count;
+};
+static void r2d_null_update_texture(u32 handle, u32 x, u32 y, u32 width, u32 height, const u8 *pixels)
+{
+};
+static void r2d_null_copy_texture(u32 src_handle, u32 src_x, u32 src_y, u32 dst_handle, u32 dst_x, u32 dst_y, u32 width, u32 height)
+{
+};
+static void r2d_null_destroy_texture(u32 handle)
+{
+};
+
+static void r2d_null_begin_frame(u32 width, u32 height, const r2d_viewport_t *viewport)
+{
+};
+static void* r2d_null_map_batch()
+{
+	return g_null_batch;
+};
+static void r2d_null_draw_batch(u32 count, const r2d_batch_range_t *ranges, u32 range_count)
+{
+};
+static void r2d_null_end_frame()
+{
+};
+
+static u32 r2d_null_create_buffer(size_t size)
+{
+	return ++g_null_buffer_count;
+};
+static void r2d_null_update_buffer(u32 handle, size_t offset, size_t size, const void *data)
+{
+};
+static void r2d_null_destroy_buffer(u32 handle)
+{
+};
+static void r2d_null_draw_buffer(u32 handle, v2 offset, const r2d_batch_range_t *ranges, u32 range_count)
+{
+};
+
+const r2d_backend_t g_r2d_null_backend =
+{
+	.init = r2d_null_init,
+	.free = r2d_null_free,
+	.reload_shader = NULL,
+	.create_texture = r2d_null_create_texture,
+	.reserve_texture = r2d_null_reserve_texture,
+	.update_texture = r2d_null_update_texture,
+	.copy_texture = r2d_null_copy_texture,
+	.destroy_texture = r2d_null_destroy_texture,
+	.begin_frame = r2d_null_begin_frame,
+	.map_batch = r2d_null_map_batch,
+	.draw_batch = r2d_null_draw_batch,
+	.end_frame = r2d_null_end_frame,
+	.create_buffer = r2d_null_create_buffer,
+	.update_buffer = r2d_null_update_buffer,
+	.destroy_buffer = r2d_null_destroy_buffer,
+	.draw_buffer = r2d_null_draw_buffer,
+	.get_framebuffer = NULL,
+};
\ No newline at end of file
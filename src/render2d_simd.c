@@ -0,0 +1,105 @@
+#include <immintrin.h>
+
+#include "render2d_simd.h"
+
+// Corners are p - (a + b), p + (a - b), p + (a + b), p - (a - b), where a/b are the
+// rotated half width/height vectors. Summing the axes first keeps every kernel
+// bit-exact with xform2d_apply, which adds the rotated corner offset to the position.
+
+// Portable kernel, for CPUs without SSE2/AVX2 dispatch
+// NOTE: Plain C the compiler is free to vectorize, forcing it scalar made it slower than the xform2d path it replaces
+static void r2d_corners_scalar(r2d_corner_block_t *block, u32 count)
+{
+	for (u32 i = 0; i < count; i++)
+	{
+		const f32 ax = block->half_w[i]*block->rot_x0[i];
+		const f32 ay = block->half_w[i]*block->rot_x1[i];
+		const f32 bx = block->half_h[i]*block->rot_y0[i];
+		const f32 by = block->half_h[i]*block->rot_y1[i];
+		const f32 sx = ax + bx, sy = ay + by;
+		const f32 dx = ax - bx, dy = ay - by;
+
+		block->corner_x[0][i] = block->pos_x[i] - sx;
+		block->corner_y[0][i] = block->pos_y[i] - sy;
+		block->corner_x[1][i] = block->pos_x[i] + dx;
+		block->corner_y[1][i] = block->pos_y[i] + dy;
+		block->corner_x[2][i] = block->pos_x[i] + sx;
+		block->corner_y[2][i] = block->pos_y[i] + sy;
+		block->corner_x[3][i] = block->pos_x[i] - dx;
+		block->corner_y[3][i] = block->pos_y[i] - dy;
+	}
+};
+
+// 4 sprites per iteration
+static void r2d_corners_sse2(r2d_corner_block_t *block, u32 count)
+{
+	for (u32 i = 0; i < count; i += 4)
+	{
+		const __m128 half_w = _mm_loadu_ps(block->half_w + i);
+		const __m128 half_h = _mm_loadu_ps(block->half_h + i);
+		const __m128 ax = _mm_mul_ps(half_w, _mm_loadu_ps(block->rot_x0 + i));
+		const __m128 ay = _mm_mul_ps(half_w, _mm_loadu_ps(block->rot_x1 + i));
+		const __m128 bx = _mm_mul_ps(half_h, _mm_loadu_ps(block->rot_y0 + i));
+		const __m128 by = _mm_mul_ps(half_h, _mm_loadu_ps(block->rot_y1 + i));
+		const __m128 sx = _mm_add_ps(ax, bx), sy = _mm_add_ps(ay, by);
+		const __m128 dx = _mm_sub_ps(ax, bx), dy = _mm_sub_ps(ay, by);
+
+		const __m128 px = _mm_loadu_ps(block->pos_x + i);
+		const __m128 py = _mm_loadu_ps(block->pos_y + i);
+		_mm_storeu_ps(block->corner_x[0] + i, _mm_sub_ps(px, sx));
+		_mm_storeu_ps(block->corner_y[0] + i, _mm_sub_ps(py, sy));
+		_mm_storeu_ps(block->corner_x[1] + i, _mm_add_ps(px, dx));
+		_mm_storeu_ps(block->corner_y[1] + i, _mm_add_ps(py, dy));
+		_mm_storeu_ps(block->corner_x[2] + i, _mm_add_ps(px, sx));
+		_mm_storeu_ps(block->corner_y[2] + i, _mm_add_ps(py, sy));
+		_mm_storeu_ps(block->corner_x[3] + i, _mm_sub_ps(px, dx));
+		_mm_storeu_ps(block->corner_y[3] + i, _mm_sub_ps(py, dy));
+	}
+};
+
+// 8 sprites per iteration, only called when the CPU supports AVX2
+// NOTE: Unaligned loads, 32 byte stack alignment isn't reliable on every target (MinGW)
+__attribute__((target("avx2")))
+static void r2d_corners_avx2(r2d_corner_block_t *block, u32 count)
+{
+	for (u32 i = 0; i < count; i += 8)
+	{
+		const __m256 half_w = _mm256_loadu_ps(block->half_w + i);
+		const __m256 half_h = _mm256_loadu_ps(block->half_h + i);
+		const __m256 ax = _mm256_mul_ps(half_w, _mm256_loadu_ps(block->rot_x0 + i));
+		const __m256 ay = _mm256_mul_ps(half_w, _mm256_loadu_ps(block->rot_x1 + i));
+		const __m256 bx = _mm256_mul_ps(half_h, _mm256_loadu_ps(block->rot_y0 + i));
+		const __m256 by = _mm256_mul_ps(half_h, _mm256_loadu_ps(block->rot_y1 + i));
+		const __m256 sx = _mm256_add_ps(ax, bx), sy = _mm256_add_ps(ay, by);
+		const __m256 dx = _mm256_sub_ps(ax, bx), dy = _mm256_sub_ps(ay, by);
+
+		const __m256 px = _mm256_loadu_ps(block->pos_x + i);
+		const __m256 py = _mm256_loadu_ps(block->pos_y + i);
+		_mm256_storeu_ps(block->corner_x[0] + i, _mm256_sub_ps(px, sx));
+		_mm256_storeu_ps(block->corner_y[0] + i, _mm256_sub_ps(py, sy));
+		_mm256_storeu_ps(block->corner_x[1] + i, _mm256_add_ps(px, dx));
+		_mm256_storeu_ps(block->corner_y[1] + i, _mm256_add_ps(py, dy));
+		_mm256_storeu_ps(block->corner_x[2] + i, _mm256_add_ps(px, sx));
+		_mm256_storeu_ps(block->corner_y[2] + i, _mm256_add_ps(py, sy));
+		_mm256_storeu_ps(block->corner_x[3] + i, _mm256_sub_ps(px, dx));
+		_mm256_storeu_ps(block->corner_y[3] + i, _mm256_sub_ps(py, dy));
+	}
+};
+
+r2d_corner_kernel_t r2d_get_corner_kernel(r2d_simd_t simd, r2d_simd_t *selected)
+{
+	// Check the CPU (CPUID, and OS support for the AVX registers)
+	__builtin_cpu_init();
+	const bool has_avx2 = __builtin_cpu_supports("avx2");
+
+	if ((simd == R2D_SIMD_AUTO) || (simd == R2D_SIMD_AVX2))
+		simd = has_avx2 ? R2D_SIMD_AVX2 : R2D_SIMD_SSE2;
+	if (selected)
+		*selected = simd;
+	switch (simd)
+	{
+		case R2D_SIMD_SCALAR: return r2d_corners_scalar;
+		case R2D_SIMD_AVX2:   return r2d_corners_avx2;
+		default:              return r2d_corners_sse2;
+	}
+};
@@ -0,0 +1,39 @@
+#ifndef RENDER_SIMD_H
+#define RENDER_SIMD_H
+
+#include "render2d.h"
+
+// Structure of arrays sprite corner kernels, the batch builder transforms sprites a block at a time
+
+// Sprites per kernel block
+// NOTE: Multiple of 8, kernels may process the lanes past count
+#define R2D_CORNER_BLOCK	(64)
+
+// NOTE: Aligned for whole cache line loads, kernels still use unaligned loads in case the stack isn't
+typedef struct __attribute__((aligned(64)))
+{
+	// Sprite centers
+	f32 pos_x[R2D_CORNER_BLOCK];
+	f32 pos_y[R2D_CORNER_BLOCK];
+	// Rotation matrices (m22 members)
+	f32 rot_x0[R2D_CORNER_BLOCK];
+	f32 rot_y0[R2D_CORNER_BLOCK];
+	f32 rot_x1[R2D_CORNER_BLOCK];
+	f32 rot_y1[R2D_CORNER_BLOCK];
+	// Half of the sprite width/height
+	f32 half_w[R2D_CORNER_BLOCK];
+	f32 half_h[R2D_CORNER_BLOCK];
+	// Transformed corners, clockwise from the top left
+	f32 corner_x[4][R2D_CORNER_BLOCK];
+	f32 corner_y[4][R2D_CORNER_BLOCK];
+} r2d_corner_block_t;
+
+// Transform the corners of the first count sprites of a block
+// NOTE: Every kernel gives the same results as xform2d_apply, bit for bit
+typedef void (*r2d_corner_kernel_t)(r2d_corner_block_t *block, u32 count);
+
+// Get the kernel for a SIMD level, R2D_SIMD_AUTO picks the widest one the CPU supports
+// NOTE: Falls back to narrower kernels if the level isn't supported, returns the level used in selected
+r2d_corner_kernel_t r2d_get_corner_kernel(r2d_simd_t simd, r2d_simd_t *selected);
+
+#endif
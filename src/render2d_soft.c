@@ -0,0 +1,504 @@
+#include "render2d_backend.h"
+
+// Software backend
+// Rasterizes the vertex batch on the CPU into an RGBA8 framebuffer, mirroring the
+// GL backend's state (scissored viewport, nearest sampling, alpha blending)
+
+// Sub-pixel precision of the rasterizer, in bits
+#define SOFT_SUBPIXEL_BITS	(4)
+#define SOFT_SUBPIXEL_ONE	(1 << SOFT_SUBPIXEL_BITS)
+
+// Packed RGBA8 colors, in memory order
+#define SOFT_RGBA(r,g,b,a)	((u32)(r) | ((u32)(g) << 8) | ((u32)(b) << 16) | ((u32)(a) << 24))
+
+// Software texture
+typedef struct
+{
+	u32 w, h;
+	// RGBA8 pixel data, NULL when the slot is free
+	u32 *pixels;
+} r2d_soft_texture_t;
+
+// Screen space vertex
+typedef struct
+{
+	f32 x, y;	// Pixels, top-down
+	f32 u, v;	// Texels
+	u32 tint;	// RGBA8, flat across the sprite
+} r2d_soft_vertex_t;
+
+static struct
+{
+	// Batch geometry mode and vertex format
+	r2d_batch_mode_t batch_mode;
+	r2d_vertex_format_t vertex_format;
+	size_t element_size;
+	// Host batch memory, written by the frontend
+	void *batch;
+	// Framebuffer
+	u32 width, height;
+	u32 *pixels;
+	// Viewport for the current frame
+	r2d_viewport_t viewport;
+	// Offset added to the positions being drawn
+	v2 offset;
+	// Static layer buffers, indexed by (handle - 1)
+	u8 *buffers[R2D_MAX_STATIC_LAYERS];
+	// Scissor rectangle, top-down pixels (max exclusive)
+	i32 clip_x0, clip_y0, clip_x1, clip_y1;
+	// Texture table, indexed by (handle - 1)
+	u32 texture_count;
+	u32 texture_capacity;
+	r2d_soft_texture_t *textures;
+} g_soft;
+
+static bool r2d_soft_init(const r2d_config_t *config)
+{
+	memset(&g_soft, 0, sizeof(g_soft));
+	g_soft.batch_mode = config->batch_mode;
+	g_soft.vertex_format = config->vertex_format;
+	g_soft.element_size = r2d_batch_element_size(config);
+	g_soft.batch = malloc(r2d_batch_size(config));
+	return (g_soft.batch != NULL);
+};
+static void r2d_soft_free()
+{
+	for (u32 i = 0; i < g_soft.texture_count; i++)
+	{
+		free(g_soft.textures[i].pixels);
+	}
+	free(g_soft.textures);
+	for (u32 i = 0; i < R2D_MAX_STATIC_LAYERS; i++)
+		free(g_soft.buffers[i]);
+	free(g_soft.pixels);
+	free(g_soft.batch);
+	memset(&g_soft, 0, sizeof(g_soft));
+};
+
+static u32 r2d_soft_reserve_texture(u32 width, u32 height)
+{
+	// Find a free slot
+	u32 index = 0;
+	while ((index < g_soft.texture_count) && g_soft.textures[index].pixels)
+		index ++;
+	// None free, grow the table
+	if (index == g_soft.texture_count)
+	{
+		if (g_soft.texture_count == g_soft.texture_capacity)
+		{
+			g_soft.texture_capacity = max(16, g_soft.texture_capacity*2);
+			g_soft.textures = realloc(g_soft.textures, g_soft.texture_capacity*sizeof(r2d_soft_texture_t));
+			assert(g_soft.textures != NULL);
+		}
+		g_soft.texture_count ++;
+	}
+	r2d_soft_texture_t *texture = g_soft.textures + index;
+	texture->w = width;
+	texture->h = height;
+	texture->pixels = malloc(max(1, width*height)*sizeof(u32));
+	assert(texture->pixels != NULL);
+	return index + 1;
+};
+static u32 r2d_soft_create_texture(u32 width, u32 height, const u8 *pixels)
+{
+	const u32 handle = r2d_soft_reserve_texture(width, height);
+	// Copy the pixel data
+	r2d_soft_texture_t *texture = g_soft.textures + (handle - 1);
+	if (pixels)
+		memcpy(texture->pixels, pixels, width*height*sizeof(u32));
+	else
+		memset(texture->pixels, 0, width*height*sizeof(u32));
+	return handle;
+};
+static void r2d_soft_update_texture(u32 handle, u32 x, u32 y, u32 width, u32 height, const u8 *pixels)
+{
+	if ((handle == 0) || (handle > g_soft.texture_count))
+		return;
+	r2d_soft_texture_t *texture = g_soft.textures + (handle - 1);
+	assert(((x + width) <= texture->w) && ((y + height) <= texture->h));
+	// Copy the rectangle row by row
+	for (u32 row = 0; row < height; row++)
+	{
+		memcpy(texture->pixels + (size_t) (y + row)*texture->w + x,
+			pixels + (size_t) row*width*sizeof(u32),
+			width*sizeof(u32));
+	}
+};
+static void r2d_soft_copy_texture(u32 src_handle, u32 src_x, u32 src_y, u32 dst_handle, u32 dst_x, u32 dst_y, u32 width, u32 height)
+{
+	if ((src_handle == 0) || (src_handle > g_soft.texture_count) || (dst_handle == 0) || (dst_handle > g_soft.texture_count))
+		return;
+	const r2d_soft_texture_t *src = g_soft.textures + (src_handle - 1);
+	r2d_soft_texture_t *dst = g_soft.textures + (dst_handle - 1);
+	assert(((src_x + width) <= src->w) && ((src_y + height) <= src->h));
+	assert(((dst_x + width) <= dst->w) && ((dst_y + height) <= dst->h));
+	for (u32 row = 0; row < height; row++)
+	{
+		memcpy(dst->pixels + (size_t) (dst_y + row)*dst->w + dst_x,
+			src->pixels + (size_t) (src_y + row)*src->w + src_x,
+			width*sizeof(u32));
+	}
+};
+static void r2d_soft_destroy_texture(u32 handle)
+{
+	if ((handle > 0) && (handle <= g_soft.texture_count))
+	{
+		r2d_soft_texture_t *texture = g_soft.textures + (handle - 1);
+		free(texture->pixels);
+		memset(texture, 0, sizeof(r2d_soft_texture_t));
+	}
+};
+
+// Fill a rectangle of the framebuffer with a color
+static void r2d_soft_fill(i32 x0, i32 y0, i32 x1, i32 y1, u32 color)
+{
+	for (i32 y = y0; y < y1; y++)
+	{
+		u32 *row = g_soft.pixels + (size_t) y*g_soft.width;
+		for (i32 x = x0; x < x1; x++)
+			row[x] = color;
+	}
+};
+static void r2d_soft_begin_frame(u32 width, u32 height, const r2d_viewport_t *viewport)
+{
+	// Resize the framebuffer if needed
+	if ((width != g_soft.width) || (height != g_soft.height))
+	{
+		free(g_soft.pixels);
+		g_soft.width = width;
+		g_soft.height = height;
+		g_soft.pixels = malloc(max(1, (size_t) width*height)*sizeof(u32));
+		assert(g_soft.pixels != NULL);
+	}
+	g_soft.viewport = *viewport;
+	// Convert the bottom-up GL viewport into a top-down scissor rectangle
+	g_soft.clip_x0 = clamp(viewport->x, 0, (i32) width);
+	g_soft.clip_x1 = clamp(viewport->x + viewport->w, 0, (i32) width);
+	g_soft.clip_y0 = clamp((i32) height - (viewport->y + viewport->h), 0, (i32) height);
+	g_soft.clip_y1 = clamp((i32) height - viewport->y, 0, (i32) height);
+
+	// Clear the whole screen for the "black bars" effect
+	r2d_soft_fill(0, 0, width, height, SOFT_RGBA(0, 0, 0, 255));
+	// Clear the render area
+	r2d_soft_fill(
+		g_soft.clip_x0, g_soft.clip_y0,
+		g_soft.clip_x1, g_soft.clip_y1,
+		SOFT_RGBA(51, 51, 51, 255));
+};
+
+// Transform a batch vertex into screen space
+static inline r2d_soft_vertex_t r2d_soft_transform(const r2d_vertex_t *vertex, u32 tint, const r2d_soft_texture_t *texture)
+{
+	const r2d_viewport_t *viewport = &g_soft.viewport;
+	const m44 *p = &viewport->projection;
+	const f32 x = vertex->pos.x + g_soft.offset.x;
+	const f32 y = vertex->pos.y + g_soft.offset.y;
+	// Clip space (column major, z = 0, w = 1)
+	const f32 cx = p->m[0][0]*x + p->m[1][0]*y + p->m[3][0];
+	const f32 cy = p->m[0][1]*x + p->m[1][1]*y + p->m[3][1];
+	const f32 cw = p->m[0][3]*x + p->m[1][3]*y + p->m[3][3];
+	// Window space, GL is bottom-up so flip into framebuffer rows
+	const f32 wx = viewport->x + (cx/cw + 1.f)*0.5f*viewport->w;
+	const f32 wy = viewport->y + (cy/cw + 1.f)*0.5f*viewport->h;
+
+	r2d_soft_vertex_t out;
+	out.x = wx;
+	out.y = (f32) g_soft.height - wy;
+	out.u = vertex->uv.x * (f32) texture->w;
+	out.v = vertex->uv.y * (f32) texture->h;
+	out.tint = tint;
+	return out;
+};
+// Decode vertex i of the batch in the configured vertex format, and transform it into screen space
+static inline r2d_soft_vertex_t r2d_soft_fetch(const void *data, u32 i, const r2d_soft_texture_t *texture)
+{
+	const u8 *element = (const u8*) data + (size_t) i*g_soft.element_size;
+	if (g_soft.vertex_format == R2D_VERTEX_FLOAT)
+		return r2d_soft_transform((const r2d_vertex_t*) element, R2D_WHITE, texture);
+
+	// Tinted vertices start like packed ones
+	const r2d_packed_vertex_t *packed = (const r2d_packed_vertex_t*) element;
+	const f32 pos_scale = 1.f / (f32) R2D_PACKED_POS_SCALE;
+	const f32 uv_scale = 1.f / (f32) U16_MAX;
+	r2d_vertex_t vertex;
+	vertex.pos = V2(packed->pos[0]*pos_scale, packed->pos[1]*pos_scale);
+	vertex.uv = V2(packed->uv[0]*uv_scale, packed->uv[1]*uv_scale);
+	const u32 tint = (g_soft.vertex_format == R2D_VERTEX_PACKED_TINT) ? ((const r2d_tinted_vertex_t*) element)->tint : R2D_WHITE;
+	return r2d_soft_transform(&vertex, tint, texture);
+};
+
+// Is the edge a->b a top or left edge (see the D3D/GL fill conventions)
+static inline bool r2d_soft_top_left(i32 ax, i32 ay, i32 bx, i32 by)
+{
+	const i32 dx = bx - ax;
+	const i32 dy = by - ay;
+	return (dy < 0) || ((dy == 0) && (dx > 0));
+};
+// Blend a source texel over a destination pixel with (SRC_ALPHA, ONE_MINUS_SRC_ALPHA)
+static inline u32 r2d_soft_blend(u32 src, u32 dst)
+{
+	const u32 a = (src >> 24);
+	if (a == 255) return src;
+	if (a == 0) return dst;
+
+	const u32 ia = 255 - a;
+	u32 out = 0;
+	for (u32 shift = 0; shift < 32; shift += 8)
+	{
+		const u32 s = (src >> shift) & 0xFF;
+		const u32 d = (dst >> shift) & 0xFF;
+		const u32 f = (shift == 24) ? s : a;
+		out |= (((s*f + d*ia + 127) / 255) & 0xFF) << shift;
+	}
+	return out;
+};
+// Multiply a texel by an RGBA8 tint, like the fragment shader
+static inline u32 r2d_soft_modulate(u32 texel, u32 tint)
+{
+	u32 out = 0;
+	for (u32 shift = 0; shift < 32; shift += 8)
+	{
+		const u32 t = (texel >> shift) & 0xFF;
+		const u32 c = (tint >> shift) & 0xFF;
+		out |= ((t*c + 127) / 255) << shift;
+	}
+	return out;
+};
+static void r2d_soft_draw_triangle(const r2d_soft_texture_t *texture,
+	r2d_soft_vertex_t v0, r2d_soft_vertex_t v1, r2d_soft_vertex_t v2)
+{
+	// Snap to the sub-pixel grid
+	i32 x0 = (i32) lrintf(v0.x * SOFT_SUBPIXEL_ONE), y0 = (i32) lrintf(v0.y * SOFT_SUBPIXEL_ONE);
+	i32 x1 = (i32) lrintf(v1.x * SOFT_SUBPIXEL_ONE), y1 = (i32) lrintf(v1.y * SOFT_SUBPIXEL_ONE);
+	i32 x2 = (i32) lrintf(v2.x * SOFT_SUBPIXEL_ONE), y2 = (i32) lrintf(v2.y * SOFT_SUBPIXEL_ONE);
+
+	i64 area = (i64) (x1 - x0)*(y2 - y0) - (i64) (y1 - y0)*(x2 - x0);
+	if (area == 0)
+		return;
+	// Keep a consistent winding
+	if (area < 0)
+	{
+		swap(r2d_soft_vertex_t, v1, v2);
+		swap(i32, x1, x2);
+		swap(i32, y1, y2);
+		area = -area;
+	}
+
+	// Bounding box, clipped to the scissor rectangle
+	i32 min_x = (min(x0, min(x1, x2)) >> SOFT_SUBPIXEL_BITS);
+	i32 min_y = (min(y0, min(y1, y2)) >> SOFT_SUBPIXEL_BITS);
+	i32 max_x = (max(x0, max(x1, x2)) >> SOFT_SUBPIXEL_BITS) + 1;
+	i32 max_y = (max(y0, max(y1, y2)) >> SOFT_SUBPIXEL_BITS) + 1;
+	min_x = max(min_x, g_soft.clip_x0);
+	min_y = max(min_y, g_soft.clip_y0);
+	max_x = min(max_x, g_soft.clip_x1);
+	max_y = min(max_y, g_soft.clip_y1);
+	if ((min_x >= max_x) || (min_y >= max_y))
+		return;
+
+	// Edge function biases for the top-left fill rule
+	const i64 bias0 = r2d_soft_top_left(x1, y1, x2, y2) ? 0 : -1;
+	const i64 bias1 = r2d_soft_top_left(x2, y2, x0, y0) ? 0 : -1;
+	const i64 bias2 = r2d_soft_top_left(x0, y0, x1, y1) ? 0 : -1;
+	// Edge function steps, per pixel
+	const i64 e0_dx = (i64) (y1 - y2) * SOFT_SUBPIXEL_ONE, e0_dy = (i64) (x2 - x1) * SOFT_SUBPIXEL_ONE;
+	const i64 e1_dx = (i64) (y2 - y0) * SOFT_SUBPIXEL_ONE, e1_dy = (i64) (x0 - x2) * SOFT_SUBPIXEL_ONE;
+	const i64 e2_dx = (i64) (y0 - y1) * SOFT_SUBPIXEL_ONE, e2_dy = (i64) (x1 - x0) * SOFT_SUBPIXEL_ONE;
+	// Edge functions at the first pixel center
+	const i32 px = (min_x << SOFT_SUBPIXEL_BITS) + (SOFT_SUBPIXEL_ONE >> 1);
+	const i32 py = (min_y << SOFT_SUBPIXEL_BITS) + (SOFT_SUBPIXEL_ONE >> 1);
+	i64 e0_row = (i64) (x2 - x1)*(py - y1) - (i64) (y2 - y1)*(px - x1) + bias0;
+	i64 e1_row = (i64) (x0 - x2)*(py - y2) - (i64) (y0 - y2)*(px - x2) + bias1;
+	i64 e2_row = (i64) (x1 - x0)*(py - y0) - (i64) (y1 - y0)*(px - x0) + bias2;
+
+	// Texture coordinate planes, in texels per pixel
+	const f32 inv_area = (f32) (SOFT_SUBPIXEL_ONE*SOFT_SUBPIXEL_ONE) / (f32) area;
+	const f32 fx0 = x0 / (f32) SOFT_SUBPIXEL_ONE, fy0 = y0 / (f32) SOFT_SUBPIXEL_ONE;
+	const f32 fx1 = x1 / (f32) SOFT_SUBPIXEL_ONE, fy1 = y1 / (f32) SOFT_SUBPIXEL_ONE;
+	const f32 fx2 = x2 / (f32) SOFT_SUBPIXEL_ONE, fy2 = y2 / (f32) SOFT_SUBPIXEL_ONE;
+	const f32 du_dx = ((v1.u - v0.u)*(fy2 - fy0) - (v2.u - v0.u)*(fy1 - fy0)) * inv_area;
+	const f32 du_dy = ((v2.u - v0.u)*(fx1 - fx0) - (v1.u - v0.u)*(fx2 - fx0)) * inv_area;
+	const f32 dv_dx = ((v1.v - v0.v)*(fy2 - fy0) - (v2.v - v0.v)*(fy1 - fy0)) * inv_area;
+	const f32 dv_dy = ((v2.v - v0.v)*(fx1 - fx0) - (v1.v - v0.v)*(fx2 - fx0)) * inv_area;
+	const f32 cx = min_x + 0.5f - fx0;
+	const f32 cy = min_y + 0.5f - fy0;
+	f32 u_row = v0.u + du_dx*cx + du_dy*cy;
+	f32 v_row = v0.v + dv_dx*cx + dv_dy*cy;
+
+	const i32 tex_w = (i32) texture->w;
+	const i32 tex_h = (i32) texture->h;
+	// Tints are per sprite, so the first vertex has it
+	const u32 tint = v0.tint;
+	for (i32 y = min_y; y < max_y; y++)
+	{
+		u32 *row = g_soft.pixels + (size_t) y*g_soft.width;
+
+		i64 e0 = e0_row, e1 = e1_row, e2 = e2_row;
+		f32 u = u_row, v = v_row;
+		for (i32 x = min_x; x < max_x; x++)
+		{
+			if ((e0 | e1 | e2) >= 0)
+			{
+				// Nearest sampling, clamped to the texture edges
+				const i32 tx = clamp((i32) floorf(u), 0, tex_w - 1);
+				const i32 ty = clamp((i32) floorf(v), 0, tex_h - 1);
+				u32 texel = texture->pixels[ty*tex_w + tx];
+				if (tint != R2D_WHITE)
+					texel = r2d_soft_modulate(texel, tint);
+				row[x] = r2d_soft_blend(texel, row[x]);
+			}
+			e0 += e0_dx; e1 += e1_dx; e2 += e2_dx;
+			u += du_dx; v += dv_dx;
+		}
+		e0_row += e0_dy; e1_row += e1_dy; e2_row += e2_dy;
+		u_row += du_dy; v_row += dv_dy;
+	}
+};
+
+// Draw a quad of 4 screen space corners (clockwise from the top left) as two triangles
+static void r2d_soft_draw_quad(const r2d_soft_texture_t *texture, const r2d_soft_vertex_t *quad)
+{
+	const u16 indices[] = R2D_QUAD_INDICES;
+	r2d_soft_draw_triangle(texture, quad[indices[0]], quad[indices[1]], quad[indices[2]]);
+	r2d_soft_draw_triangle(texture, quad[indices[3]], quad[indices[4]], quad[indices[5]]);
+};
+// Expand an instance record into its corners, like the instanced vertex shader
+static void r2d_soft_expand_instance(const r2d_instance_t *instance, r2d_vertex_t *corners)
+{
+	const v2 offsets[] = { {0.f, 0.f}, {1.f, 0.f}, {1.f, 1.f}, {0.f, 1.f} };
+	const f32 uv_scale = 1.f / (f32) U16_MAX;
+	for (u32 k = 0; k < 4; k++)
+	{
+		const v2 c = offsets[k];
+		corners[k].pos = v2_add(instance->pos, v2_add(
+			v2_scale(instance->axis_x, c.x - 0.5f),
+			v2_scale(instance->axis_y, c.y - 0.5f)));
+		corners[k].uv.x = (instance->uv[0] + (instance->uv[2] - instance->uv[0])*c.x) * uv_scale;
+		corners[k].uv.y = (instance->uv[1] + (instance->uv[3] - instance->uv[1])*c.y) * uv_scale;
+	}
+};
+static void* r2d_soft_map_batch()
+{
+	return g_soft.batch;
+};
+// Draw ranges of batch elements, count is the number of elements in data
+static void r2d_soft_draw_ranges(const void *data, u32 count, const r2d_batch_range_t *ranges, u32 range_count)
+{
+	for (u32 i = 0; i < range_count; i++)
+	{
+		const r2d_batch_range_t *range = ranges + i;
+		const u32 handle = range->texture_handle;
+		if ((handle == 0) || (handle > g_soft.texture_count))
+			continue;
+		const r2d_soft_texture_t *texture = g_soft.textures + (handle - 1);
+		if (!texture->pixels)
+			continue;
+
+		assert((range->offset + range->count) <= count);
+		switch (g_soft.batch_mode)
+		{
+			case R2D_BATCH_INSTANCED:
+			{
+				// Expand each instance into a quad
+				const r2d_instance_t *instances = (const r2d_instance_t*) data + range->offset;
+				for (u32 j = 0; j < range->count; j++)
+				{
+					r2d_vertex_t corners[4];
+					r2d_soft_expand_instance(instances + j, corners);
+					r2d_soft_vertex_t quad[4];
+					for (u32 k = 0; k < 4; k++)
+						quad[k] = r2d_soft_transform(corners + k, R2D_WHITE, texture);
+					r2d_soft_draw_quad(texture, quad);
+				}
+			} break;
+			case R2D_BATCH_INDEXED:
+			{
+				// Draw each quad in the range as two triangles
+				const u32 first = range->offset;
+				for (u32 j = 0; (j + 3) < range->count; j += 4)
+				{
+					r2d_soft_vertex_t quad[4];
+					for (u32 k = 0; k < 4; k++)
+						quad[k] = r2d_soft_fetch(data, first + j + k, texture);
+					r2d_soft_draw_quad(texture, quad);
+				}
+			} break;
+			default:
+			{
+				// Draw each triangle in the range
+				const u32 first = range->offset;
+				for (u32 j = 0; (j + 2) < range->count; j += 3)
+				{
+					r2d_soft_draw_triangle(texture,
+						r2d_soft_fetch(data, first + j + 0, texture),
+						r2d_soft_fetch(data, first + j + 1, texture),
+						r2d_soft_fetch(data, first + j + 2, texture));
+				}
+			} break;
+		}
+	}
+};
+static void r2d_soft_draw_batch(u32 count, const r2d_batch_range_t *ranges, u32 range_count)
+{
+	g_soft.offset = V2(0.f, 0.f);
+	r2d_soft_draw_ranges(g_soft.batch, count, ranges, range_count);
+};
+static void r2d_soft_end_frame()
+{
+};
+
+static u32 r2d_soft_create_buffer(size_t size)
+{
+	// Find a free slot
+	u32 index = 0;
+	while ((index < R2D_MAX_STATIC_LAYERS) && g_soft.buffers[index])
+		index ++;
+	if (index == R2D_MAX_STATIC_LAYERS)
+		return 0;
+	g_soft.buffers[index] = calloc(max(size, 1), 1);
+	return g_soft.buffers[index] ? (index + 1) : 0;
+};
+static void r2d_soft_update_buffer(u32 handle, size_t offset, size_t size, const void *data)
+{
+	assert((handle > 0) && (handle <= R2D_MAX_STATIC_LAYERS));
+	memcpy(g_soft.buffers[handle - 1] + offset, data, size);
+};
+static void r2d_soft_destroy_buffer(u32 handle)
+{
+	assert((handle > 0) && (handle <= R2D_MAX_STATIC_LAYERS));
+	free(g_soft.buffers[handle - 1]);
+	g_soft.buffers[handle - 1] = NULL;
+};
+static void r2d_soft_draw_buffer(u32 handle, v2 offset, const r2d_batch_range_t *ranges, u32 range_count)
+{
+	assert((handle > 0) && (handle <= R2D_MAX_STATIC_LAYERS));
+	g_soft.offset = offset;
+	r2d_soft_draw_ranges(g_soft.buffers[handle - 1], U32_MAX, ranges, range_count);
+};
+static const u8* r2d_soft_get_framebuffer(u32 *width, u32 *height)
+{
+	if (width) *width = g_soft.width;
+	if (height) *height = g_soft.height;
+	return (const u8*) g_soft.pixels;
+};
+
+const r2d_backend_t g_r2d_soft_backend =
+{
+	.init = r2d_soft_init,
+	.free = r2d_soft_free,
+	.reload_shader = NULL,
+	.create_texture = r2d_soft_create_texture,
+	.reserve_texture = r2d_soft_reserve_texture,
+	.update_texture = r2d_soft_update_texture,
+	.copy_texture = r2d_soft_copy_texture,
+	.destroy_texture = r2d_soft_destroy_texture,
+	.begin_frame = r2d_soft_begin_frame,
+	.map_batch = r2d_soft_map_batch,
+	.draw_batch = r2d_soft_draw_batch,
+	.end_frame = r2d_soft_end_frame,
+	.create_buffer = r2d_soft_create_buffer,
+	.update_buffer = r2d_soft_update_buffer,
+	.destroy_buffer = r2d_soft_destroy_buffer,
+	.draw_buffer = r2d_soft_draw_buffer,
+	.get_framebuffer = r2d_soft_get_framebuffer,
+};
\ No newline at end of file
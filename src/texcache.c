@@ -0,0 +1,334 @@
+// For the nanosecond modification times of stat
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#define texcache_mkdir(path)	_mkdir(path)
+#define texcache_getpid()		_getpid()
+#else
+#include <unistd.h>
+#define texcache_mkdir(path)	mkdir(path, 0755)
+#define texcache_getpid()		getpid()
+#endif
+
+#include "texcache.h"
+
+// Max length of a cache file path
+#define TEXCACHE_PATH_LEN	(1024)
+
+// LZ compression, a byte oriented LZ77 in the style of the LZ4 block format
+// Sequences are a token (literal count in the high nibble, match length - LZ_MIN_MATCH in the low one),
+// the literals, then a 2 byte match offset; nibbles of 15 are extended by bytes until one isn't 255
+// NOTE: The last sequence is literals only, and ends the block
+#define LZ_MIN_MATCH	(4)
+#define LZ_MAX_OFFSET	(0xFFFF)
+#define LZ_HASH_BITS	(14)
+// Positions remembered per hash, the longest match among them is taken
+#define LZ_HASH_WAYS	(8)
+// Short copies are done as whole chunks, overrunning into bytes that are written later
+#define LZ_COPY_CHUNK	(16)
+
+// Helper, write a length extension
+static inline bool lz_write_length(u8 *dst, size_t capacity, size_t *out, size_t length)
+{
+	for (; length >= 255; length -= 255)
+	{
+		if (*out >= capacity)
+			return false;
+		dst[(*out)++] = 255;
+	}
+	if (*out >= capacity)
+		return false;
+	dst[(*out)++] = (u8) length;
+	return true;
+};
+// Helper, write a sequence, a match length of zero writes the literals only
+static bool lz_write_sequence(u8 *dst, size_t capacity, size_t *out, const u8 *literals, size_t literal_count, size_t offset, size_t length)
+{
+	if (*out >= capacity)
+		return false;
+	const size_t match = length ? length - LZ_MIN_MATCH : 0;
+	u8 *token = dst + (*out)++;
+	*token = (u8) ((min(literal_count, 15) << 4) | min(match, 15));
+	if ((literal_count >= 15) && !lz_write_length(dst, capacity, out, literal_count - 15))
+		return false;
+	if (literal_count > capacity - *out)
+		return false;
+	memcpy(dst + *out, literals, literal_count);
+	*out += literal_count;
+	if (!length)
+		return true;
+	if (2 > capacity - *out)
+		return false;
+	dst[(*out)++] = (u8) offset;
+	dst[(*out)++] = (u8) (offset >> 8);
+	return (match < 15) || lz_write_length(dst, capacity, out, match - 15);
+};
+// Compress a block, returns the compressed size or 0 if it doesn't fit in capacity
+static size_t lz_compress(const u8 *src, size_t size, u8 *dst, size_t capacity)
+{
+	// Last positions each 4 byte sequence was seen at, most recent first
+	// NOTE: Compression runs once per image, so it trades speed for longer matches (fewer sequences to decode)
+	u32 *table = calloc((1 << LZ_HASH_BITS)*LZ_HASH_WAYS, sizeof(u32));
+	if (!table)
+		return 0;
+	size_t out = 0, anchor = 0, pos = 0;
+	bool result = true;
+	while (result && (pos + LZ_MIN_MATCH <= size))
+	{
+		u32 sequence;
+		memcpy(&sequence, src + pos, sizeof(sequence));
+		const u32 hash = (sequence*2654435761u) >> (32 - LZ_HASH_BITS);
+		u32 *ways = table + hash*LZ_HASH_WAYS;
+		size_t length = 0, offset = 0;
+		for (u32 i = 0; i < LZ_HASH_WAYS; i++)
+		{
+			const size_t candidate = ways[i];
+			if ((candidate >= pos) || (pos - candidate > LZ_MAX_OFFSET))
+				break;
+			size_t candidate_length = 0;
+			while ((pos + candidate_length < size) && (src[candidate + candidate_length] == src[pos + candidate_length]))
+				candidate_length ++;
+			if (candidate_length > length)
+			{
+				length = candidate_length;
+				offset = pos - candidate;
+			}
+		}
+		memmove(ways + 1, ways, (LZ_HASH_WAYS - 1)*sizeof(u32));
+		ways[0] = (u32) pos;
+		if (length >= LZ_MIN_MATCH)
+		{
+			result = lz_write_sequence(dst, capacity, &out, src + anchor, pos - anchor, offset, length);
+			pos += length;
+			anchor = pos;
+		} else {
+			pos ++;
+		}
+	}
+	// Trailing literals
+	result = result && lz_write_sequence(dst, capacity, &out, src + anchor, size - anchor, 0, 0);
+	free(table);
+	return result ? out : 0;
+};
+// Helper, read a length extension
+static inline bool lz_read_length(const u8 *src, size_t size, size_t *in, size_t *length)
+{
+	u8 byte;
+	do
+	{
+		if (*in >= size)
+			return false;
+		byte = src[(*in)++];
+		*length += byte;
+	} while (byte == 255);
+	return true;
+};
+// Decompress a block into exactly dst_size bytes, false if the block is corrupt
+static bool lz_decompress(const u8 *src, size_t size, u8 *dst, size_t dst_size)
+{
+	size_t in = 0, out = 0;
+	while (in < size)
+	{
+		const u8 token = src[in++];
+		// Literals
+		size_t literal_count = token >> 4;
+		if ((literal_count == 15) && !lz_read_length(src, size, &in, &literal_count))
+			return false;
+		if ((literal_count > size - in) || (literal_count > dst_size - out))
+			return false;
+		if ((literal_count <= LZ_COPY_CHUNK) && (size - in >= LZ_COPY_CHUNK) && (dst_size - out >= LZ_COPY_CHUNK))
+			memcpy(dst + out, src + in, LZ_COPY_CHUNK);
+		else
+			memcpy(dst + out, src + in, literal_count);
+		in += literal_count;
+		out += literal_count;
+		if (in == size)
+			break;
+		// Match
+		if (2 > size - in)
+			return false;
+		const size_t offset = src[in] | ((size_t) src[in + 1] << 8);
+		in += 2;
+		size_t length = token & 15;
+		if ((length == 15) && !lz_read_length(src, size, &in, &length))
+			return false;
+		length += LZ_MIN_MATCH;
+		if ((offset == 0) || (offset > out) || (length > dst_size - out))
+			return false;
+		// Matches can overlap the bytes they write (runs of a repeated pixel), those repeat every offset bytes
+		// NOTE: Each copy doubles the repeated span, so runs take a few memcpys instead of a byte loop
+		const u8 *match = dst + out - offset;
+		if ((offset >= LZ_COPY_CHUNK) && (dst_size - out - length >= LZ_COPY_CHUNK))
+		{
+			for (size_t copied = 0; copied < length; copied += LZ_COPY_CHUNK)
+				memcpy(dst + out + copied, match + copied, LZ_COPY_CHUNK);
+			out += length;
+			continue;
+		}
+		for (size_t copied = 0; copied < length;)
+		{
+			const size_t count = min(offset + copied, length - copied);
+			memcpy(dst + out + copied, match, count);
+			copied += count;
+		}
+		out += length;
+	}
+	return (out == dst_size);
+};
+
+// Helper, 64 bit FNV-1a hash of a block of memory
+static u64 texcache_hash(const void *data, size_t size)
+{
+	const u8 *bytes = (const u8*) data;
+	u64 hash = 0xcbf29ce484222325;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+};
+// Helper, path of the cache file of a name hash
+static bool texcache_hash_path(const char *cache_dir, u64 name_hash, char *path, size_t path_len)
+{
+	const int length = snprintf(path, path_len, "%s/%016llx.tex", cache_dir, (unsigned long long) name_hash);
+	return (length > 0) && ((size_t) length < path_len);
+};
+
+bool texcache_path(const char *cache_dir, const char *file_name, char *path, size_t path_len)
+{
+	return texcache_hash_path(cache_dir, texcache_hash(file_name, strlen(file_name)), path, path_len);
+};
+
+bool texcache_source_file(const char *file_name, texcache_source_t *source)
+{
+	// NOTE: Whole seconds would miss an edit of the same size saved within a second of the last, as when hot reloading
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(file_name, GetFileExInfoStandard, &data))
+		return false;
+	source->size = ((u64) data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	// In 100 ns units
+	source->stamp = ((u64) data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st;
+	if (stat(file_name, &st) != 0)
+		return false;
+	source->size = (u64) st.st_size;
+#ifdef __APPLE__
+	source->stamp = (u64) st.st_mtimespec.tv_sec*1000000000ull + (u64) st.st_mtimespec.tv_nsec;
+#else
+	source->stamp = (u64) st.st_mtim.tv_sec*1000000000ull + (u64) st.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+};
+texcache_source_t texcache_source_memory(const void *data, size_t size)
+{
+	texcache_source_t source;
+	source.size = size;
+	source.stamp = texcache_hash(data, size);
+	return source;
+};
+
+u8* texcache_load(const char *cache_dir, const char *file_name, const texcache_source_t *source, u32 *width, u32 *height)
+{
+	const u64 name_hash = texcache_hash(file_name, strlen(file_name));
+	char path[TEXCACHE_PATH_LEN];
+	if (!texcache_hash_path(cache_dir, name_hash, path, sizeof(path)))
+		return NULL;
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+
+	// Check the entry is for this image, and still up to date
+	u8 *pixels = NULL;
+	texcache_header_t header;
+	if ((fread(&header, sizeof(header), 1, f) == 1) &&
+		(header.magic == TEXCACHE_MAGIC) && (header.version == TEXCACHE_VERSION) &&
+		(header.name_hash == name_hash) && (header.source_size == source->size) && (header.source_stamp == source->stamp) &&
+		(header.width > 0) && (header.height > 0) && ((u64) header.width*header.height <= U32_MAX / 4))
+	{
+		const size_t pixels_size = (size_t) header.width*header.height*4;
+		pixels = malloc(pixels_size);
+		bool valid = (pixels != NULL);
+		if (valid && (header.flags & TEXCACHE_COMPRESSED))
+		{
+			u8 *data = malloc(header.data_size);
+			valid = data && (fread(data, 1, header.data_size, f) == header.data_size) &&
+				lz_decompress(data, header.data_size, pixels, pixels_size);
+			free(data);
+		} else if (valid) {
+			// Raw pixels are read straight into place
+			valid = (header.data_size == pixels_size) && (fread(pixels, 1, pixels_size, f) == pixels_size);
+		}
+		if (valid)
+		{
+			*width = header.width;
+			*height = header.height;
+		} else {
+			free(pixels);
+			pixels = NULL;
+		}
+	}
+	fclose(f);
+	return pixels;
+};
+
+bool texcache_store(const char *cache_dir, const char *file_name, const texcache_source_t *source, const u8 *pixels, u32 width, u32 height)
+{
+	static volatile u32 g_temp_counter;
+	const u64 name_hash = texcache_hash(file_name, strlen(file_name));
+	char path[TEXCACHE_PATH_LEN], temp_path[TEXCACHE_PATH_LEN];
+	if (!texcache_hash_path(cache_dir, name_hash, path, sizeof(path)))
+		return false;
+	// Unique per process and per store, so concurrent stores don't share a temporary file
+	const int length = snprintf(temp_path, sizeof(temp_path), "%s.%d.%u.tmp", path, (int) texcache_getpid(), u32_atomic_inc(&g_temp_counter));
+	if ((length <= 0) || (length >= (int) sizeof(temp_path)))
+		return false;
+
+	// Compress the pixels, unless it saves less than an eighth
+	const size_t pixels_size = (size_t) width*height*4;
+	const size_t capacity = pixels_size - pixels_size / 8;
+	u8 *compressed = malloc(max(capacity, 1));
+	const size_t compressed_size = compressed ? lz_compress(pixels, pixels_size, compressed, capacity) : 0;
+
+	texcache_header_t header;
+	memset(&header, 0, sizeof(header));
+	header.magic = TEXCACHE_MAGIC;
+	header.version = TEXCACHE_VERSION;
+	header.width = width;
+	header.height = height;
+	header.flags = compressed_size ? TEXCACHE_COMPRESSED : 0;
+	header.data_size = (u32) (compressed_size ? compressed_size : pixels_size);
+	header.name_hash = name_hash;
+	header.source_size = source->size;
+	header.source_stamp = source->stamp;
+
+	texcache_mkdir(cache_dir);
+	FILE *f = fopen(temp_path, "wb");
+	bool result = (f != NULL);
+	if (f)
+	{
+		result = (fwrite(&header, sizeof(header), 1, f) == 1) &&
+			(fwrite(compressed_size ? compressed : pixels, 1, header.data_size, f) == header.data_size);
+		result &= (fclose(f) == 0);
+		if (result)
+		{
+#ifdef _WIN32
+			// NOTE: rename doesn't replace an existing file on Windows
+			remove(path);
+#endif
+			result = (rename(temp_path, path) == 0);
+		}
+		if (!result)
+			remove(temp_path);
+	}
+	free(compressed);
+	return result;
+};
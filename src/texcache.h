@@ -0,0 +1,57 @@
+#ifndef TEXCACHE_H
+#define TEXCACHE_H
+
+#include "core.h"
+
+// Pre-decoded texture cache, images stored as the RGBA pixels r2d_alloc_texture takes so loads skip PNG decoding
+//
+// Each image gets one file in the cache directory, named after the hash of the image name:
+//   texcache_header_t
+//   Pixel data, width*height*4 bytes of RGBA, or LZ compressed if that saves space
+// The header records the source the pixels were decoded from, an entry whose source has changed is a miss
+
+#define TEXCACHE_MAGIC		(0x58455432)	// "2TEX"
+#define TEXCACHE_VERSION	(1)
+
+// Header flags
+#define TEXCACHE_COMPRESSED	(1 << 0)
+
+typedef struct
+{
+	u32 magic;
+	u32 version;
+	u32 width, height;
+	u32 flags;
+	// Size of the pixel data that follows
+	u32 data_size;
+	// Hash of the image name, files named after colliding hashes are detected
+	u64 name_hash;
+	// Source the pixels were decoded from
+	u64 source_size;
+	u64 source_stamp;
+} texcache_header_t;
+
+// Source of an image, the cache entry is stale once either changes
+typedef struct
+{
+	u64 size;
+	// Modification time of a loose file (in nanoseconds, 100 ns units on Windows), or a hash of the contents of an archived one
+	u64 stamp;
+} texcache_source_t;
+
+// Describe a loose file, false if it doesn't exist
+bool texcache_source_file(const char *file_name, texcache_source_t *source);
+// Describe a file held in memory (e.g. in an archive), hashing its contents
+texcache_source_t texcache_source_memory(const void *data, size_t size);
+
+// Path of the cache file of an image, false if it doesn't fit in path_len
+bool texcache_path(const char *cache_dir, const char *file_name, char *path, size_t path_len);
+
+// Load the cached pixels of an image, NULL on a miss or a stale entry
+// NOTE: The pixels are allocated with malloc, free them with free
+u8*  texcache_load(const char *cache_dir, const char *file_name, const texcache_source_t *source, u32 *width, u32 *height);
+// Store the pixels of an image, creating the cache directory if needed
+// NOTE: Written to a temporary file first, so readers never see a partial entry
+bool texcache_store(const char *cache_dir, const char *file_name, const texcache_source_t *source, const u8 *pixels, u32 width, u32 height);
+
+#endif
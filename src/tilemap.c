@@ -0,0 +1,267 @@
+#include "tilemap.h"
+
+// Chunk state
+typedef struct
+{
+	// Cache slot holding the chunk's static layer, TILEMAP_NO_SLOT if not baked
+	u32 slot;
+} tilemap_chunk_t;
+
+#define TILEMAP_NO_SLOT		(0xFFFFFFFF)
+
+// Baked chunk cache entry
+typedef struct
+{
+	r2d_static_layer_t *layer;
+	// Chunk baked into the layer, TILEMAP_NO_SLOT if free
+	u32 chunk;
+	// Frame the chunk was last drawn
+	u32 frame;
+} tilemap_slot_t;
+
+struct tilemap_t
+{
+	// Size in tiles, and in chunks
+	u32 width, height;
+	u32 chunks_x, chunks_y;
+	u32 layer_count;
+	// Tiles, layer by layer in rows
+	u16 *tiles;
+	// Tile set
+	r2d_texture_t *texture;
+	u32 rect_count;
+	aabb_t *rects;
+	f32 tile_size;
+	// Chunks, in rows
+	tilemap_chunk_t *chunks;
+	// Baked chunk cache
+	tilemap_slot_t slots[TILEMAP_CACHED_CHUNKS];
+	// Draw counter, for picking the least recently drawn slot
+	u32 frame;
+	// Statistics of the last draw, and the ones gathered since
+	tilemap_stats_t stats;
+	tilemap_stats_t pending;
+};
+
+// Helper, index of a tile in the static layer of its chunk
+// NOTE: Layer by layer, so higher layers are drawn over lower ones
+static inline u32 tilemap_sprite_index(u32 layer, u32 x, u32 y)
+{
+	return layer*TILEMAP_CHUNK_TILES + (y % TILEMAP_CHUNK_SIZE)*TILEMAP_CHUNK_SIZE + (x % TILEMAP_CHUNK_SIZE);
+};
+// Write a tile into the static layer of its chunk, relative to the chunk origin
+static void tilemap_write_tile(tilemap_t *map, r2d_static_layer_t *layer, u32 tile_layer, u32 x, u32 y)
+{
+	const u16 tile = map->tiles[((size_t) tile_layer*map->height + y)*map->width + x];
+	const u32 index = tilemap_sprite_index(tile_layer, x, y);
+	if ((tile == TILEMAP_EMPTY) || (tile >= map->rect_count) || !map->texture)
+	{
+		r2d_set_static_sprite(layer, index, NULL, map->rects[0], xform2d_id());
+		return;
+	}
+	// Sprites are positioned by their center
+	xform2d_t xform = xform2d_id();
+	xform.pos.x = ((x % TILEMAP_CHUNK_SIZE) + 0.5f)*map->tile_size;
+	xform.pos.y = ((y % TILEMAP_CHUNK_SIZE) + 0.5f)*map->tile_size;
+	r2d_set_static_sprite(layer, index, map->texture, map->rects[tile], xform);
+};
+// Write every tile of a chunk into a static layer
+static void tilemap_bake_chunk(tilemap_t *map, u32 chunk, r2d_static_layer_t *layer)
+{
+	const u32 x0 = (chunk % map->chunks_x)*TILEMAP_CHUNK_SIZE;
+	const u32 y0 = (chunk / map->chunks_x)*TILEMAP_CHUNK_SIZE;
+	const u32 x1 = min(x0 + TILEMAP_CHUNK_SIZE, map->width);
+	const u32 y1 = min(y0 + TILEMAP_CHUNK_SIZE, map->height);
+	for (u32 l = 0; l < map->layer_count; l++)
+	{
+		for (u32 y = y0; y < y1; y++)
+		{
+			for (u32 x = x0; x < x1; x++)
+				tilemap_write_tile(map, layer, l, x, y);
+		}
+	}
+	map->pending.chunks_baked ++;
+};
+// Get the cache slot of a chunk, baking it into the least recently drawn slot if needed
+// NOTE: Returns TILEMAP_NO_SLOT if every slot was drawn this frame
+static u32 tilemap_cache_chunk(tilemap_t *map, u32 chunk)
+{
+	if (map->chunks[chunk].slot != TILEMAP_NO_SLOT)
+		return map->chunks[chunk].slot;
+
+	u32 slot = TILEMAP_NO_SLOT;
+	for (u32 i = 0; i < TILEMAP_CACHED_CHUNKS; i++)
+	{
+		const tilemap_slot_t *candidate = map->slots + i;
+		if (candidate->frame == map->frame)
+			continue;
+		if ((slot == TILEMAP_NO_SLOT) || (candidate->frame < map->slots[slot].frame))
+			slot = i;
+		// Free slots can't get any older
+		if (candidate->chunk == TILEMAP_NO_SLOT)
+			break;
+	}
+	if (slot == TILEMAP_NO_SLOT)
+		return TILEMAP_NO_SLOT;
+
+	tilemap_slot_t *entry = map->slots + slot;
+	if (!entry->layer)
+	{
+		entry->layer = r2d_alloc_static_layer(map->layer_count*TILEMAP_CHUNK_TILES);
+		if (!entry->layer)
+			return TILEMAP_NO_SLOT;
+	}
+	// Evict the previous chunk
+	if (entry->chunk != TILEMAP_NO_SLOT)
+		map->chunks[entry->chunk].slot = TILEMAP_NO_SLOT;
+	entry->chunk = chunk;
+	map->chunks[chunk].slot = slot;
+	tilemap_bake_chunk(map, chunk, entry->layer);
+	return slot;
+};
+
+tilemap_t* tilemap_alloc(u32 width, u32 height, u32 layers, const aabb_t *tiles, u32 tile_count, f32 tile_size)
+{
+	assert((layers > 0) && (layers <= TILEMAP_MAX_LAYERS));
+	assert((tile_count > 0) && (tile_count < TILEMAP_EMPTY));
+	tilemap_t *map = calloc(1, sizeof(tilemap_t));
+	if (!map)
+		return NULL;
+	map->width = width;
+	map->height = height;
+	map->chunks_x = (width + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+	map->chunks_y = (height + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+	map->layer_count = layers;
+	map->rect_count = tile_count;
+	map->tile_size = tile_size;
+
+	const size_t tile_total = (size_t) width*height*layers;
+	const size_t chunk_total = (size_t) map->chunks_x*map->chunks_y;
+	map->tiles = malloc(tile_total*sizeof(u16));
+	map->rects = malloc(tile_count*sizeof(aabb_t));
+	map->chunks = malloc(chunk_total*sizeof(tilemap_chunk_t));
+	if (!map->tiles || !map->rects || !map->chunks)
+	{
+		tilemap_free(map);
+		return NULL;
+	}
+	// Every tile starts out empty (0xFF bytes)
+	memset(map->tiles, 0xFF, tile_total*sizeof(u16));
+	memcpy(map->rects, tiles, tile_count*sizeof(aabb_t));
+	for (size_t i = 0; i < chunk_total; i++)
+		map->chunks[i].slot = TILEMAP_NO_SLOT;
+	for (u32 i = 0; i < TILEMAP_CACHED_CHUNKS; i++)
+		map->slots[i].chunk = TILEMAP_NO_SLOT;
+	// Slots start out older than any frame
+	map->frame = 1;
+	return map;
+};
+void tilemap_free(tilemap_t *map)
+{
+	if (!map)
+		return;
+	for (u32 i = 0; i < TILEMAP_CACHED_CHUNKS; i++)
+		r2d_free_static_layer(map->slots[i].layer);
+	free(map->tiles);
+	free(map->rects);
+	free(map->chunks);
+	free(map);
+};
+
+void tilemap_set_texture(tilemap_t *map, r2d_texture_t *texture)
+{
+	map->texture = texture;
+	for (u32 i = 0; i < TILEMAP_CACHED_CHUNKS; i++)
+	{
+		const tilemap_slot_t *slot = map->slots + i;
+		if (slot->chunk != TILEMAP_NO_SLOT)
+			tilemap_bake_chunk(map, slot->chunk, slot->layer);
+	}
+};
+
+u16 tilemap_get(const tilemap_t *map, u32 layer, u32 x, u32 y)
+{
+	if ((layer >= map->layer_count) || (x >= map->width) || (y >= map->height))
+		return TILEMAP_EMPTY;
+	return map->tiles[((size_t) layer*map->height + y)*map->width + x];
+};
+void tilemap_set(tilemap_t *map, u32 layer, u32 x, u32 y, u16 tile)
+{
+	assert((layer < map->layer_count) && (x < map->width) && (y < map->height));
+	map->tiles[((size_t) layer*map->height + y)*map->width + x] = tile;
+	// Only baked chunks need updating, the rest pick the tile up when they are baked
+	const u32 chunk = (y / TILEMAP_CHUNK_SIZE)*map->chunks_x + (x / TILEMAP_CHUNK_SIZE);
+	const u32 slot = map->chunks[chunk].slot;
+	if (slot != TILEMAP_NO_SLOT)
+	{
+		tilemap_write_tile(map, map->slots[slot].layer, layer, x, y);
+		map->pending.tiles_set ++;
+	}
+};
+
+// Queue the chunks overlapping the screen, baking the ones that aren't cached
+// NOTE: Only the span of sprites from the first to the last tile in view is drawn from each chunk
+static void tilemap_draw_chunks(tilemap_t *map, v2 camera)
+{
+	// Tiles in view, clamped to the map
+	const i32 tx0 = max((i32) floorf(camera.x / map->tile_size), 0);
+	const i32 ty0 = max((i32) floorf(camera.y / map->tile_size), 0);
+	const i32 tx1 = min((i32) floorf((camera.x + R2D_SCREEN_W) / map->tile_size), (i32) map->width - 1);
+	const i32 ty1 = min((i32) floorf((camera.y + R2D_SCREEN_H) / map->tile_size), (i32) map->height - 1);
+	if ((tx0 > tx1) || (ty0 > ty1))
+		return;
+
+	// Cache the chunks in view first, so the tile layers can be drawn one after the other across them
+	u32 visible[TILEMAP_CACHED_CHUNKS];
+	u32 visible_count = 0;
+	for (i32 cy = ty0 / TILEMAP_CHUNK_SIZE; cy <= ty1 / TILEMAP_CHUNK_SIZE; cy++)
+	{
+		for (i32 cx = tx0 / TILEMAP_CHUNK_SIZE; cx <= tx1 / TILEMAP_CHUNK_SIZE; cx++)
+		{
+			const u32 chunk = (u32) cy*map->chunks_x + (u32) cx;
+			const u32 slot = tilemap_cache_chunk(map, chunk);
+			if (slot == TILEMAP_NO_SLOT)
+			{
+				map->pending.chunks_skipped ++;
+				continue;
+			}
+			map->slots[slot].frame = map->frame;
+			visible[visible_count++] = chunk;
+			map->pending.chunks_drawn ++;
+		}
+	}
+
+	const f32 chunk_size = map->tile_size*TILEMAP_CHUNK_SIZE;
+	for (u32 l = 0; l < map->layer_count; l++)
+	{
+		for (u32 i = 0; i < visible_count; i++)
+		{
+			const u32 chunk = visible[i];
+			const i32 cx = (i32) (chunk % map->chunks_x), cy = (i32) (chunk / map->chunks_x);
+			// Tiles in view within the chunk, relative to its origin
+			const u32 x0 = (u32) max(tx0 - cx*TILEMAP_CHUNK_SIZE, 0);
+			const u32 y0 = (u32) max(ty0 - cy*TILEMAP_CHUNK_SIZE, 0);
+			const u32 x1 = (u32) min(tx1 - cx*TILEMAP_CHUNK_SIZE, TILEMAP_CHUNK_SIZE - 1);
+			const u32 y1 = (u32) min(ty1 - cy*TILEMAP_CHUNK_SIZE, TILEMAP_CHUNK_SIZE - 1);
+			const u32 first = tilemap_sprite_index(l, x0, y0);
+			const u32 last = tilemap_sprite_index(l, x1, y1);
+			// Chunk sprites are relative to the chunk origin
+			const v2 origin = V2(cx*chunk_size, cy*chunk_size);
+			r2d_draw_static_layer_range(map->slots[map->chunks[chunk].slot].layer, first, last - first + 1, v2_sub(origin, camera));
+		}
+	}
+};
+void tilemap_draw(tilemap_t *map, v2 camera)
+{
+	map->frame ++;
+	if (map->texture && map->chunks_x && map->chunks_y)
+		tilemap_draw_chunks(map, camera);
+	// Edits and bakes since the last draw count towards this one
+	map->stats = map->pending;
+	memset(&map->pending, 0, sizeof(map->pending));
+};
+
+tilemap_stats_t tilemap_get_stats(const tilemap_t *map)
+{
+	return map->stats;
+};
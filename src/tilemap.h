@@ -0,0 +1,56 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include "core.h"
+#include "geom.h"
+#include "render2d.h"
+
+// Chunked tile maps, split into square chunks that are baked into render2d static layers
+// Only the chunks in view are drawn, and only a few chunks keep a baked layer at a time
+
+// Chunk width/height, in tiles
+// NOTE: Chunks are drawn from the first to the last row in view, whole rows wide, so wide chunks draw far past the screen edges
+#define TILEMAP_CHUNK_SIZE		(16)
+#define TILEMAP_CHUNK_TILES		(TILEMAP_CHUNK_SIZE*TILEMAP_CHUNK_SIZE)
+// Maximum tile layers, drawn in order so higher layers cover lower ones
+#define TILEMAP_MAX_LAYERS		(4)
+// Baked chunks kept per map, the least recently drawn chunk is re-baked when a new one comes into view
+// NOTE: Must cover every chunk visible at once, see tilemap_draw
+#define TILEMAP_CACHED_CHUNKS	(16)
+
+// Tile value of an empty tile, any other value indexes the tile rectangles
+#define TILEMAP_EMPTY			(0xFFFF)
+
+decl_struct(tilemap_t);
+
+// Statistics for the last tilemap_draw
+typedef struct
+{
+	u32 chunks_drawn;	// Chunks in view
+	u32 chunks_baked;	// Chunks written into a static layer
+	u32 chunks_skipped;	// Chunks in view without a free cache slot
+	u32 tiles_set;		// Tiles edited in baked chunks since the previous draw
+} tilemap_stats_t;
+
+// Allocate/free a width x height tile map with a number of layers, every tile starts out empty
+// NOTE: tiles holds the texture rectangle of each tile value, tile_size is the size of a tile on screen
+tilemap_t* tilemap_alloc(u32 width, u32 height, u32 layers, const aabb_t *tiles, u32 tile_count, f32 tile_size);
+void       tilemap_free(tilemap_t *map);
+
+// Set the texture holding the tiles, nothing is drawn without one
+// NOTE: Re-bakes every cached chunk
+void tilemap_set_texture(tilemap_t *map, r2d_texture_t *texture);
+
+// Get/set a tile, setting only rewrites the one tile if its chunk is baked
+u16  tilemap_get(const tilemap_t *map, u32 layer, u32 x, u32 y);
+void tilemap_set(tilemap_t *map, u32 layer, u32 x, u32 y, u16 tile);
+
+// Draw the chunks in view, camera is the map position at the top left of the screen
+// NOTE: Tile (x, y) covers [x, x + 1)*tile_size, queued like r2d_draw_static_layer so it must be called between r2d_clear and r2d_flush
+// Each tile layer of a chunk in view is a static layer draw, up to TILEMAP_CACHED_CHUNKS*layers of the R2D_MAX_STATIC_LAYERS a frame
+void tilemap_draw(tilemap_t *map, v2 camera);
+
+// Get the statistics of the last tilemap_draw
+tilemap_stats_t tilemap_get_stats(const tilemap_t *map);
+
+#endif
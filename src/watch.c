@@ -0,0 +1,221 @@
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include "watch.h"
+
+typedef struct
+{
+	char name[WATCH_NAME_LEN];
+	u64 id;
+	// Directory watch of the file, and where the file name starts within name (inotify)
+	i32 wd;
+	u32 base;
+	// Size and modification time when last seen (polling)
+	u64 size, mtime;
+} watch_file_t;
+
+struct watch_t
+{
+	watch_callback_t callback;
+	void *user;
+	// Watched files, added from any thread
+	pthread_mutex_t mtx;
+	u32 file_count;
+	watch_file_t files[WATCH_MAX_FILES];
+	// Watcher thread, and its termination signal
+	pthread_t thread;
+	volatile bool done;
+#ifdef __linux__
+	int fd;
+#endif
+};
+
+// Helper, size and modification time of a file
+static bool watch_stat(const char *file_name, u64 *size, u64 *mtime)
+{
+	struct stat st;
+	if (stat(file_name, &st) != 0)
+		return false;
+	*size = (u64) st.st_size;
+	*mtime = (u64) st.st_mtime;
+	return true;
+};
+// Call back for file i if it changed, outside the lock so the callback can take its time
+// NOTE: A change is anything matching the directory watch and name (inotify), or a new size/modification time (polling)
+static void watch_notify(watch_t *watch, u32 i, i32 wd, const char *name)
+{
+	char file_name[WATCH_NAME_LEN];
+	u64 id = 0;
+	bool changed = false;
+	pthread_mutex_lock(&watch->mtx);
+	// The file may have been removed since the caller read the count
+	if (i < watch->file_count)
+	{
+		watch_file_t *file = watch->files + i;
+		if (name)
+		{
+			changed = (file->wd == wd) && (strcmp(file->name + file->base, name) == 0);
+		} else {
+			u64 size, mtime;
+			changed = watch_stat(file->name, &size, &mtime) && ((size != file->size) || (mtime != file->mtime));
+			if (changed)
+			{
+				file->size = size;
+				file->mtime = mtime;
+			}
+		}
+		if (changed)
+		{
+			strcpy(file_name, file->name);
+			id = file->id;
+		}
+	}
+	pthread_mutex_unlock(&watch->mtx);
+	if (changed)
+		watch->callback(file_name, id, watch->user);
+};
+
+static void* watch_proc(void *data)
+{
+	watch_t *watch = (watch_t*) data;
+#ifdef __linux__
+	struct pollfd pfd = { watch->fd, POLLIN, 0 };
+	_Alignas(struct inotify_event) char buffer[4096];
+	while (!watch->done)
+	{
+		// Wake up now and then to check for termination
+		if (poll(&pfd, 1, WATCH_POLL_MS) <= 0)
+			continue;
+		const ssize_t length = read(watch->fd, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < length;)
+		{
+			const struct inotify_event *event = (const struct inotify_event*) (buffer + offset);
+			if (event->len)
+			{
+				for (u32 i = 0; i < watch->file_count; i++)
+					watch_notify(watch, i, event->wd, event->name);
+			}
+			offset += sizeof(struct inotify_event) + event->len;
+		}
+	}
+#else
+	while (!watch->done)
+	{
+		usleep(WATCH_POLL_MS*1000);
+		for (u32 i = 0; i < watch->file_count; i++)
+			watch_notify(watch, i, 0, NULL);
+	}
+#endif
+	return NULL;
+};
+
+watch_t* watch_alloc(watch_callback_t callback, void *user)
+{
+	watch_t *watch = calloc(1, sizeof(watch_t));
+	if (!watch)
+		return NULL;
+	watch->callback = callback;
+	watch->user = user;
+	pthread_mutex_init(&watch->mtx, NULL);
+#ifdef __linux__
+	watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch->fd < 0)
+	{
+		pthread_mutex_destroy(&watch->mtx);
+		free(watch);
+		return NULL;
+	}
+#endif
+	if (pthread_create(&watch->thread, NULL, watch_proc, watch) != 0)
+	{
+#ifdef __linux__
+		close(watch->fd);
+#endif
+		pthread_mutex_destroy(&watch->mtx);
+		free(watch);
+		return NULL;
+	}
+	return watch;
+};
+void watch_free(watch_t *watch)
+{
+	if (!watch)
+		return;
+	watch->done = true;
+	pthread_join(watch->thread, NULL);
+#ifdef __linux__
+	close(watch->fd);
+#endif
+	pthread_mutex_destroy(&watch->mtx);
+	free(watch);
+};
+
+bool watch_add(watch_t *watch, const char *file_name, u64 id)
+{
+	if (strlen(file_name) >= WATCH_NAME_LEN)
+		return false;
+	bool result = false;
+	pthread_mutex_lock(&watch->mtx);
+	{
+		// Already watched
+		for (u32 i = 0; i < watch->file_count; i++)
+		{
+			if (strcmp(watch->files[i].name, file_name) == 0)
+			{
+				watch->files[i].id = id;
+				pthread_mutex_unlock(&watch->mtx);
+				return true;
+			}
+		}
+		watch_file_t *file = watch->files + watch->file_count;
+		if ((watch->file_count < WATCH_MAX_FILES) && watch_stat(file_name, &file->size, &file->mtime))
+		{
+			strcpy(file->name, file_name);
+			file->id = id;
+			const char *slash = strrchr(file_name, '/');
+			file->base = slash ? (u32) (slash - file_name + 1) : 0;
+#ifdef __linux__
+			// Watch the directory rather than the file, editors often save by writing a new file and renaming it
+			char dir[WATCH_NAME_LEN];
+			if (file->base)
+			{
+				memcpy(dir, file_name, file->base - 1);
+				dir[file->base - 1] = '\0';
+			} else {
+				strcpy(dir, ".");
+			}
+			// NOTE: Watching a directory twice returns the same descriptor
+			file->wd = inotify_add_watch(watch->fd, file->base == 1 ? "/" : dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+			result = (file->wd >= 0);
+#else
+			result = true;
+#endif
+			if (result)
+				watch->file_count ++;
+		}
+	}
+	pthread_mutex_unlock(&watch->mtx);
+	return result;
+};
+void watch_remove(watch_t *watch, u64 id)
+{
+	pthread_mutex_lock(&watch->mtx);
+	{
+		// Move the last file into the hole, the order doesn't matter
+		// NOTE: Directory watches stay, other files may share them and events for unwatched names are ignored
+		for (u32 i = 0; i < watch->file_count;)
+		{
+			if (watch->files[i].id == id)
+				watch->files[i] = watch->files[--watch->file_count];
+			else
+				i ++;
+		}
+	}
+	pthread_mutex_unlock(&watch->mtx);
+};
@@ -0,0 +1,32 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "core.h"
+
+// File watcher, calls back when a watched file is written
+// NOTE: Uses inotify on Linux (watching the files' directories, so files replaced by a rename are caught too),
+// other platforms poll the files' modification times every WATCH_POLL_MS
+
+// Max files watched by one watcher, and the max length of their names
+#define WATCH_MAX_FILES		(1024)
+#define WATCH_NAME_LEN		(512)
+// Polling interval, and how often the inotify thread checks for shutdown
+#define WATCH_POLL_MS		(250)
+
+decl_struct(watch_t);
+
+// Called on the watcher thread with the name and id the file was added with
+typedef void (*watch_callback_t)(const char *file_name, u64 id, void *user);
+
+// Create/destroy a watcher and its thread, NULL if it can't be created
+watch_t* watch_alloc(watch_callback_t callback, void *user);
+void     watch_free(watch_t *watch);
+
+// Watch a file, id is passed back to the callback, false if it doesn't exist or the watcher is full
+// NOTE: Thread safe, watching a file again only updates its id
+bool watch_add(watch_t *watch, const char *file_name, u64 id);
+// Stop watching the files added with id
+// NOTE: Thread safe, the callback may still run for a change seen just before
+void watch_remove(watch_t *watch, u64 id);
+
+#endif
@@ -0,0 +1,76 @@
+#include <stdio.h>
+
+#include <stb_image.h>
+
+#include "archive.h"
+#include "texcache.h"
+
+// Texture cache baker
+// Decodes images into the texture cache ahead of time, so the first run of the game skips PNG decoding too
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: bake <cache dir> [-a <archive>] <image>...\n"
+		"  images are cached by the name the game loads them by, e.g. bake cache data/dungeon_sheet.png\n"
+		"  with -a images are read from the archive (see pack), to match a game loading from it\n");
+};
+
+int main(int argc, const char *argv[])
+{
+	if (argc < 3)
+	{
+		usage();
+		return 1;
+	}
+	const char *cache_dir = argv[1];
+	i32 first = 2;
+	archive_t *archive = NULL;
+	if (strcmp(argv[first], "-a") == 0)
+	{
+		if (argc < 5)
+		{
+			usage();
+			return 1;
+		}
+		archive = archive_open(argv[first + 1]);
+		if (!archive)
+		{
+			fprintf(stderr, "Failed to open %s\n", argv[first + 1]);
+			return 1;
+		}
+		first += 2;
+	}
+
+	u32 baked = 0, failed = 0;
+	for (i32 i = first; i < argc; i++)
+	{
+		// Describe the source the same way the asset loader does
+		const char *file_name = argv[i];
+		size_t size;
+		const void *file = archive ? archive_find(archive, file_name, &size) : NULL;
+		texcache_source_t source;
+		i32 w, h, c;
+		u8 *pixels = NULL;
+		if (file)
+		{
+			source = texcache_source_memory(file, size);
+			pixels = stbi_load_from_memory((const stbi_uc*) file, (int) size, &w, &h, &c, STBI_rgb_alpha);
+		} else if (!archive && texcache_source_file(file_name, &source)) {
+			pixels = stbi_load(file_name, &w, &h, &c, STBI_rgb_alpha);
+		}
+
+		if (pixels && texcache_store(cache_dir, file_name, &source, pixels, (u32) w, (u32) h))
+		{
+			baked ++;
+		} else {
+			fprintf(stderr, "Failed to bake %s\n", file_name);
+			failed ++;
+		}
+		stbi_image_free(pixels);
+	}
+	printf("Baked %u images into %s\n", baked, cache_dir);
+
+	archive_close(archive);
+	return failed ? 1 : 0;
+};
@@ -0,0 +1,67 @@
+#include <stdio.h>
+
+#include "archive.h"
+
+// Asset packer
+// Bundles files into an archive for archive_open, each file is stored under the path it was given as
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: pack <archive> <file>...\n"
+		"  files are stored by the path given, e.g. pack data.pak data/shader.vert data/shader.frag\n"
+		"  a file given as <name>=<path> is read from path and stored as name\n");
+};
+
+int main(int argc, const char *argv[])
+{
+	if (argc < 3)
+	{
+		usage();
+		return 1;
+	}
+	const u32 count = (u32) (argc - 2);
+	const char **names = malloc(count*sizeof(const char*));
+	const char **files = malloc(count*sizeof(const char*));
+	char **splits = calloc(count, sizeof(char*));
+	if (!names || !files || !splits)
+		return 1;
+	for (u32 i = 0; i < count; i++)
+	{
+		const char *arg = argv[i + 2];
+		const char *split = strchr(arg, '=');
+		if (split)
+		{
+			// Split name=path
+			splits[i] = malloc(strlen(arg) + 1);
+			if (!splits[i])
+				return 1;
+			strcpy(splits[i], arg);
+			splits[i][split - arg] = '\0';
+			names[i] = splits[i];
+			files[i] = splits[i] + (split - arg) + 1;
+		} else {
+			names[i] = arg;
+			files[i] = arg;
+		}
+	}
+
+	const bool result = archive_write(argv[1], names, files, count);
+	if (result)
+	{
+		// Check the archive reads back
+		archive_t *archive = archive_open(argv[1]);
+		if (archive)
+		{
+			printf("Packed %u files into %s\n", archive_count(archive), argv[1]);
+			archive_close(archive);
+		}
+	}
+
+	for (u32 i = 0; i < count; i++)
+		free(splits[i]);
+	free(splits);
+	free(names);
+	free(files);
+	return result ? 0 : 1;
+};